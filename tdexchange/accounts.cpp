@@ -0,0 +1,429 @@
+#include "accounts.h"
+#include "logger.h"
+
+#include <fmt/core.h>
+#include <cassert>
+#include <cstdlib>
+
+market::accounts::accounts()
+    : m_index(), m_ids(), m_credentials(), m_columns(), m_tickers(),
+    m_cash(), m_gross(), m_open_volume(), m_bid_notional(), m_positions(), m_open(),
+    m_order_head(), m_order_count(), m_pool(), m_free(-1), m_nodes(), m_changed(), m_listed()
+{
+}
+
+auto market::accounts::reserve(size_t users, size_t tickers, size_t orders) -> void
+{
+    m_index.reserve(users);
+    m_ids.reserve(users);
+    m_credentials.reserve(users);
+    m_columns.reserve(tickers);
+    m_tickers.reserve(tickers);
+
+    m_cash.reserve(users);
+    m_gross.reserve(users);
+    m_open_volume.reserve(users);
+    m_bid_notional.reserve(users);
+    m_positions.reserve(users * tickers);
+    m_open.reserve(users * tickers);
+
+    m_order_head.reserve(users);
+    m_order_count.reserve(users);
+    m_pool.reserve(orders);
+    m_nodes.reserve(orders);
+
+    m_changed.reserve(users);
+    m_listed.reserve(users);
+}
+
+auto market::accounts::add_ticker(ids::ticker_id ticker_id) -> void
+{
+    assert(!m_columns.contains(ticker_id));
+
+    // widen the matrices by a column, copying every row over
+    size_t columns = m_tickers.size();
+    vector<int> positions(m_ids.size() * (columns + 1), 0);
+    vector<open_volume> open(m_ids.size() * (columns + 1));
+    for (size_t row = 0; row < m_ids.size(); ++row)
+    {
+        for (size_t column = 0; column < columns; ++column)
+        {
+            positions[row * (columns + 1) + column] = m_positions[row * columns + column];
+            open[row * (columns + 1) + column] = m_open[row * columns + column];
+        }
+    }
+
+    m_positions = std::move(positions);
+    m_open = std::move(open);
+    m_columns[ticker_id] = columns;
+    m_tickers.push_back(ticker_id);
+}
+
+auto market::accounts::add_user(ids::user_id user_id, credentials login) -> size_t
+{
+    assert(!m_index.contains(user_id));
+
+    size_t index = m_ids.size();
+    m_index[user_id] = index;
+    m_ids.push_back(user_id);
+    m_credentials.push_back(std::move(login));
+
+    m_cash.push_back(0);
+    m_gross.push_back(0);
+    m_open_volume.push_back(0);
+    m_bid_notional.push_back(0);
+    m_positions.resize(m_positions.size() + m_tickers.size(), 0);
+    m_open.resize(m_open.size() + m_tickers.size());
+
+    m_order_head.push_back(-1);
+    m_order_count.push_back(0);
+
+    m_listed.push_back(false);
+
+    return index;
+}
+
+auto market::accounts::contains(ids::user_id user_id) const -> bool
+{
+    return m_index.contains(user_id);
+}
+
+auto market::accounts::index(ids::user_id user_id) const -> size_t
+{
+    assert(m_index.contains(user_id));
+
+    return m_index.at(user_id);
+}
+
+auto market::accounts::size() const -> size_t
+{
+    return m_ids.size();
+}
+
+auto market::accounts::authenticate(const string &name, const string &passphase) const -> optional<ids::user_id>
+{
+    for (size_t index = 0; index < m_credentials.size(); ++index)
+    {
+        if (m_credentials[index].alias == name && m_credentials[index].passphase == passphase)
+        {
+            return m_ids[index];
+        }
+    }
+
+    return std::nullopt;
+}
+
+auto market::accounts::add_order(const order &ord) -> void
+{
+    assert(!m_nodes.contains(ord.id));
+
+    size_t index = this->index(ord.user_id);
+    logger::log(fmt::format("user {} added order {}", ord.user_id, ord.id));
+
+    // reuse a free node, or grow the pool
+    int node = m_free;
+    if (node == -1)
+    {
+        node = static_cast<int>(m_pool.size());
+        m_pool.push_back({});
+    }
+    else
+    {
+        m_free = m_pool[node].next;
+    }
+
+    // link at the head of the user's list
+    m_pool[node] = { ord, -1, m_order_head[index] };
+    if (m_order_head[index] != -1)
+    {
+        m_pool[m_order_head[index]].prev = node;
+    }
+    m_order_head[index] = node;
+    m_order_count[index] += 1;
+    m_nodes[ord.id] = node;
+
+    expose(index, ord, 1);
+}
+
+auto market::accounts::remove_order(const order &ord) -> void
+{
+    assert(m_nodes.contains(ord.id));
+
+    logger::log(fmt::format("user {} removed order {}", ord.user_id, ord.id));
+
+    int node = m_nodes.at(ord.id);
+    expose(index(ord.user_id), m_pool[node].ord, -1);
+    release(node);
+}
+
+auto market::accounts::amend_order(const order &ord) -> void
+{
+    assert(m_nodes.contains(ord.id));
+    assert(ord.volume > 0);
+
+    logger::log(fmt::format("user {} amended order {} to {} @ {}", ord.user_id, ord.id, ord.volume, ord.price));
+
+    size_t index = this->index(ord.user_id);
+    order &open = m_pool[m_nodes.at(ord.id)].ord;
+    expose(index, open, -1);
+    open = ord;
+    expose(index, open, 1);
+}
+
+auto market::accounts::fill_order(const order &ord, int price, int volume, side type) -> void
+{
+    assert(m_nodes.contains(ord.id));
+
+    logger::log(fmt::format("user {} filled a {} order {} of {} @ {}",
+        ord.user_id, side_repr[static_cast<int>(type)], ord.id, volume, price));
+
+    fill(ord.user_id, ord.ticker_id, price, volume, type);
+
+    // update order, the filled volume is no longer open
+    size_t index = this->index(ord.user_id);
+    int node = m_nodes.at(ord.id);
+    order &filled = m_pool[node].ord;
+    expose(index, filled, -1);
+    filled.volume -= volume;
+    expose(index, filled, 1);
+    assert(filled.volume >= 0);
+    if (filled.volume == 0)
+    {
+        release(node);
+    }
+}
+
+auto market::accounts::fill(ids::user_id user_id, ids::ticker_id ticker_id, int price, int volume, side type) -> void
+{
+    size_t index = this->index(user_id);
+    int &position = m_positions[cell(index, ticker_id)];
+
+    m_gross[index] -= std::abs(position);
+    if (type == side::BID)
+    {
+        // we've brought assets
+        m_cash[index] -= static_cast<long long>(price) * volume;
+        position += volume;
+    }
+    else
+    {
+        // we've sold assets
+        m_cash[index] += static_cast<long long>(price) * volume;
+        position -= volume;
+    }
+    m_gross[index] += std::abs(position);
+
+    if (!m_listed[index])
+    {
+        m_listed[index] = true;
+        m_changed.push_back(index);
+    }
+}
+
+auto market::accounts::view_order(ids::order_id order_id) const -> const order &
+{
+    assert(m_nodes.contains(order_id));
+
+    return m_pool[m_nodes.at(order_id)].ord;
+}
+
+auto market::accounts::has_order(ids::order_id order_id) const -> bool
+{
+    return m_nodes.contains(order_id);
+}
+
+auto market::accounts::get_id(size_t index) const -> ids::user_id
+{
+    return m_ids[index];
+}
+
+auto market::accounts::get_credentials(size_t index) const -> const credentials &
+{
+    return m_credentials[index];
+}
+
+auto market::accounts::get_cash(size_t index) const -> long long
+{
+    return m_cash[index];
+}
+
+auto market::accounts::get_position(size_t index, ids::ticker_id ticker_id) const -> int
+{
+    return m_positions[cell(index, ticker_id)];
+}
+
+auto market::accounts::get_open(size_t index, ids::ticker_id ticker_id) const -> open_volume
+{
+    return m_open[cell(index, ticker_id)];
+}
+
+auto market::accounts::get_open_orders(size_t index) const -> int
+{
+    return m_order_count[index];
+}
+
+auto market::accounts::get_open_volume(size_t index) const -> long long
+{
+    return m_open_volume[index];
+}
+
+auto market::accounts::get_bid_notional(size_t index) const -> long long
+{
+    return m_bid_notional[index];
+}
+
+auto market::accounts::get_gross(size_t index) const -> long long
+{
+    return m_gross[index];
+}
+
+auto market::accounts::get_orders(size_t index) const -> vector<ids::order_id>
+{
+    vector<ids::order_id> orderids;
+    orderids.reserve(m_order_count[index]);
+    for_each_order(index, [&](const order &ord)
+    {
+        orderids.push_back(ord.id);
+    });
+
+    return orderids;
+}
+
+auto market::accounts::get_assets(size_t index, const map<ids::ticker_id, int> &valuations) const -> long long
+{
+    long long total = m_cash[index];
+    for (size_t column = 0; column < m_tickers.size(); ++column)
+    {
+        assert(valuations.contains(m_tickers[column]));
+
+        total += static_cast<long long>(m_positions[index * m_tickers.size() + column]) * valuations.at(m_tickers[column]);
+    }
+
+    return total;
+}
+
+auto market::accounts::get_all_assets(const map<ids::ticker_id, int> &valuations) const -> vector<long long>
+{
+    // valuations by column, so the matrix is read in order
+    vector<long long> prices(m_tickers.size());
+    for (size_t column = 0; column < m_tickers.size(); ++column)
+    {
+        assert(valuations.contains(m_tickers[column]));
+
+        prices[column] = valuations.at(m_tickers[column]);
+    }
+
+    vector<long long> assets(m_cash);
+    for (size_t index = 0; index < m_ids.size(); ++index)
+    {
+        const int *row = m_positions.data() + index * m_tickers.size();
+        for (size_t column = 0; column < m_tickers.size(); ++column)
+        {
+            assets[index] += row[column] * prices[column];
+        }
+    }
+
+    return assets;
+}
+
+auto market::accounts::consume_changed() -> vector<size_t>
+{
+    for (size_t index : m_changed)
+    {
+        m_listed[index] = false;
+    }
+
+    // copied out, so the reserved buffer is kept
+    vector<size_t> changed(m_changed.begin(), m_changed.end());
+    m_changed.clear();
+    return changed;
+}
+
+auto market::accounts::get_tickers() const -> const vector<ids::ticker_id> &
+{
+    return m_tickers;
+}
+
+auto market::accounts::repr(size_t index) const -> string
+{
+    string repr;
+
+    const credentials &login = m_credentials[index];
+    repr += fmt::format("name {}, id {}, passphase {}\n", login.alias, m_ids[index], login.passphase);
+    repr += fmt::format("cash {}\n", m_cash[index]);
+    repr += fmt::format("holdings:\n");
+
+    bool holds = false;
+    for (size_t column = 0; column < m_tickers.size(); ++column)
+    {
+        int position = m_positions[index * m_tickers.size() + column];
+        if (position != 0)
+        {
+            repr += fmt::format("    {}: {}\n", m_tickers[column], position);
+            holds = true;
+        }
+    }
+    if (!holds)
+    {
+        repr += "none\n";
+    }
+
+    repr += "orders:\n";
+    for_each_order(index, [&](const order &ord)
+    {
+        repr += ord.repr() + "\n";
+    });
+    if (m_order_count[index] == 0)
+    {
+        repr += "none\n";
+    }
+
+    return repr;
+}
+
+auto market::accounts::expose(size_t index, const order &ord, int sign) -> void
+{
+    long long volume = static_cast<long long>(sign) * ord.volume;
+    open_volume &open = m_open[cell(index, ord.ticker_id)];
+    if (ord.wish == side::BID)
+    {
+        open.bid += volume;
+        m_bid_notional[index] += volume * ord.price;
+    }
+    else
+    {
+        open.ask += volume;
+    }
+    m_open_volume[index] += volume;
+}
+
+auto market::accounts::cell(size_t index, ids::ticker_id ticker_id) const -> size_t
+{
+    assert(m_columns.contains(ticker_id));
+
+    return index * m_tickers.size() + m_columns.at(ticker_id);
+}
+
+auto market::accounts::release(int node) -> void
+{
+    order_node &released = m_pool[node];
+    size_t index = this->index(released.ord.user_id);
+
+    if (released.prev != -1)
+    {
+        m_pool[released.prev].next = released.next;
+    }
+    else
+    {
+        m_order_head[index] = released.next;
+    }
+    if (released.next != -1)
+    {
+        m_pool[released.next].prev = released.prev;
+    }
+    m_order_count[index] -= 1;
+
+    m_nodes.erase(released.ord.id);
+    released.next = m_free;
+    m_free = node;
+}
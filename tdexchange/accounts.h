@@ -0,0 +1,223 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <optional>
+
+#include "id.h"
+#include "order.h"
+
+namespace market
+{
+
+using namespace std;
+
+// open order volume on a ticker, what the position could grow by if every order filled
+struct open_volume
+{
+    long long bid = 0;
+    long long ask = 0;
+};
+
+// login details, only read when authenticating and displaying
+struct credentials
+{
+    string alias;
+    string passphase;
+    bool is_admin = false;
+};
+
+// an open order in the shared pool, linked into the list of its user's open orders
+struct order_node
+{
+    order ord;
+    int prev;
+    int next;
+};
+
+/**
+ * @brief The account data of every user, stored as structure of arrays
+ *
+ * Users and tickers get dense indices. Cash and exposure live in arrays by user index, positions and open volume
+ * in users by tickers matrices, so settlement and sweeps over every user stream through memory.
+ * Open orders live in one pool, each user's linked through the pool so they can be walked without a lookup.
+ * Credentials are kept apart, as they are only read when authenticating.
+*/
+class accounts
+{
+protected:
+    // user id to dense index, and back
+    unordered_map<ids::user_id, size_t> m_index;
+    vector<ids::user_id> m_ids;
+    vector<credentials> m_credentials;
+
+    // ticker id to dense column, and back
+    unordered_map<ids::ticker_id, size_t> m_columns;
+    vector<ids::ticker_id> m_tickers;
+
+    /// FINANCIALS, by user index ///
+
+    // cash money held
+    vector<long long> m_cash;
+    // sum of the absolute positions
+    vector<long long> m_gross;
+    // open order volume over all tickers, and the cash the open bids would spend
+    vector<long long> m_open_volume;
+    vector<long long> m_bid_notional;
+
+    // users by tickers, row major
+    vector<int> m_positions;
+    vector<open_volume> m_open;
+
+    /// OPEN ORDERS ///
+
+    // first node of each user's orders, or -1, and how many there are
+    vector<int> m_order_head;
+    vector<int> m_order_count;
+
+    // every open order, free nodes are linked through next from m_free
+    vector<order_node> m_pool;
+    int m_free;
+    unordered_map<ids::order_id, int> m_nodes;
+
+    // users whose cash or positions changed since they were last consumed, each listed once
+    vector<size_t> m_changed;
+    vector<char> m_listed;
+
+public:
+    accounts();
+
+    /**
+     * @brief Reserves room so adding users and tickers, and opening orders, below these never reallocates
+     * @param users
+     * @param tickers
+     * @param orders Open orders over every user
+     * @return
+    */
+    auto reserve(size_t users, size_t tickers, size_t orders) -> void;
+
+    /**
+     * @brief Adds a ticker, giving every user a position in it
+     * @param ticker_id
+     * @return
+    */
+    auto add_ticker(ids::ticker_id ticker_id) -> void;
+
+    /**
+     * @brief Adds a user with no cash, positions or orders
+     * @param user_id
+     * @param login The user's credentials
+     * @return The user's index
+    */
+    auto add_user(ids::user_id user_id, credentials login) -> size_t;
+
+    auto contains(ids::user_id user_id) const -> bool;
+
+    // returns the dense index of a user
+    auto index(ids::user_id user_id) const -> size_t;
+    auto size() const -> size_t;
+
+    // returns the user matching the credentials
+    auto authenticate(const string &name, const string &passphase) const->optional<ids::user_id>;
+
+    /// ORDER OPERATIONS ///
+
+    // link an order with its user
+    auto add_order(const order &ord) -> void;
+
+    // remove the order from its user
+    auto remove_order(const order &ord) -> void;
+
+    // replace the price and volume of an order
+    auto amend_order(const order &ord) -> void;
+
+    // process a fill of a resting order for its user
+    auto fill_order(const order &ord, int price, int volume, side type) -> void;
+
+    // process a fill of an order that never rested, updating only cash and positions
+    auto fill(ids::user_id user_id, ids::ticker_id ticker_id, int price, int volume, side type) -> void;
+
+    // view an open order, of any user
+    auto view_order(ids::order_id order_id) const -> const order &;
+    auto has_order(ids::order_id order_id) const -> bool;
+
+    /**
+     * @brief Walks the open orders of a user, newest first
+     * @param index The user's index
+     * @param visit Called with each order, which must not be removed while walking
+     * @return
+    */
+    template<typename F>
+    auto for_each_order(size_t index, F &&visit) const -> void
+    {
+        for (int node = m_order_head[index]; node != -1; node = m_pool[node].next)
+        {
+            visit(m_pool[node].ord);
+        }
+    }
+
+    /**
+     * @brief Removes the open orders of a user in one walk over its list
+     * @param index The user's index
+     * @param remove Called with each order, returning whether to remove it, before it is removed
+     * @return The number of orders removed
+    */
+    template<typename F>
+    auto remove_orders(size_t index, F &&remove) -> int
+    {
+        int removed = 0;
+        for (int node = m_order_head[index]; node != -1;)
+        {
+            // the next node is taken before this one is freed
+            int next = m_pool[node].next;
+            if (remove(static_cast<const order &>(m_pool[node].ord)))
+            {
+                expose(index, m_pool[node].ord, -1);
+                release(node);
+                removed += 1;
+            }
+            node = next;
+        }
+        return removed;
+    }
+
+    /// GETTERS, by user index ///
+    auto get_id(size_t index) const -> ids::user_id;
+    auto get_credentials(size_t index) const -> const credentials &;
+    auto get_cash(size_t index) const -> long long;
+    auto get_position(size_t index, ids::ticker_id ticker_id) const -> int;
+    auto get_open(size_t index, ids::ticker_id ticker_id) const -> open_volume;
+    auto get_open_orders(size_t index) const -> int;
+    auto get_open_volume(size_t index) const -> long long;
+    auto get_bid_notional(size_t index) const -> long long;
+    auto get_gross(size_t index) const -> long long;
+    auto get_orders(size_t index) const->vector<ids::order_id>;
+
+    // returns the net wealth of a user, including cash and positions
+    auto get_assets(size_t index, const map<ids::ticker_id, int> &valuations) const -> long long;
+
+    // returns the net wealth of every user by index, in one pass over the position matrix
+    auto get_all_assets(const map<ids::ticker_id, int> &valuations) const->vector<long long>;
+
+    auto get_tickers() const -> const vector<ids::ticker_id> &;
+
+    // returns the index of every user whose cash or positions changed since the last call
+    auto consume_changed() -> vector<size_t>;
+
+    /// DISPLAY ///
+    auto repr(size_t index) const->string;
+
+protected:
+    // adds an order's volume to the exposure of its user, or removes it with a negative sign
+    auto expose(size_t index, const order &ord, int sign) -> void;
+
+    // returns the cell of a user and ticker in the matrices
+    auto cell(size_t index, ids::ticker_id ticker_id) const -> size_t;
+
+    // unlinks an order from its user's list and frees its node
+    auto release(int node) -> void;
+};
+
+};
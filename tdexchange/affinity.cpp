@@ -0,0 +1,205 @@
+#include "affinity.h"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "logger.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// every core of the machine, for a machine without numa nodes
+static auto all_cores() -> std::vector<int>
+{
+    std::vector<int> cores(std::max(1u, std::thread::hardware_concurrency()));
+    for (size_t i = 0; i < cores.size(); ++i)
+    {
+        cores[i] = static_cast<int>(i);
+    }
+    return cores;
+}
+
+#ifdef _WIN32
+
+auto network::pin_thread(const std::vector<int> &cores) -> bool
+{
+    // a thread outside the first processor group cannot be pinned by a mask
+    DWORD_PTR mask = 0;
+    for (int core : cores)
+    {
+        if (core >= 0 && core < static_cast<int>(sizeof(DWORD_PTR) * 8))
+            mask |= DWORD_PTR(1) << core;
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+auto network::core_node(int core) -> int
+{
+    UCHAR node = 0;
+    if (core < 0 || core > 255 || !GetNumaProcessorNode(static_cast<UCHAR>(core), &node) || node == 0xff)
+        return 0;
+    return node;
+}
+
+auto network::node_cores(int node) -> std::vector<int>
+{
+    ULONGLONG mask = 0;
+    if (node < 0 || node > 255 || !GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask) || mask == 0)
+        return all_cores();
+
+    std::vector<int> cores;
+    for (int core = 0; core < 64; ++core)
+    {
+        if (mask & (ULONGLONG(1) << core))
+            cores.push_back(core);
+    }
+    return cores;
+}
+
+auto network::lock_memory() -> bool
+{
+    // windows only locks ranges, within the working set, which the process would have to size and track
+    errno = ENOSYS;
+    return false;
+}
+
+#elif defined(__linux__)
+
+auto network::pin_thread(const std::vector<int> &cores) -> bool
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core : cores)
+    {
+        if (core >= 0 && core < CPU_SETSIZE)
+            CPU_SET(core, &set);
+    }
+    return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+auto network::core_node(int core) -> int
+{
+    // a core's directory links to the node it belongs to
+    std::error_code ec;
+    std::filesystem::directory_iterator it(fmt::format("/sys/devices/system/cpu/cpu{}", core), ec);
+    for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+    {
+        std::string name = it->path().filename().string();
+        if (name.size() > 4 && name.starts_with("node") && std::all_of(name.begin() + 4, name.end(), ::isdigit))
+            return std::stoi(name.substr(4));
+    }
+    return 0;
+}
+
+auto network::node_cores(int node) -> std::vector<int>
+{
+    // a list of ranges, like 0-7,16-23
+    std::ifstream file(fmt::format("/sys/devices/system/node/node{}/cpulist", node));
+    std::string list;
+    if (!file || !std::getline(file, list) || list.empty())
+        return all_cores();
+
+    std::vector<int> cores;
+    for (size_t start = 0, end = 0; end != std::string::npos; start = end + 1)
+    {
+        end = list.find(',', start);
+        std::string range = list.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int core = first; core <= last; ++core)
+        {
+            cores.push_back(core);
+        }
+    }
+    return cores;
+}
+
+auto network::lock_memory() -> bool
+{
+    return ::mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+}
+
+#else
+
+auto network::pin_thread(const std::vector<int> &) -> bool
+{
+    return false;
+}
+
+auto network::core_node(int) -> int
+{
+    return 0;
+}
+
+auto network::node_cores(int) -> std::vector<int>
+{
+    return all_cores();
+}
+
+auto network::lock_memory() -> bool
+{
+    errno = ENOSYS;
+    return false;
+}
+
+#endif
+
+auto network::cpu_relax() -> void
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+auto network::prepare_process(const runtime_config &config) -> void
+{
+    if (config.exchange_core >= 0)
+    {
+        int node = core_node(config.exchange_core);
+        std::vector<int> cores = node_cores(node);
+        std::erase_if(cores, [&config](int core) { return core == config.exchange_core || core == config.publisher_core; });
+
+        // a node of only hot cores leaves the calling thread where it is, sharing is worse than a remote node
+        if (!cores.empty() && pin_thread(cores))
+            logger::log(fmt::format("allocating on numa node {} of core {}", node, config.exchange_core));
+        else
+            logger::log(fmt::format("cannot move to numa node {} of core {}", node, config.exchange_core), logger::mode::WARN);
+
+        if (config.publisher_core >= 0 && core_node(config.publisher_core) != node)
+            logger::log(fmt::format("publisher core {} is off the matcher's numa node {}, every update crosses nodes",
+                config.publisher_core, node), logger::mode::WARN);
+    }
+
+    if (config.profile != latency_profile::LOW_LATENCY)
+        return;
+
+    if (config.exchange_core < 0 || config.publisher_core < 0)
+        logger::log("spinning threads left to the scheduler compete with everything else, pin them to isolated cores",
+            logger::mode::WARN);
+
+    // a failure is most likely the limit of locked memory, ulimit -l, the exchange still runs unlocked
+    if (lock_memory())
+        logger::log("process memory locked, pages are faulted in as they are allocated");
+    else
+        logger::log(fmt::format("cannot lock process memory: {}", std::strerror(errno)), logger::mode::WARN);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+namespace network
+{
+
+// how the hot threads wait, sleeping between ticks and updates, or spinning on the clock and their queues
+enum class latency_profile
+{
+    POWER_SAVING = 0,
+    LOW_LATENCY = 1
+};
+static const char *latency_profile_repr[] = { "power_saving", "low_latency" };
+
+/**
+ * @brief Where the threads of the exchange run and how they wait
+ *
+ * The low latency profile spins instead of sleeping and locks the process in memory, its threads are best
+ * given cores isolated from the scheduler, with isolcpus or a cpuset.
+*/
+struct runtime_config
+{
+    latency_profile profile = latency_profile::POWER_SAVING;
+
+    // cores the matcher, the publisher and the websocket thread are pinned to, -1 leaves them to the scheduler
+    int exchange_core = -1;
+    int publisher_core = -1;
+    int io_core = -1;
+};
+
+/**
+ * @brief Pins the calling thread to some cores
+ * @param cores The cores it may run on
+ * @return Whether the platform allowed it
+*/
+auto pin_thread(const std::vector<int> &cores) -> bool;
+
+// the numa node of a core, 0 on machines with a single node or that do not say
+auto core_node(int core) -> int;
+
+// the cores of a numa node, every core on machines with a single node or that do not say
+auto node_cores(int node) -> std::vector<int>;
+
+/**
+ * @brief Locks every page of the process in memory, those mapped now and those mapped later, which are
+ * faulted in as they are allocated
+ * @return Whether the platform allowed it, within the limit of locked memory
+*/
+auto lock_memory() -> bool;
+
+// tells the cpu the thread is spinning, between two polls of a busy wait
+auto cpu_relax() -> void;
+
+/**
+ * @brief Readies the calling thread and the process for the threads of a server, before the server is built
+ *
+ * The calling thread is moved to the node of the matcher's core, off the cores of the matcher and the
+ * publisher, so the books and queues the server allocates are first touched on the matcher's node and
+ * the pool threads it starts stay off the hot cores. The low latency profile also locks the process in
+ * memory, pre-faulting everything allocated after.
+ *
+ * @param config
+ * @return
+*/
+auto prepare_process(const runtime_config &config) -> void;
+
+};
@@ -0,0 +1,18 @@
+#include "book_event.h"
+
+#include <fmt/core.h>
+
+auto market::book_event::repr() const -> string
+{
+    return fmt::format(
+        "Event {}, {} order {} type {} on {} @ {}, {} left, {} executed",
+        sequence,
+        market::book_action_repr[static_cast<int>(action)],
+        order_id,
+        market::side_repr[static_cast<int>(wish)],
+        ticker_id,
+        price,
+        volume,
+        executed
+    );
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include "id.h"
+#include "side.h"
+
+namespace market
+{
+
+using namespace std;
+
+// DELETE collides with a windows macro
+enum class book_action
+{
+    ADD = 0,
+    MODIFY = 1,
+    EXECUTE = 2,
+    REMOVE = 3
+};
+static const char *book_action_repr[] = { "ADD", "MODIFY", "EXECUTE", "DELETE" };
+
+// represents a change to a single resting order, for the market-by-order feed
+struct book_event
+{
+    // sequence number of the event within its ticker
+    unsigned long long sequence;
+
+    book_action action;
+
+    // the resting order
+    ids::order_id order_id;
+    ids::ticker_id ticker_id;
+    side wish;
+    int price;
+
+    // volume left resting after the event
+    int volume;
+
+    // volume traded, for executions
+    int executed;
+
+    /// DISPLAY ///
+    auto repr() const->string;
+};
+
+};
@@ -0,0 +1,103 @@
+#include "candles.h"
+
+#include <cassert>
+#include <algorithm>
+
+auto market::candle::vwap() const -> double
+{
+    return volume == 0 ? 0.0 : static_cast<double>(notional) / volume;
+}
+
+market::candle_series::candle_series(resolution res)
+    : m_width(resolution_width[static_cast<int>(res)]), m_ring(resolution_capacity[static_cast<int>(res)]),
+    m_head(0), m_count(0)
+{
+}
+
+auto market::candle_series::add(long long time, int price, int volume) -> void
+{
+    long long start = time - time % m_width;
+    long long notional = static_cast<long long>(price) * volume;
+
+    if (m_count > 0 && m_ring[m_head].start == start)
+    {
+        candle &bar = m_ring[m_head];
+        bar.high = std::max(bar.high, price);
+        bar.low = std::min(bar.low, price);
+        bar.close = price;
+        bar.volume += volume;
+        bar.notional += notional;
+        bar.trades += 1;
+        return;
+    }
+
+    assert(m_count == 0 || m_ring[m_head].start < start);
+
+    // a new period overwrites the oldest candle once the ring is full
+    m_head = m_count == 0 ? 0 : (m_head + 1) % m_ring.size();
+    m_count = std::min(m_count + 1, m_ring.size());
+    m_ring[m_head] = { start, price, price, price, price, volume, notional, 1 };
+}
+
+auto market::candle_series::latest(size_t count) const -> vector<candle>
+{
+    count = std::min(count, m_count);
+
+    vector<candle> bars;
+    bars.reserve(count);
+    for (size_t i = count; i-- > 0;)
+    {
+        bars.push_back(m_ring[(m_head + m_ring.size() - i) % m_ring.size()]);
+    }
+    return bars;
+}
+
+auto market::candle_series::last() const -> optional<candle>
+{
+    if (m_count == 0)
+        return std::nullopt;
+
+    return m_ring[m_head];
+}
+
+auto market::candle_series::size() const -> size_t
+{
+    return m_count;
+}
+
+market::candles::candles()
+    : m_series()
+{
+}
+
+auto market::candles::add(const transaction &trans) -> void
+{
+    auto it = m_series.find(trans.ticker_id);
+    if (it == m_series.end())
+    {
+        it = m_series.emplace(trans.ticker_id, array<candle_series, RESOLUTIONS>{
+            candle_series(resolution::SECOND), candle_series(resolution::MINUTE), candle_series(resolution::FIVE_MINUTES)
+        }).first;
+    }
+
+    for (candle_series &series : it->second)
+    {
+        series.add(trans.time, trans.price, trans.volume);
+    }
+}
+
+auto market::candles::get(ids::ticker_id ticker_id, resolution res, size_t count) const -> vector<candle>
+{
+    if (!m_series.contains(ticker_id))
+        return {};
+
+    return m_series.at(ticker_id)[static_cast<int>(res)].latest(count);
+}
+
+auto market::candles::last(ids::ticker_id ticker_id, resolution res) const -> optional<candle>
+{
+    if (!m_series.contains(ticker_id))
+        return std::nullopt;
+
+    return m_series.at(ticker_id)[static_cast<int>(res)].last();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <map>
+#include <optional>
+
+#include "id.h"
+#include "transaction.h"
+
+namespace market
+{
+
+using namespace std;
+
+// the width of a candle
+enum class resolution
+{
+    SECOND = 0,
+    MINUTE = 1,
+    FIVE_MINUTES = 2
+};
+static const char *resolution_repr[] = { "1s", "1m", "5m" };
+constexpr size_t RESOLUTIONS = 3;
+
+// width of each resolution in nanoseconds, and how many candles of it are kept, an hour, a day and a week
+static const long long resolution_width[] = { 1000000000LL, 60000000000LL, 300000000000LL };
+static const size_t resolution_capacity[] = { 3600, 1440, 2016 };
+
+// the trades of one ticker within one period
+struct candle
+{
+    // start of the period, in nanoseconds since the epoch
+    long long start;
+
+    int open;
+    int high;
+    int low;
+    int close;
+
+    long long volume;
+    // sum of price times volume, the volume weighted average price is notional over volume
+    long long notional;
+    int trades;
+
+    auto vwap() const -> double;
+};
+
+/**
+ * @brief The latest candles of one ticker at one resolution, in a ring buffer
+ *
+ * Periods without trades have no candle.
+*/
+class candle_series
+{
+protected:
+    long long m_width;
+
+    // the ring, the latest candle is at m_head once there is one
+    vector<candle> m_ring;
+    size_t m_head;
+    size_t m_count;
+
+public:
+    candle_series(resolution res = resolution::SECOND);
+
+    /**
+     * @brief Adds a trade to the candle of its period, starting a new candle once a period has passed
+     * @param time Not earlier than the last trade
+     * @param price
+     * @param volume
+     * @return
+    */
+    auto add(long long time, int price, int volume) -> void;
+
+    // returns the latest candles, oldest first
+    auto latest(size_t count) const->vector<candle>;
+
+    // returns the candle of the latest period with trades
+    auto last() const->optional<candle>;
+
+    auto size() const -> size_t;
+};
+
+/**
+ * @brief Candles of every ticker at every resolution, each updated in constant time per trade
+*/
+class candles
+{
+protected:
+    map<ids::ticker_id, array<candle_series, RESOLUTIONS>> m_series;
+
+public:
+    candles();
+
+    // adds a trade to every resolution of its ticker
+    auto add(const transaction &trans) -> void;
+
+    /**
+     * @brief Returns the latest candles of a ticker
+     * @param ticker_id
+     * @param res
+     * @param count The most candles returned
+     * @return The candles, oldest first
+    */
+    auto get(ids::ticker_id ticker_id, resolution res, size_t count) const->vector<candle>;
+
+    // returns the candle of the latest period a ticker traded in
+    auto last(ids::ticker_id ticker_id, resolution res) const->optional<candle>;
+};
+
+};
@@ -0,0 +1,200 @@
+#include "config.h"
+
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using nlohmann::json;
+
+static auto parse_allocation(const std::string &policy) -> market::allocation
+{
+    for (size_t i = 0; i < std::size(market::allocation_repr); ++i)
+    {
+        if (policy == market::allocation_repr[i])
+            return static_cast<market::allocation>(i);
+    }
+    throw std::runtime_error(fmt::format("unknown allocation {}", policy));
+}
+
+static auto parse_pages(const std::string &pages) -> market::page_backing
+{
+    for (size_t i = 0; i < std::size(market::page_backing_repr); ++i)
+    {
+        if (pages == market::page_backing_repr[i])
+            return static_cast<market::page_backing>(i);
+    }
+    throw std::runtime_error(fmt::format("unknown pages {}", pages));
+}
+
+static auto parse_profile(const std::string &profile) -> network::latency_profile
+{
+    for (size_t i = 0; i < std::size(network::latency_profile_repr); ++i)
+    {
+        if (profile == network::latency_profile_repr[i])
+            return static_cast<network::latency_profile>(i);
+    }
+    throw std::runtime_error(fmt::format("unknown profile {}", profile));
+}
+
+auto network::load_config(const std::string &path) -> server_config
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error(fmt::format("cannot open config {}", path));
+
+    json root = json::parse(file);
+    server_config config;
+
+    config.port = root.value("port", config.port);
+    config.tick_ms = root.value("tick_ms", config.tick_ms);
+    config.threads = root.value("threads", config.threads);
+    config.shm_sessions = root.value("shm_sessions", config.shm_sessions);
+    config.cancel_on_disconnect = root.value("cancel_on_disconnect", config.cancel_on_disconnect);
+    if (config.tick_ms <= 0 || config.threads == 0)
+        throw std::runtime_error("tick_ms and threads must be positive");
+
+    if (root.contains("outbound"))
+    {
+        const json &outbound = root["outbound"];
+        outbound_limits &limits = config.outbound;
+        limits.max_messages = outbound.value("max_messages", limits.max_messages);
+        limits.max_bytes = outbound.value("max_bytes", limits.max_bytes);
+        limits.max_buffered = outbound.value("max_buffered", limits.max_buffered);
+        limits.max_lagging_ticks = outbound.value("max_lagging_ticks", limits.max_lagging_ticks);
+    }
+
+    if (root.contains("throttles"))
+    {
+        const json &throttles = root["throttles"];
+        throttle_limits &limits = config.throttles;
+        limits.messages_per_second = throttles.value("messages_per_second", limits.messages_per_second);
+        limits.message_burst = throttles.value("message_burst", limits.message_burst);
+        limits.bytes_per_second = throttles.value("bytes_per_second", limits.bytes_per_second);
+        limits.byte_burst = throttles.value("byte_burst", limits.byte_burst);
+        limits.user_messages_per_second = throttles.value("user_messages_per_second", limits.user_messages_per_second);
+        limits.user_message_burst = throttles.value("user_message_burst", limits.user_message_burst);
+        limits.violations_per_second = throttles.value("violations_per_second", limits.violations_per_second);
+        limits.violation_burst = throttles.value("violation_burst", limits.violation_burst);
+        limits.penalty = std::chrono::seconds(throttles.value("penalty_seconds", limits.penalty.count()));
+    }
+
+    if (root.contains("runtime"))
+    {
+        const json &runtime = root["runtime"];
+        runtime_config &cores = config.runtime;
+        cores.profile = parse_profile(runtime.value("profile", latency_profile_repr[static_cast<int>(cores.profile)]));
+        cores.exchange_core = runtime.value("exchange_core", cores.exchange_core);
+        cores.publisher_core = runtime.value("publisher_core", cores.publisher_core);
+        cores.io_core = runtime.value("io_core", cores.io_core);
+    }
+
+    // listing tickers or users replaces those of the exchange game
+    market::universe &universe = config.universe;
+    if (root.contains("tickers"))
+    {
+        universe.tickers.clear();
+        for (const json &ticker : root["tickers"])
+        {
+            universe.tickers.push_back({
+                ticker.at("id").get<ids::ticker_id>(),
+                ticker.at("alias").get<std::string>(),
+                ticker.value("tick_size", 1),
+                parse_allocation(ticker.value("allocation", "fifo"))
+            });
+            if (universe.tickers.back().id == 0 || universe.tickers.back().tick_size <= 0)
+                throw std::runtime_error(fmt::format("ticker {} needs an id and tick size above 0", universe.tickers.back().alias));
+        }
+    }
+
+    if (root.contains("users"))
+    {
+        universe.users.clear();
+        for (const json &user : root["users"])
+        {
+            std::string name = user.at("name");
+            universe.users.push_back({
+                user.at("id").get<ids::user_id>(), name, user.value("passphase", name), user.value("admin", false)
+            });
+        }
+    }
+
+    if (root.contains("reserve"))
+    {
+        const json &reserve = root["reserve"];
+        universe.reserve.orders = reserve.value("orders", universe.reserve.orders);
+        universe.reserve.levels = reserve.value("levels", universe.reserve.levels);
+        universe.reserve.transactions = reserve.value("transactions", universe.reserve.transactions);
+        universe.reserve.pages = parse_pages(reserve.value("pages", market::page_backing_repr[static_cast<int>(universe.reserve.pages)]));
+    }
+
+    return config;
+}
+
+auto network::config_json(const server_config &config) -> json
+{
+    json tickers = json::array();
+    for (const market::ticker_spec &ticker : config.universe.tickers)
+    {
+        tickers.push_back({
+            {"id", ticker.id},
+            {"alias", ticker.alias},
+            {"tick_size", ticker.tick_size},
+            {"allocation", market::allocation_repr[static_cast<int>(ticker.policy)]}
+        });
+    }
+
+    json users = json::array();
+    for (const market::user_spec &user : config.universe.users)
+    {
+        users.push_back({
+            {"id", user.id},
+            {"name", user.name},
+            {"passphase", user.passphase},
+            {"admin", user.admin}
+        });
+    }
+
+    const outbound_limits &outbound = config.outbound;
+    const throttle_limits &throttles = config.throttles;
+    const runtime_config &runtime = config.runtime;
+    const market::capacity &reserve = config.universe.reserve;
+    return {
+        {"port", config.port},
+        {"tick_ms", config.tick_ms},
+        {"threads", config.threads},
+        {"shm_sessions", config.shm_sessions},
+        {"cancel_on_disconnect", config.cancel_on_disconnect},
+        {"outbound", {
+            {"max_messages", outbound.max_messages},
+            {"max_bytes", outbound.max_bytes},
+            {"max_buffered", outbound.max_buffered},
+            {"max_lagging_ticks", outbound.max_lagging_ticks}
+        }},
+        {"throttles", {
+            {"messages_per_second", throttles.messages_per_second},
+            {"message_burst", throttles.message_burst},
+            {"bytes_per_second", throttles.bytes_per_second},
+            {"byte_burst", throttles.byte_burst},
+            {"user_messages_per_second", throttles.user_messages_per_second},
+            {"user_message_burst", throttles.user_message_burst},
+            {"violations_per_second", throttles.violations_per_second},
+            {"violation_burst", throttles.violation_burst},
+            {"penalty_seconds", throttles.penalty.count()}
+        }},
+        {"runtime", {
+            {"profile", latency_profile_repr[static_cast<int>(runtime.profile)]},
+            {"exchange_core", runtime.exchange_core},
+            {"publisher_core", runtime.publisher_core},
+            {"io_core", runtime.io_core}
+        }},
+        {"reserve", {
+            {"orders", reserve.orders},
+            {"levels", reserve.levels},
+            {"transactions", reserve.transactions},
+            {"pages", market::page_backing_repr[static_cast<int>(reserve.pages)]}
+        }},
+        {"tickers", tickers},
+        {"users", users}
+    };
+}
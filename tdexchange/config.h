@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "universe.h"
+#include "outbound.h"
+#include "throttle.h"
+#include "affinity.h"
+
+namespace network
+{
+
+/**
+ * @brief Everything a server starts with, read from a config file or the defaults of the exchange game
+*/
+struct server_config
+{
+    unsigned short port = 8080;
+    // time between two ticks, and threads running the tasks of connections
+    int tick_ms = 40;
+    size_t threads = 8;
+
+    // shared memory sessions offered to co-located clients, one for each of the 20 bots
+    size_t shm_sessions = 20;
+    bool cancel_on_disconnect = false;
+
+    outbound_limits outbound;
+    throttle_limits throttles;
+
+    // the cores of the hot threads and how they wait
+    runtime_config runtime;
+
+    market::universe universe = market::default_universe();
+};
+
+/**
+ * @brief Reads a config file, every key missing is left at its default, raising exceptions when it cannot
+ * @param path A json file, laid out like config_json
+ * @return
+*/
+auto load_config(const std::string &path) -> server_config;
+
+// the config as json, as read by load_config
+auto config_json(const server_config &config) -> nlohmann::json;
+
+};
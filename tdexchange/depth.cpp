@@ -0,0 +1,100 @@
+#include "depth.h"
+
+#include <algorithm>
+
+market::depth::depth(side wish)
+    : m_side(wish), m_prices(), m_shown(), m_total()
+{
+}
+
+auto market::depth::reserve(size_t levels) -> void
+{
+    m_prices.reserve(levels);
+    m_shown.reserve(levels);
+    m_total.reserve(levels);
+}
+
+auto market::depth::set(int price, long long shown, long long hidden) -> void
+{
+    // matching works at the best level, so it is checked before searching
+    size_t i = 0;
+    if (m_prices.empty() || m_prices[0] != price)
+    {
+        i = std::lower_bound(m_prices.begin(), m_prices.end(), price, [&](int level, int p)
+        {
+            return better(level, p);
+        }) - m_prices.begin();
+    }
+    bool found = i < m_prices.size() && m_prices[i] == price;
+
+    if (shown + hidden == 0)
+    {
+        if (found)
+        {
+            m_prices.erase(m_prices.begin() + i);
+            m_shown.erase(m_shown.begin() + i);
+            m_total.erase(m_total.begin() + i);
+        }
+        return;
+    }
+
+    if (!found)
+    {
+        m_prices.insert(m_prices.begin() + i, price);
+        m_shown.insert(m_shown.begin() + i, 0);
+        m_total.insert(m_total.begin() + i, 0);
+    }
+    m_shown[i] = shown;
+    m_total[i] = shown + hidden;
+}
+
+auto market::depth::through(int price) const -> size_t
+{
+    return std::upper_bound(m_prices.begin(), m_prices.end(), price, [&](int p, int level)
+    {
+        return better(p, level);
+    }) - m_prices.begin();
+}
+
+auto market::depth::available(int price, long long limit) const -> long long
+{
+    return kernels::sum_until(m_total.data(), through(price), limit);
+}
+
+auto market::depth::cumulative(kernels::aligned_vector<long long> &out) const -> void
+{
+    out.resize(m_total.size());
+    kernels::prefix_sum(m_total.data(), out.data(), m_total.size());
+}
+
+auto market::depth::best(size_t levels) const -> vector<depth_level>
+{
+    levels = std::min(levels, m_prices.size());
+
+    vector<depth_level> book(levels);
+    for (size_t i = 0; i < levels; ++i)
+    {
+        book[i] = { m_prices[i], static_cast<int>(m_shown[i]) };
+    }
+    return book;
+}
+
+auto market::depth::size() const -> size_t
+{
+    return m_prices.size();
+}
+
+auto market::depth::empty() const -> bool
+{
+    return m_prices.empty();
+}
+
+auto market::depth::get_prices() const -> const kernels::aligned_vector<int> &
+{
+    return m_prices;
+}
+
+auto market::depth::better(int price, int other) const -> bool
+{
+    return m_side == side::BID ? side_traits<side::BID>::better(price, other) : side_traits<side::ASK>::better(price, other);
+}
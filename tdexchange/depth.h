@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include "order.h"
+#include "kernels.h"
+
+namespace market
+{
+
+using namespace std;
+
+// the shown volume at a price, as published in the order book
+struct depth_level
+{
+    int price;
+    int volume;
+};
+
+/**
+ * @brief The price levels of one side of an order book, as flat arrays ordered best price first
+ *
+ * Mirrors the level volumes of the book, so depth queries read contiguous aligned memory with the vector kernels
+ * instead of walking the tree of levels. Levels are updated in place, and only inserting or removing a level
+ * moves the levels behind it.
+*/
+class depth
+{
+protected:
+    side m_side;
+
+    // by level, best price first
+    kernels::aligned_vector<int> m_prices;
+    kernels::aligned_vector<long long> m_shown;
+    // the shown and the iceberg reserve volume
+    kernels::aligned_vector<long long> m_total;
+
+public:
+    depth(side wish);
+
+    // reserves room for a number of levels
+    auto reserve(size_t levels) -> void;
+
+    /**
+     * @brief Sets the volume at a price, adding the level if it is new and removing it once it has no volume
+     * @param price
+     * @param shown The volume shown
+     * @param hidden The reserve of the iceberg orders
+     * @return
+    */
+    auto set(int price, long long shown, long long hidden) -> void;
+
+    // returns the number of levels at the price or better
+    auto through(int price) const -> size_t;
+
+    /**
+     * @brief Returns the total volume, including reserves, resting at the price or better
+     * @param price The worst price
+     * @param limit Counting may stop once the limit is reached
+     * @return The volume, only exact below the limit
+    */
+    auto available(int price, long long limit) const -> long long;
+
+    /**
+     * @brief Returns the total volume, including reserves, resting at each level and every better one
+     * @param out Filled with the cumulative volume by level, best price first
+     * @return
+    */
+    auto cumulative(kernels::aligned_vector<long long> &out) const -> void;
+
+    // returns the shown volume of the best levels, best price first
+    auto best(size_t levels) const->vector<depth_level>;
+
+    auto size() const -> size_t;
+    auto empty() const -> bool;
+    auto get_prices() const -> const kernels::aligned_vector<int> &;
+
+protected:
+    // returns whether a price is better than another on this side
+    auto better(int price, int other) const -> bool;
+};
+
+};
@@ -5,140 +5,540 @@
 #include <cassert>
 #include <string>
 #include <set>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
 
+// most triggered stops executed in one go, the rest wait for the next order or tick
+static const int MAX_STOP_CASCADE = 256;
 
 
-market::exchange::exchange()
+
+// the wall clock, in nanoseconds since the epoch
+static auto wall_clock() -> long long
 {
-    // create fake users and tickers
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
-    // fake tickers
-    m_tickers = {
-        {
-            1,
-            { "PHILIPS_A", 1 }
-        },
+market::exchange::command_scope::command_scope(exchange &owner, command cmd)
+    : m_owner(owner)
+{
+    if (m_owner.m_depth++ > 0)
+        return;
+
+    // a replayed command runs at the time it first ran, so it makes the same trades and risk decisions
+    if (m_owner.m_replaying != nullptr)
+    {
+        // the call did something else than the one journaled, so the exchanges have diverged
+        if (m_owner.m_replaying->type != cmd.type)
         {
-            2,
-            { "PHILIPS_B", 2 }
+            m_owner.m_depth -= 1;
+            throw std::runtime_error(fmt::format("command {} was journaled as {} but replayed as {}", m_owner.m_replaying->sequence,
+                command_type_repr[static_cast<int>(m_owner.m_replaying->type)], command_type_repr[static_cast<int>(cmd.type)]));
         }
-    };
-
-    // fake users
-    m_users = {};
+        cmd.time = m_owner.m_replaying->time;
+    }
+    else
+    {
+        cmd.time = wall_clock();
+    }
 
-    // create bots
-    for (int i = 0; i < 20; ++i)
+    cmd.sequence = ++m_owner.m_sequence;
+    m_owner.m_now = cmd.time;
+    if (m_owner.m_journaling)
     {
-        m_users.insert({ i, { fmt::format("bot-{:02}", i), i } });
+        m_owner.m_journal.push_back(cmd);
     }
+}
+
+market::exchange::command_scope::~command_scope()
+{
+    m_owner.m_depth -= 1;
+}
 
-    // create trading accounts
-    for (char c = 'a'; c <= 'p'; ++c)
+market::exchange::exchange(const universe &config, const partition &part)
+    : m_arena(config.reserve.pages), m_last_trade_time(0), m_partition(part), m_sequence(0), m_journaling(false), m_journal(&m_arena), m_now(0),
+    m_replaying(nullptr), m_depth(0)
+{
+    // everything trading grows is reserved up front, tickers first so the position matrix is only widened empty
+    size_t owned = std::ranges::count_if(config.tickers, [&](const ticker_spec &spec) { return m_partition.owns(spec.id); });
+    m_accounts.reserve(config.users.size(), owned, config.reserve.orders);
+    m_transactions.reserve(config.reserve.transactions);
+
+    // tickers, only those of this partition
+    for (const ticker_spec &spec : config.tickers)
     {
-        m_users.insert({ (int)c, { fmt::format("trading-{}", c), (int)c } });
+        if (!m_partition.owns(spec.id))
+            continue;
+
+        ticker &listed = m_tickers.emplace(spec.id, ticker{ spec.alias, spec.id, spec.policy, spec.tick_size, &m_arena }).first->second;
+        listed.reserve(config.reserve.levels, config.reserve.orders);
+        m_accounts.add_ticker(spec.id);
     }
 
-    // create admin
-    m_users.insert({ 1000, {"terry", 1000, true} });
+    for (const user_spec &spec : config.users)
+    {
+        m_accounts.add_user(spec.id, { spec.name, spec.passphase, spec.admin });
+    }
 }
 
-auto market::exchange::user_order(side _side, ids::user_id userid, ids::ticker_id tickerid, int price, int volume, bool ioc) -> void
+auto market::exchange::user_order(side _side, ids::user_id userid, ids::ticker_id tickerid, int price, int volume, order_type type, int display, self_trade stp) -> order_result
 {
-    if (ioc)
+    command_scope scope(*this, {
+        .type = command_type::ORDER, .wish = _side, .user = userid, .ticker = tickerid,
+        .price = price, .volume = volume, .display = display, .kind = type, .stp = stp
+    });
+
+    logger::log(fmt::format("user {} ordered {} on {} of {} @ {}, display {}",
+        userid, order_type_repr[static_cast<int>(type)], tickerid, volume, price, display));
+
+    assert(m_tickers.contains(tickerid));
+    assert(m_accounts.contains(userid));
+
+    // an empty order can never rest in a price level
+    if (volume <= 0)
     {
-        logger::log(fmt::format("user {} ordered IOC on {} of {} @ {}", userid, tickerid, volume, price));
+        logger::log(fmt::format("user {} ordered a non-positive volume {}, rejected", userid, volume), logger::mode::WARN);
+        return { 0, order_status::REJECTED, 0 };
     }
-    else
+
+    // only orders that can rest may hide volume
+    bool rests = type == order_type::LIMIT || type == order_type::POST_ONLY;
+    if (display < 0 || (display > 0 && !rests))
     {
-        logger::log(fmt::format("user {} ordered LIM on {} of {} @ {}", userid, tickerid, volume, price));
+        logger::log(fmt::format("user {} ordered an invalid display volume {}, rejected", userid, display), logger::mode::WARN);
+        return { 0, order_status::REJECTED, 0 };
     }
 
+    if (type != order_type::MARKET && !m_tickers[tickerid].on_tick(price))
+    {
+        logger::log(fmt::format("user {} ordered at {}, off the tick size of {}, rejected", userid, price, tickerid), logger::mode::WARN);
+        return { 0, order_status::REJECTED, 0 };
+    }
 
+    // market orders take any price
+    if (type == order_type::MARKET)
+    {
+        price = _side == side::BID ? numeric_limits<int>::max() : numeric_limits<int>::min();
+    }
+
+    const ticker &ticker = m_tickers[tickerid];
+
+    // auctions only collect limit orders, everything else relies on trading immediately
+    if (ticker.get_phase() != market_phase::CONTINUOUS && type != order_type::LIMIT)
+    {
+        logger::log(fmt::format("user {} ordered {} during the {} phase, rejected",
+            userid, order_type_repr[static_cast<int>(type)], market_phase_repr[static_cast<int>(ticker.get_phase())]));
+        return { 0, order_status::REJECTED, 0 };
+    }
+
+    order neworder{ m_partition.order_id(m_order_id.get("order")), userid, tickerid, _side, price, volume, display, 0, stp };
+
+    risk_check check = m_risk.check(get_user(userid), ticker, neworder, type, m_now);
+    if (check != risk_check::PASSED)
+    {
+        logger::log(fmt::format("order {} failed the {} check, rejected", neworder.id, risk_check_repr[static_cast<int>(check)]));
+        return { neworder.id, order_status::REJECTED, 0, check };
+    }
+
+    // checks that must not touch the book
+    if (type == order_type::POST_ONLY && ticker.crosses(neworder))
+    {
+        logger::log(fmt::format("post only order {} would cross, rejected", neworder.id));
+        return { neworder.id, order_status::REJECTED, 0 };
+    }
+
+    if (type == order_type::FOK && ticker.available(neworder) < volume)
+    {
+        logger::log(fmt::format("fill or kill order {} cannot be filled, rejected", neworder.id));
+        return { neworder.id, order_status::REJECTED, 0 };
+    }
+
+    order_result result = execute(neworder, type);
+    run_stops(tickerid);
+
+    return result;
+}
+
+auto market::exchange::user_stop_order(side _side, ids::user_id userid, ids::ticker_id tickerid, int trigger, int price, int volume, order_type type, self_trade stp) -> order_result
+{
+    command_scope scope(*this, {
+        .type = command_type::STOP_ORDER, .wish = _side, .user = userid, .ticker = tickerid,
+        .price = price, .volume = volume, .trigger = trigger, .kind = type, .stp = stp
+    });
+
+    logger::log(fmt::format("user {} ordered {} on {} of {} @ {} triggered at {}",
+        userid, order_type_repr[static_cast<int>(type)], tickerid, volume, price, trigger));
 
     assert(m_tickers.contains(tickerid));
-    assert(m_users.contains(userid));
+    assert(m_accounts.contains(userid));
+    assert(type == order_type::STOP || type == order_type::STOP_LIMIT);
 
-    order neworder{ m_order_id.get("order"), userid, tickerid, _side, price, volume };
-    // add order to user and ticker
-    m_tickers[tickerid].add_order(neworder);
-    m_users[userid].add_order(neworder);
+    if (volume <= 0)
+    {
+        logger::log(fmt::format("user {} ordered a non-positive volume {}, rejected", userid, volume), logger::mode::WARN);
+        return { 0, order_status::REJECTED, 0 };
+    }
 
-    // proccess/match order
-    process_order(neworder);
+    const ticker &listed = m_tickers[tickerid];
+    if (!listed.on_tick(trigger) || (type == order_type::STOP_LIMIT && !listed.on_tick(price)))
+    {
+        logger::log(fmt::format("user {} ordered a stop at {} triggered at {}, off the tick size of {}, rejected",
+            userid, price, trigger, tickerid), logger::mode::WARN);
+        return { 0, order_status::REJECTED, 0 };
+    }
 
-    // if is IOC order
-    if (ioc)
+    order_type triggered = order_type::LIMIT;
+    if (type == order_type::STOP)
     {
-        // immediate cancel it from both the tickers and users
-        if (m_tickers[tickerid].has_order(neworder))
-        {
-            m_tickers[tickerid].cancel_order(neworder);
-        }
+        triggered = order_type::MARKET;
+        price = _side == side::BID ? numeric_limits<int>::max() : numeric_limits<int>::min();
+    }
+
+    order neworder{ m_partition.order_id(m_order_id.get("order")), userid, tickerid, _side, price, volume, 0, 0, stp };
+
+    // stops are not open orders until triggered, so only what they could trade as is checked
+    risk_check check = m_risk.check(get_user(userid), m_tickers[tickerid], neworder, order_type::MARKET, m_now);
+    if (check != risk_check::PASSED)
+    {
+        logger::log(fmt::format("stop order {} failed the {} check, rejected", neworder.id, risk_check_repr[static_cast<int>(check)]));
+        return { neworder.id, order_status::REJECTED, 0, check };
+    }
+
+    m_tickers[tickerid].add_stop({ neworder, trigger, triggered });
+
+    return { neworder.id, order_status::PENDING, 0 };
+}
+
+auto market::exchange::run_stops() -> void
+{
+    // checked before the command is numbered, so idle ticks journal nothing
+    if (std::ranges::none_of(m_tickers, [](const auto &listed) { return listed.second.has_triggered(); }))
+        return;
+
+    command_scope scope(*this, { .type = command_type::STOPS });
+
+    for (auto &[id, _] : m_tickers)
+    {
+        run_stops(id);
+    }
+}
+
+auto market::exchange::set_phase(ids::ticker_id tickerid, market_phase phase) -> void
+{
+    command_scope scope(*this, { .type = command_type::PHASE, .ticker = tickerid, .phase = phase });
+
+    assert(m_tickers.contains(tickerid));
 
-        if (m_users[userid].has_order(neworder))
+    ticker &ticker = m_tickers[tickerid];
+    logger::log(fmt::format("ticker {} moving from the {} to the {} phase", tickerid,
+        market_phase_repr[static_cast<int>(ticker.get_phase())], market_phase_repr[static_cast<int>(phase)]));
+
+    // the opening auction, orders collected so far are crossed before continuous trading starts
+    if (ticker.get_phase() != market_phase::CONTINUOUS && phase == market_phase::CONTINUOUS)
+    {
+        auction(tickerid);
+    }
+
+    ticker.set_phase(phase);
+    run_stops(tickerid);
+}
+
+auto market::exchange::run_auction(ids::ticker_id tickerid) -> int
+{
+    command_scope scope(*this, { .type = command_type::AUCTION, .ticker = tickerid });
+
+    assert(m_tickers.contains(tickerid));
+
+    // stops triggered by the auction run within it, resting for the next auction outside continuous trading
+    int total_volume = auction(tickerid);
+    run_stops(tickerid);
+
+    return total_volume;
+}
+
+auto market::exchange::run_batch_auctions() -> void
+{
+    // only a crossed book in the batch phase trades, ticks without one journal nothing
+    auto due = [](const ticker &listed) { return listed.get_phase() == market_phase::BATCH && listed.crossed(); };
+    if (std::ranges::none_of(m_tickers, [&](const auto &listed) { return due(listed.second); }))
+        return;
+
+    command_scope scope(*this, { .type = command_type::BATCH_AUCTIONS });
+
+    for (auto &[id, ticker] : m_tickers)
+    {
+        if (due(ticker))
         {
-            m_users[userid].remove_order(neworder);
+            auction(id);
+            run_stops(id);
         }
     }
 }
 
-auto market::exchange::user_cancel(ids::user_id userid) -> void
+auto market::exchange::user_cancel(ids::user_id userid) -> int
 {
-    assert(m_users.contains(userid));
+    command_scope scope(*this, { .type = command_type::MASS_CANCEL, .user = userid });
 
-    logger::log(fmt::format("cancelling all orders for user {}", userid));
+    assert(m_accounts.contains(userid));
 
-    auto &user = m_users[userid];
-    vector<ids::order_id> ords = user.get_orders();
-    for (ids::order_id ord : ords)
+    // one pass over the user's orders, each pulled from its level in constant time
+    int cancelled = m_accounts.remove_orders(m_accounts.index(userid), [&](const order &o)
     {
-        const order &o = user.view_order(ord);
-
         m_tickers[o.ticker_id].cancel_order(o);
-        user.remove_order(o);
+        return true;
+    });
 
-        logger::log(fmt::format("cancelled order {}", o.id));
+    for (auto &[_, ticker] : m_tickers)
+    {
+        cancelled += ticker.cancel_user_stops(userid);
     }
 
-
+    logger::log(fmt::format("cancelled {} orders for user {}", cancelled, userid));
+    return cancelled;
 }
 
 auto market::exchange::user_cancel_ticker(ids::user_id userid, ids::ticker_id tickerid) -> void
 {
-    assert(m_users.contains(userid));
+    command_scope scope(*this, { .type = command_type::CANCEL_TICKER, .user = userid, .ticker = tickerid });
+
+    assert(m_accounts.contains(userid));
     assert(m_tickers.contains(tickerid));
 
     logger::log(fmt::format("cancelling all orders on {} for user {}", tickerid, userid));
 
-    auto &user = m_users[userid];
-    vector<ids::order_id> ords = user.get_orders();
-    for (ids::order_id ord : ords)
+    m_accounts.remove_orders(m_accounts.index(userid), [&](const order &o)
     {
-        const order &o = user.view_order(ord);
-
         // but we skip the non-matching tickers
         if (o.ticker_id != tickerid)
-            continue;
+            return false;
 
         m_tickers[o.ticker_id].cancel_order(o);
-        user.remove_order(o);
-
         logger::log(fmt::format("cancelled order {}", o.id));
+        return true;
+    });
+
+    m_tickers[tickerid].cancel_user_stops(userid);
+}
+
+auto market::exchange::user_cancel_order(ids::user_id userid, ids::order_id orderid) -> bool
+{
+    command_scope scope(*this, { .type = command_type::CANCEL, .user = userid, .order = orderid });
+
+    assert(m_accounts.contains(userid));
+
+    if (!get_user(userid).has_order(orderid))
+    {
+        // it may be a stop that is not in the book yet
+        for (auto &[_, ticker] : m_tickers)
+        {
+            if (ticker.cancel_stop(userid, orderid))
+            {
+                logger::log(fmt::format("cancelled stop order {}", orderid));
+                return true;
+            }
+        }
+
+        logger::log(fmt::format("user {} cannot cancel unknown order {}", userid, orderid));
+        return false;
     }
+
+    // copy, as removing from the user invalidates the reference
+    order o = m_accounts.view_order(orderid);
+    m_tickers[o.ticker_id].cancel_order(o);
+    m_accounts.remove_order(o);
+
+    logger::log(fmt::format("cancelled order {}", o.id));
+    return true;
 }
 
-auto market::exchange::user_auth(const std::string &name, const std::string &passphase) const -> std::optional<int>
+auto market::exchange::user_amend_order(ids::user_id userid, ids::order_id orderid, int price, int volume) -> bool
+{
+    command_scope scope(*this, { .type = command_type::AMEND, .user = userid, .order = orderid, .price = price, .volume = volume });
+
+    assert(m_accounts.contains(userid));
+
+    user user = get_user(userid);
+    if (!user.has_order(orderid) || volume <= 0)
+    {
+        logger::log(fmt::format("user {} cannot amend order {} to {} @ {}", userid, orderid, volume, price));
+        return false;
+    }
+
+    order o = user.view_order(orderid);
+    if (!m_tickers[o.ticker_id].on_tick(price))
+    {
+        logger::log(fmt::format("user {} cannot amend order {} to {}, off the tick size", userid, orderid, price));
+        return false;
+    }
+
+    order amended = o;
+    amended.price = price;
+    amended.volume = volume;
+
+    logger::log(fmt::format("user {} amending order {} from {} @ {} to {} @ {}", userid, orderid, o.volume, o.price, volume, price));
+
+    // a size down in place keeps its priority and can never cross
+    if (price == o.price && volume <= o.volume)
+    {
+        m_tickers[o.ticker_id].amend_order(o, amended);
+        m_accounts.amend_order(amended);
+        return true;
+    }
+
+    risk_check check = m_risk.check(user, m_tickers[o.ticker_id], amended, order_type::LIMIT, m_now, &o);
+    if (check != risk_check::PASSED)
+    {
+        logger::log(fmt::format("amend of order {} failed the {} check, rejected", orderid, risk_check_repr[static_cast<int>(check)]));
+        return false;
+    }
+
+    // anything else pulls the order and enters it again as a new aggressor with the same id
+    m_tickers[o.ticker_id].cancel_order(o);
+    m_accounts.remove_order(o);
+    execute(amended, order_type::LIMIT);
+    run_stops(o.ticker_id);
+
+    return true;
+}
+
+auto market::exchange::user_queue_positions(ids::user_id userid, ids::ticker_id tickerid) const -> vector<queue_position>
 {
-    for (const auto &[id, u] : m_users)
+    assert(m_accounts.contains(userid));
+    assert(m_tickers.contains(tickerid));
+
+    const ticker &ticker = m_tickers.at(tickerid);
+
+    vector<queue_position> positions;
+    m_accounts.for_each_order(m_accounts.index(userid), [&](const order &o)
     {
-        if (u.match(name, passphase))
+        if (o.ticker_id == tickerid)
         {
-            return { id };
+            positions.push_back(ticker.get_queue_position(o));
         }
+    });
+
+    return positions;
+}
+
+auto market::exchange::get_risk_limits() const -> const risk_limits &
+{
+    return m_risk.get_limits();
+}
+
+auto market::exchange::set_risk_limits(const risk_limits &limits) -> void
+{
+    m_risk.set_limits(limits);
+}
+
+auto market::exchange::apply(const command &cmd) -> bool
+{
+    // a command received twice was already applied the first time
+    if (cmd.sequence <= m_sequence)
+    {
+        logger::log(fmt::format("dropping command {}, already at {}", cmd.sequence, m_sequence), logger::mode::WARN);
+        return false;
+    }
+    if (cmd.sequence != m_sequence + 1)
+    {
+        throw std::runtime_error(fmt::format("command {} follows {}, the commands between are missing", cmd.sequence, m_sequence));
+    }
+
+    m_replaying = &cmd;
+    try
+    {
+        dispatch(cmd);
+    }
+    catch (...)
+    {
+        m_replaying = nullptr;
+        throw;
+    }
+    m_replaying = nullptr;
+
+    // the call returned before it was numbered, so it took another path than when it was journaled
+    if (m_sequence != cmd.sequence)
+    {
+        throw std::runtime_error(fmt::format("command {} was journaled but not replayed", cmd.sequence));
+    }
+    return true;
+}
+
+auto market::exchange::dispatch(const command &cmd) -> void
+{
+    switch (cmd.type)
+    {
+    case command_type::ORDER:
+        user_order(cmd.wish, cmd.user, cmd.ticker, cmd.price, cmd.volume, cmd.kind, cmd.display, cmd.stp);
+        break;
+    case command_type::STOP_ORDER:
+        user_stop_order(cmd.wish, cmd.user, cmd.ticker, cmd.trigger, cmd.price, cmd.volume, cmd.kind, cmd.stp);
+        break;
+    case command_type::CANCEL:
+        user_cancel_order(cmd.user, cmd.order);
+        break;
+    case command_type::AMEND:
+        user_amend_order(cmd.user, cmd.order, cmd.price, cmd.volume);
+        break;
+    case command_type::MASS_CANCEL:
+        user_cancel(cmd.user);
+        break;
+    case command_type::CANCEL_TICKER:
+        user_cancel_ticker(cmd.user, cmd.ticker);
+        break;
+    case command_type::PHASE:
+        set_phase(cmd.ticker, cmd.phase);
+        break;
+    case command_type::AUCTION:
+        run_auction(cmd.ticker);
+        break;
+    case command_type::BATCH_AUCTIONS:
+        run_batch_auctions();
+        break;
+    case command_type::STOPS:
+        run_stops();
+        break;
     }
+}
+
+auto market::exchange::set_journaling(bool journaling) -> void
+{
+    m_journaling = journaling;
+}
 
-    return std::nullopt;
+auto market::exchange::consume_journal() -> vector<command>
+{
+    // copied out, so the journal keeps its buffer in the arena
+    vector<command> commands(m_journal.begin(), m_journal.end());
+    m_journal.clear();
+    return commands;
+}
+
+auto market::exchange::get_sequence() const -> unsigned long long
+{
+    return m_sequence;
+}
+
+auto market::exchange::get_clock() const -> long long
+{
+    return std::max(m_now, m_last_trade_time);
+}
+
+auto market::exchange::get_partition() const -> const partition &
+{
+    return m_partition;
+}
+
+auto market::exchange::get_memory_stats() const -> memory_stats
+{
+    return m_arena.get_stats();
+}
+
+auto market::exchange::user_auth(const std::string &name, const std::string &passphase) const -> std::optional<int>
+{
+    return m_accounts.authenticate(name, passphase);
 }
 
 auto market::exchange::repr_tickers() const -> string
@@ -167,10 +567,10 @@ auto market::exchange::repr_users() const -> string
         valuations[ticker.first] = ticker.second.get_valuation();
     }
 
-    for (const auto &user : m_users)
+    for (const user &user : get_users())
     {
-        repr += user.second.repr();
-        repr += fmt::format("user assets {}\n", user.second.get_assets(valuations));
+        repr += user.repr();
+        repr += fmt::format("user assets {}\n", user.get_assets(valuations));
         repr += "\n";
     }
 
@@ -194,16 +594,37 @@ auto market::exchange::get_tickers() const -> const map<ids::ticker_id, ticker>
     return m_tickers;
 }
 
-auto market::exchange::get_user(ids::user_id id) const -> const user &
+auto market::exchange::get_user(ids::user_id id) const -> user
 {
-    assert(m_users.contains(id));
+    assert(m_accounts.contains(id));
 
-    return m_users.at(id);
+    return { m_accounts, m_accounts.index(id) };
 }
 
-auto market::exchange::get_users() const -> const map<ids::user_id, user> &
+auto market::exchange::get_users() const -> vector<user>
 {
-    return m_users;
+    vector<user> users;
+    users.reserve(m_accounts.size());
+    for (size_t index = 0; index < m_accounts.size(); ++index)
+    {
+        users.emplace_back(m_accounts, index);
+    }
+    return users;
+}
+
+auto market::exchange::consume_changed_users() -> vector<user>
+{
+    vector<user> users;
+    for (size_t index : m_accounts.consume_changed())
+    {
+        users.emplace_back(m_accounts, index);
+    }
+    return users;
+}
+
+auto market::exchange::get_accounts() const -> const accounts &
+{
+    return m_accounts;
 }
 
 auto market::exchange::get_ticker(ids::ticker_id id) const -> const ticker &
@@ -258,229 +679,200 @@ auto market::exchange::get_transactions() const -> const vector<transaction> &
 
 auto market::exchange::consume_transactions() -> vector<transaction>
 {
-    auto trans = m_transactions;
+    // copied out, so the reserved buffer is kept
+    vector<transaction> trans(m_transactions.begin(), m_transactions.end());
     m_transactions.clear();
     return trans;
 }
 
-auto market::exchange::process_order(const order &aggressor) -> void
+auto market::exchange::get_trades(ids::ticker_id tickerid, long long from, long long to) const -> vector<transaction>
 {
-    assert(m_tickers.contains(aggressor.ticker_id));
-    assert(m_users.contains(aggressor.user_id));
+    return m_history.range(tickerid, from, to);
+}
 
+auto market::exchange::get_user_trades(ids::user_id userid, long long from, long long to) const -> vector<transaction>
+{
+    return m_history.user_trades(userid, from, to);
+}
 
-    vector<transaction> transactions = m_tickers[aggressor.ticker_id].match(aggressor, m_transaction_id);
+auto market::exchange::get_history() const -> const trade_store &
+{
+    return m_history;
+}
 
-    // add to transaction history && logging
-    if (transactions.size() == 0)
-    {
-        logger::log("matched no transactions");
-    }
-    else
-    {
-        logger::log("matched the transactions:");
-    }
+auto market::exchange::get_candles() const -> const candles &
+{
+    return m_candles;
+}
 
-    for (transaction &trans : transactions)
+auto market::exchange::record(transaction &trans) -> void
+{
+    // the clock may step back, the history must not
+    m_last_trade_time = std::max(m_now, m_last_trade_time);
+    trans.time = m_last_trade_time;
+
+    m_transactions.push_back(trans);
+    m_history.append(trans);
+    m_candles.add(trans);
+}
+
+auto market::exchange::consume_events() -> vector<book_event>
+{
+    vector<book_event> events;
+    for (auto &[_, ticker] : m_tickers)
     {
-        logger::log(fmt::format("    {}", trans.repr()));
-        m_transactions.push_back(trans);
+        vector<book_event> ticker_events = ticker.consume_events();
+        events.insert(events.end(), ticker_events.begin(), ticker_events.end());
     }
+    return events;
+}
 
-    // perform transaction
-    int total_volume = 0;
-    for (const transaction &trans : transactions)
+auto market::exchange::execute(const order &aggressor, order_type type) -> order_result
+{
+    // outside of continuous trading limits wait for the next auction, stop limits triggered by one with them,
+    // market orders and the market orders of stops have no price to wait at
+    if (m_tickers[aggressor.ticker_id].get_phase() != market_phase::CONTINUOUS)
     {
-        total_volume += trans.volume;
-
-        ids::ticker_id ticker = trans.ticker_id;
-        m_tickers[ticker].process_transaction(aggressor, trans);
-
-        // update users' orders
-        if (aggressor.wish == side::BID)
+        if (type != order_type::LIMIT)
         {
-            // get the order reference for the other side of the transaction
-            const order &ord = m_users[trans.asker_id].view_order(trans.ask_id);
-
-            // update both users' order references
-            m_users[trans.asker_id].fill_order(ord, trans.price, trans.volume, side::ASK);
-            m_users[aggressor.user_id].fill_order(aggressor, trans.price, trans.volume, side::BID);
+            return { aggressor.id, order_status::CANCELLED, 0 };
         }
-        else if (aggressor.wish == side::ASK)
-        {
-            // get the order reference for the other side of the transaction
-            const order &ord = m_users[trans.bidder_id].view_order(trans.bid_id);
 
-            // update both userss order references
-            m_users[trans.bidder_id].fill_order(ord, trans.price, trans.volume, side::BID);
-            m_users[aggressor.user_id].fill_order(aggressor, trans.price, trans.volume, side::ASK);
-        }
+        m_tickers[aggressor.ticker_id].add_order(aggressor);
+        m_accounts.add_order(aggressor);
+        return { aggressor.id, order_status::RESTING, 0 };
     }
-}
 
-auto market::ticker::process_transaction(const order &aggressor, const transaction &trans) -> void
-{
-    // update valuation
-    m_valuation = trans.price;
+    // proccess/match order
+    auto [filled, prevented] = process_order(aggressor);
 
-    // process the transaction, namely to update the orderbooks
+    if (filled == aggressor.volume)
+    {
+        return { aggressor.id, order_status::FILLED, filled };
+    }
 
-    if (trans.aggressor == side::BID)
+    // only limits rest, the unfilled portion of anything else is cancelled, as is what self-trade prevention removed
+    if ((type != order_type::LIMIT && type != order_type::POST_ONLY) || filled + prevented == aggressor.volume)
     {
-        // if the aggressor is bid, we process the asks
+        return { aggressor.id, order_status::CANCELLED, filled };
+    }
 
-        // filled at the ask price
-        int ask_price = trans.price;
-        int vol = trans.volume;
-        ids::order_id ask_id = trans.ask_id;
+    // add the rest of the order to user and ticker
+    order rest = aggressor;
+    rest.volume -= filled + prevented;
+    m_tickers[rest.ticker_id].add_order(rest);
+    m_accounts.add_order(rest);
 
-        assert(m_asks.contains(ask_price));
-        vector<order> &orders = m_asks[ask_price];
+    return { aggressor.id, order_status::RESTING, filled };
+}
 
-        auto it = std::find_if(orders.begin(), orders.end(), [&](const order &val)
-        {
-            return val.id == ask_id;
-        });
-        assert(it != orders.end());
+auto market::exchange::auction(ids::ticker_id tickerid) -> int
+{
+    match_result result = m_tickers[tickerid].uncross(m_transaction_id);
+    reduce_orders(result.reduced);
 
-        // remove said order if it is completely filled
-        if (vol == it->volume)
-        {
-            orders.erase(it);
-            if (orders.size() == 0)
-            {
-                m_asks.erase(ask_price);
-            }
-        }
-        else
-        {
-            // otherwise we just reduce the volumne left
-            it->volume -= vol;
-        }
+    // both sides were resting, so both orders are filled on the users
+    int total_volume = 0;
+    for (transaction &trans : result.transactions)
+    {
+        logger::log(fmt::format("    {}", trans.repr()));
+        record(trans);
+        total_volume += trans.volume;
 
+        order bid = m_accounts.view_order(trans.bid_id);
+        m_accounts.fill_order(bid, trans.price, trans.volume, side::BID);
 
-        // update aggressor bid order
-        assert(m_bids.contains(aggressor.price) && m_bids[aggressor.price].size() == 1);
-        order &aggressor_order = m_bids[aggressor.price][0];
+        order ask = m_accounts.view_order(trans.ask_id);
+        m_accounts.fill_order(ask, trans.price, trans.volume, side::ASK);
+    }
 
-        // remove order if competely filled
-        if (aggressor_order.volume == vol)
+    return total_volume;
+}
+
+auto market::exchange::reduce_orders(const vector<pair<order, int>> &reduced) -> void
+{
+    // resting orders cut by self-trade prevention, with the volume left on them
+    for (const auto &[ord, left] : reduced)
+    {
+        order o = m_accounts.view_order(ord.id);
+        if (left == 0)
         {
-            // this price level must be empty, for we cannot have two aggressors on the same price level
-            assert(m_bids[aggressor.price].size() == 1);
-            m_bids.erase(aggressor.price);
+            m_accounts.remove_order(o);
         }
         else
         {
-            aggressor_order.volume -= vol;
+            o.volume = left;
+            m_accounts.amend_order(o);
         }
-
     }
-    else if (trans.aggressor == side::ASK)
-    {
-        // if the aggressor is ask, we focus on updating the bids
-
-        // filled at the bid price
-        int bid_price = trans.price;
-        int vol = trans.volume;
-        ids::order_id bid_id = trans.bid_id;
-
-        assert(m_bids.contains(bid_price));
-        vector<order> &orders = m_bids[bid_price];
+}
 
-        auto it = std::find_if(orders.begin(), orders.end(), [&](const order &val)
-        {
-            return val.id == bid_id;
-        });
-        assert(it != orders.end());
+auto market::exchange::run_stops(ids::ticker_id tickerid) -> void
+{
+    // stops triggered by a stop are executed in the same loop, bounded so a cascade cannot stall the tick
+    ticker &ticker = m_tickers[tickerid];
+    for (int i = 0; i < MAX_STOP_CASCADE && ticker.has_triggered(); ++i)
+    {
+        stop_order stop = ticker.pop_triggered();
 
-        // remove said order if it is completely filled
-        if (vol == it->volume)
-        {
-            orders.erase(it);
-            if (orders.size() == 0)
-            {
-                m_bids.erase(bid_price);
-            }
-        }
-        else
+        // the book and the user's exposure have moved since the stop was placed
+        risk_check check = m_risk.check_limits(get_user(stop.ord.user_id), ticker, stop.ord, stop.type);
+        if (check != risk_check::PASSED)
         {
-            // otherwise we just reduce the volumne left
-            it->volume -= vol;
+            logger::log(fmt::format("triggered stop {} failed the {} check, cancelled", stop.ord.id, risk_check_repr[static_cast<int>(check)]));
+            continue;
         }
 
-        // update aggressor ask order
-        assert(m_asks.contains(aggressor.price) && m_asks[aggressor.price].size() == 1);
-        order &aggressor_order = m_asks[aggressor.price][0];
+        logger::log(fmt::format("executing triggered stop {}", stop.ord.id));
 
-        // remove order if competely filled
-        if (aggressor_order.volume == vol)
-        {
-            assert(m_asks[aggressor.price].size() == 1);
-            m_asks.erase(aggressor.price);
-        }
-        else
-        {
-            aggressor_order.volume -= vol;
-        }
+        execute(stop.ord, stop.type);
     }
-}
 
-auto market::ticker::add_order(const order &aggressor) -> void
-{
-    if (aggressor.wish == side::BID)
+    if (ticker.has_triggered())
     {
-        m_bids[aggressor.price].push_back(aggressor);
-    }
-    else
-    {
-        m_asks[aggressor.price].push_back(aggressor);
+        logger::log(fmt::format("stop cascade on {} exceeded {} orders, deferred", tickerid, MAX_STOP_CASCADE), logger::mode::WARN);
     }
 }
 
-auto market::ticker::cancel_order(const order &ord) -> void
+auto market::exchange::process_order(const order &aggressor) -> pair<int, int>
 {
-    // find the order
+    assert(m_tickers.contains(aggressor.ticker_id));
+    assert(m_accounts.contains(aggressor.user_id));
 
-    if (ord.wish == side::BID)
-    {
-        assert(m_bids.contains(ord.price));
 
-        auto it = std::find_if(m_bids[ord.price].begin(), m_bids[ord.price].end(), [&](const auto &o)
-        {
-            return o.id == ord.id;
-        });
+    match_result result = m_tickers[aggressor.ticker_id].match(aggressor, m_transaction_id);
+    vector<transaction> &transactions = result.transactions;
 
-        // not found here
-        assert(it != m_bids[ord.price].end());
+    // resting orders cut by self-trade prevention all belong to the aggressor's user
+    reduce_orders(result.reduced);
 
-        // else found, and erase it
-        m_bids[ord.price].erase(it);
-        if (m_bids[ord.price].size() == 0)
-        {
-            m_bids.erase(ord.price);
-        }
+    // add to transaction history && logging
+    if (transactions.size() == 0)
+    {
+        logger::log("matched no transactions");
     }
-    else if (ord.wish == side::ASK)
+    else
     {
-        assert(m_asks.contains(ord.price));
+        logger::log("matched the transactions:");
+    }
 
-        auto it = std::find_if(
-            m_asks[ord.price].begin(), m_asks[ord.price].end(),
-            [&](const auto &o)
-        {
-            return o.id == ord.id;
-        });
-        // not found here
-        assert(it != m_asks[ord.price].end());
-
-        // else found, and erase it
-        m_asks[ord.price].erase(it);
-        if (m_asks[ord.price].size() == 0)
-        {
-            m_asks.erase(ord.price);
-        }
+    for (transaction &trans : transactions)
+    {
+        logger::log(fmt::format("    {}", trans.repr()));
+        record(trans);
     }
-}
 
+    // perform transaction
+    int total_volume = 0;
+    for (const transaction &trans : transactions)
+    {
+        total_volume += trans.volume;
+
+        // update users' orders, the aggressor is not resting so only its holdings change
+        order ord = m_accounts.view_order(aggressor.wish == side::BID ? trans.ask_id : trans.bid_id);
+        m_accounts.fill_order(ord, trans.price, trans.volume, opposite(aggressor.wish));
+        m_accounts.fill(aggressor.user_id, aggressor.ticker_id, trans.price, trans.volume, aggressor.wish);
+    }
 
+    return { total_volume, result.prevented };
+}
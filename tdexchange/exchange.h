@@ -12,25 +12,66 @@
 #include "ticker.h"
 #include "transaction.h"
 #include "order.h"
+#include "risk.h"
+#include "accounts.h"
+#include "trade_store.h"
+#include "candles.h"
+#include "journal.h"
+#include "partition.h"
+#include "universe.h"
 
 namespace market
 {
 
+// the outcome of an order once it has been processed
+enum class order_status
+{
+    RESTING = 0,
+    FILLED = 1,
+    CANCELLED = 2,
+    REJECTED = 3,
+    PENDING = 4
+};
+static const char *order_status_repr[] = { "resting", "filled", "cancelled", "rejected", "pending" };
+
+struct order_result
+{
+    // 0 when the order was rejected before being assigned an id
+    ids::order_id id;
+    order_status status;
+
+    // volume filled immediately
+    int filled;
+
+    // the pre-trade check that rejected the order, if any
+    risk_check risk = risk_check::PASSED;
+};
+
 /**
  * @brief A synced exchange containing a list of tickers and users
 */
 class exchange
 {
 protected:
+    // the books and journal, first so it outlives them
+    memory_arena m_arena;
+
     // tickerid to ticker objects
     map<ids::ticker_id, ticker> m_tickers;
 
-    // userid to user objects
-    map<ids::user_id, user> m_users;
+    // account data of every user
+    accounts m_accounts;
 
-    // a list of transactions, chronologically
+    // the transactions since they were last consumed, chronologically
     vector<transaction> m_transactions;
 
+    // every transaction, kept for history queries
+    trade_store m_history;
+    long long m_last_trade_time;
+
+    // candles of every ticker, updated with each transaction
+    candles m_candles;
+
     // mutex lock
     mutex m_update;
 
@@ -38,8 +79,42 @@ protected:
     id_system<ids::order_id> m_order_id;
     id_system<ids::transaction_id> m_transaction_id;
 
+    // the tickers owned, and how order ids are numbered
+    partition m_partition;
+
+    // pre-trade checks, applied to every order before it is matched
+    risk m_risk;
+
+    // the sequence of the last command, and the commands since they were last consumed while journaling
+    unsigned long long m_sequence;
+    bool m_journaling;
+    pmr::vector<command> m_journal;
+
+    // the clock of the command being applied, taken from the command while replaying one
+    long long m_now;
+    const command *m_replaying;
+
+    // calls in progress, only the outermost is a command of its own
+    int m_depth;
+
+    // numbers, stamps and journals a command for as long as its call is in progress
+    class command_scope
+    {
+    protected:
+        exchange &m_owner;
+
+    public:
+        command_scope(exchange &owner, command cmd);
+        ~command_scope();
+    };
+
 public:
-    exchange();
+    /**
+     * @brief Creates the exchange with the tickers of a partition and the users of a universe
+     * @param config The tickers and users, and how much is reserved for trading
+     * @param part Every ticker by default
+    */
+    explicit exchange(const universe &config = default_universe(), const partition &part = {});
 
 
     //// USER UPDATING FUNCTIONS ////
@@ -49,22 +124,143 @@ public:
      *
      * Defaults to a limit that fills at the price or better.
      * An IOC acts as a limit order where the unfilled portion is immediately cancelled.
+     * A market order is an IOC without a price limit.
+     * A FOK fills completely at the price or better, or is rejected without trading.
+     * A post only is a limit that is rejected if it would trade immediately.
+     * Only the unfilled portion of limit and post only orders is added to the order book and the user.
+     * A limit or post only with a display volume is an iceberg, showing at most that volume at once,
+     * and re-queued at the back of its level with the next slice each time the shown volume fills.
+     * Self-trade prevention decides what happens when the order would trade against the same user's resting orders.
+     * Every order first passes the pre-trade risk checks, or is rejected with the limit it broke.
+     *
+     * @param _side
+     * @param userid
+     * @param tickerid
+     * @param price Ignored for market orders
+     * @param volume
+     * @param type
+     * @param display Volume shown at once for iceberg orders, 0 to show everything
+     * @param stp Self-trade prevention
+     * @return The result of the order
+    */
+    auto user_order(side _side, ids::user_id userid, ids::ticker_id tickerid, int price, int volume, order_type type = order_type::LIMIT, int display = 0, self_trade stp = self_trade::NONE) -> order_result;
+
+    /**
+     * @brief Places a stop order, held until the last traded price reaches the trigger
+     *
+     * A buy stop triggers when the last price rises to or above the trigger, a sell stop when it falls to or below it.
+     * Once triggered, a stop becomes a market order and a stop limit becomes a limit order at the price.
+     * Triggered stops run right after the order that triggered them, in the order they were placed.
+     * Stops are risk checked as market orders when placed.
      *
      * @param _side
      * @param userid
      * @param tickerid
-     * @param price
+     * @param trigger The last price that triggers the stop
+     * @param price Limit price, ignored for stops
      * @param volume
-     * @param ioc
+     * @param type Either a stop or a stop limit
+     * @param stp Self-trade prevention once triggered
+     * @return The result of the order, pending if accepted
+    */
+    auto user_stop_order(side _side, ids::user_id userid, ids::ticker_id tickerid, int trigger, int price, int volume, order_type type, self_trade stp = self_trade::NONE) -> order_result;
+
+    /**
+     * @brief Executes stops that were triggered but left over by the cascade limit, journaling nothing when there are none
      * @return
     */
-    auto user_order(side _side, ids::user_id userid, ids::ticker_id tickerid, int price, int volume, bool ioc = false) -> void;
+    auto run_stops() -> void;
+
+    /**
+     * @brief Changes the trading phase of a ticker
+     *
+     * Orders entered during a batch or call phase rest without matching, and only limit orders are accepted.
+     * Moving from an auction phase back to continuous trading first uncrosses the book, as an opening auction.
+     *
+     * @param tickerid
+     * @param phase
+     * @return
+    */
+    auto set_phase(ids::ticker_id tickerid, market_phase phase) -> void;
+
+    /**
+     * @brief Crosses the order book of a ticker at its clearing price, as a closing or called auction
+     * @param tickerid
+     * @return The volume traded
+    */
+    auto run_auction(ids::ticker_id tickerid) -> int;
+
+    // runs the auction of every crossed ticker in the batch phase, once per tick, journaling nothing when there are none
+    auto run_batch_auctions() -> void;
 
-    // cancels all orders of the user
-    auto user_cancel(ids::user_id userid) -> void;
+    /**
+     * @brief Cancels all resting and stop orders of the user, in one pass over its orders
+     * @param userid
+     * @return The number of orders cancelled
+    */
+    auto user_cancel(ids::user_id userid) -> int;
 
     auto user_cancel_ticker(ids::user_id userid, ids::ticker_id tickerid) -> void;
 
+    /**
+     * @brief Cancels a single resting or stop order of the user
+     * @param userid
+     * @param orderid
+     * @return Whether the user had the order resting or pending
+    */
+    auto user_cancel_order(ids::user_id userid, ids::order_id orderid) -> bool;
+
+    /**
+     * @brief Atomically changes the price and/or volume of a resting order, keeping its order id
+     *
+     * Reducing the volume at the same price keeps the order's queue priority,
+     * any other change moves it to the back of the queue and may match it as an aggressor,
+     * and is risk checked as a new order replacing the old one.
+     *
+     * @param userid
+     * @param orderid
+     * @param price The new price
+     * @param volume The new volume left resting, must be positive
+     * @return Whether the user had the order resting
+    */
+    auto user_amend_order(ids::user_id userid, ids::order_id orderid, int price, int volume) -> bool;
+
+    /**
+     * @brief Returns the queue positions of all of the user's resting orders on a ticker
+     * @param userid
+     * @param tickerid
+     * @return The queue positions, by order id
+    */
+    auto user_queue_positions(ids::user_id userid, ids::ticker_id tickerid) const->vector<queue_position>;
+
+    auto get_risk_limits() const -> const risk_limits &;
+    auto set_risk_limits(const risk_limits &limits) -> void;
+
+    /**
+     * @brief Applies a command journaled by an exchange that started alike, through the call that journaled it
+     *
+     * Raises exceptions when commands are missing before it, or when replaying it diverges from the journal.
+     *
+     * @param cmd The command following the last one applied, or one already applied, which is dropped
+     * @return Whether the command was applied
+    */
+    auto apply(const command &cmd) -> bool;
+
+    // journals every command from now on, to be consumed
+    auto set_journaling(bool journaling) -> void;
+
+    // returns the commands since they were last consumed, in sequence
+    auto consume_journal() -> vector<command>;
+
+    // the sequence of the last command applied
+    auto get_sequence() const -> unsigned long long;
+
+    // the time no later trade is recorded before, assuming the wall clock does not step back
+    auto get_clock() const -> long long;
+    auto get_partition() const -> const partition &;
+    // what the books and journal have allocated, and on which pages
+    auto get_memory_stats() const -> memory_stats;
+
     // returns if the user is authenticated (a part of the exchange)
     auto user_auth(const std::string &name, const std::string &passphase) const->std::optional<int>;
 
@@ -75,8 +271,12 @@ public:
 
     /// GETTERS ///
     auto get_tickers() const-> const map<ids::ticker_id, ticker> &;
-    auto get_user(ids::user_id id) const -> const user &;
-    auto get_users() const -> const map<ids::user_id, user> &;
+    auto get_user(ids::user_id id) const -> user;
+    // every user, in index order
+    auto get_users() const->vector<user>;
+    // the users whose cash or positions changed since the last call, each once
+    auto consume_changed_users() -> vector<user>;
+    auto get_accounts() const -> const accounts &;
     auto get_ticker(ids::ticker_id id) const -> const ticker &;
     auto get_ticker(const std::string &name) const -> const ticker &;
     auto has_ticker(const std::string &name) const -> bool;
@@ -84,9 +284,44 @@ public:
 
     auto get_transactions() const->const vector<transaction> &;
     auto consume_transactions() -> vector<transaction>;
+
+    /**
+     * @brief Returns the trades of a ticker within a time range, from the trade history
+     * @param tickerid
+     * @param from The earliest time included, in nanoseconds since the epoch
+     * @param to The first time excluded
+     * @return The trades in time order
+    */
+    auto get_trades(ids::ticker_id tickerid, long long from, long long to) const->vector<transaction>;
+
+    // returns the trades a user was either side of within a time range, from the trade history
+    auto get_user_trades(ids::user_id userid, long long from, long long to) const->vector<transaction>;
+    auto get_history() const -> const trade_store &;
+    auto get_candles() const -> const candles &;
+
+    // returns the market-by-order events of every ticker since they were last consumed
+    auto consume_events() -> vector<book_event>;
 protected:
-    // attempt to match any order given the new aggressor order
-    auto process_order(const order &aggressor) -> void;
+    // match the aggressor order, resting the remainder if it is a limit
+    auto execute(const order &aggressor, order_type type) -> order_result;
+
+    // executes the stops triggered on a ticker, up to the cascade limit
+    auto run_stops(ids::ticker_id tickerid) -> void;
+
+    // crosses a ticker's book at its clearing price, returning the volume traded
+    auto auction(ids::ticker_id tickerid) -> int;
+
+    // applies the self-trade prevention of a match to the resting orders it cut
+    auto reduce_orders(const vector<pair<order, int>> &reduced) -> void;
+
+    // makes the call that journaled a command
+    auto dispatch(const command &cmd) -> void;
+
+    // stamps a transaction with the time and adds it to the transactions, the history and the candles
+    auto record(transaction &trans) -> void;
+
+    // attempt to match any order given the new aggressor order, returning the volume filled and the volume removed by self-trade prevention
+    auto process_order(const order &aggressor) -> pair<int, int>;
 };
 
 };
@@ -0,0 +1,282 @@
+#include "gateway.h"
+
+#include <fmt/core.h>
+
+#include "logger.h"
+
+using nlohmann::json;
+namespace ws_opcode = websocketpp::frame::opcode;
+
+network::gateway::gateway(unsigned short port, const std::vector<std::string> &partitions, const market::universe &config)
+    : m_port(port), m_ws(), m_client(), m_partitions(partitions), m_tickers(), m_nextid(0)
+{
+    for (const market::ticker_spec &ticker : config.tickers)
+    {
+        m_tickers[ticker.alias] = market::ticker_partition(ticker.id, m_partitions.size());
+    }
+}
+
+auto network::gateway::start() -> void
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+
+    try {
+        m_ws.init_asio();
+        m_ws.set_open_handler(std::bind(&network::gateway::on_open, this, _1));
+        m_ws.set_close_handler(std::bind(&network::gateway::on_close, this, _1));
+        m_ws.set_message_handler(std::bind(&network::gateway::on_message, this, _1, _2));
+        m_ws.set_access_channels(websocketpp::log::alevel::none);
+
+        // partitions are connected to from the same loop, so sessions need no lock
+        m_client.init_asio(&m_ws.get_io_service());
+        m_client.clear_access_channels(websocketpp::log::alevel::all);
+
+        logger::log(fmt::format("gateway to {} partitions started on port {}", m_partitions.size(), m_port));
+        m_ws.listen(m_port);
+        m_ws.start_accept();
+        m_ws.run();
+    }
+    catch (const ws::exception &ex)
+    {
+        logger::log(fmt::format("ws error {}", ex.what()), logger::mode::ERR);
+    }
+}
+
+auto network::gateway::on_open(ws::connection_hdl hdl) -> void
+{
+    int id = m_nextid++;
+    m_connections[hdl] = id;
+
+    gateway_session &session = m_sessions[id];
+    session.client = hdl;
+    session.upstream.resize(m_partitions.size());
+    session.open.resize(m_partitions.size(), false);
+    session.backlog.resize(m_partitions.size());
+
+    for (size_t partition = 0; partition < m_partitions.size(); ++partition)
+    {
+        connect_partition(id, partition);
+    }
+}
+
+auto network::gateway::on_close(ws::connection_hdl hdl) -> void
+{
+    if (!m_connections.contains(hdl))
+        return;
+
+    int id = m_connections.at(hdl);
+    m_connections.erase(hdl);
+
+    // the partitions see the client leave, and cancel on disconnect as they would for a direct connection
+    websocketpp::lib::error_code ec;
+    for (ws::connection_hdl upstream : m_sessions.at(id).upstream)
+    {
+        m_client.close(upstream, ws::close::status::normal, "client left", ec);
+    }
+    m_sessions.erase(id);
+}
+
+auto network::gateway::on_message(ws::connection_hdl hdl, websocket::message_ptr ptr) -> void
+{
+    if (!m_connections.contains(hdl))
+        return;
+
+    gateway_session &session = m_sessions.at(m_connections.at(hdl));
+    const std::string &payload = ptr->get_payload();
+
+    // a payload that cannot be routed is left to the first partition to reject
+    json parsed = json::parse(payload, nullptr, false);
+    if (parsed.is_discarded() || !parsed.is_object())
+    {
+        send_partition(session, 0, payload);
+        return;
+    }
+
+    // a request without a type is only answered by a log line, so one partition is enough
+    std::optional<size_t> partition = route(parsed);
+    if (!partition && !(parsed.contains("type") && parsed["type"].is_string()))
+        partition = 0;
+    if (partition)
+    {
+        send_partition(session, *partition, payload);
+        return;
+    }
+
+    // every partition answers it once, echoing the gateway's ref instead of the client's
+    long long ref = ++session.nextref;
+    session.broadcasts[ref] = { parsed.value("ref", json()) };
+    parsed["ref"] = json{ { "gateway", ref } };
+
+    std::string tagged = parsed.dump();
+    for (size_t p = 0; p < m_partitions.size(); ++p)
+    {
+        send_partition(session, p, tagged);
+    }
+}
+
+auto network::gateway::connect_partition(int id, size_t partition) -> void
+{
+    websocketpp::lib::error_code ec;
+    websocket_client::connection_ptr con = m_client.get_connection(m_partitions[partition], ec);
+    if (ec)
+    {
+        logger::log(fmt::format("id {}, cannot connect to partition {}: {}", id, partition, ec.message()), logger::mode::ERR);
+        on_partition_close(id, partition);
+        return;
+    }
+
+    con->set_open_handler([this, id, partition](ws::connection_hdl) { on_partition_open(id, partition); });
+    con->set_close_handler([this, id, partition](ws::connection_hdl) { on_partition_close(id, partition); });
+    con->set_fail_handler([this, id, partition](ws::connection_hdl) { on_partition_close(id, partition); });
+    con->set_message_handler([this, id, partition](ws::connection_hdl, websocket_client::message_ptr ptr)
+        {
+            on_partition_message(id, partition, ptr);
+        });
+
+    m_sessions.at(id).upstream[partition] = con->get_handle();
+    m_client.connect(con);
+}
+
+auto network::gateway::on_partition_open(int id, size_t partition) -> void
+{
+    if (!m_sessions.contains(id))
+        return;
+
+    gateway_session &session = m_sessions.at(id);
+    session.open[partition] = true;
+    for (const std::string &payload : session.backlog[partition])
+    {
+        send_partition(session, partition, payload);
+    }
+    session.backlog[partition].clear();
+}
+
+auto network::gateway::on_partition_close(int id, size_t partition) -> void
+{
+    if (!m_sessions.contains(id))
+        return;
+
+    // a client missing a partition would see part of the market, so it is closed to reconnect
+    logger::log(fmt::format("id {}, lost partition {}", id, partition), logger::mode::WARN);
+
+    websocketpp::lib::error_code ec;
+    m_ws.close(m_sessions.at(id).client, ws::close::status::try_again_later, "partition unavailable", ec);
+}
+
+auto network::gateway::on_partition_message(int id, size_t partition, websocket_client::message_ptr ptr) -> void
+{
+    if (!m_sessions.contains(id))
+        return;
+
+    gateway_session &session = m_sessions.at(id);
+    const std::string &payload = ptr->get_payload();
+
+    json parsed = json::parse(payload, nullptr, false);
+    if (parsed.is_discarded() || !parsed.is_object())
+    {
+        send_client(session, payload);
+        return;
+    }
+
+    if (parsed.contains("ref") && parsed["ref"].is_object() && parsed["ref"].contains("gateway"))
+    {
+        on_broadcast_reply(session, parsed);
+        return;
+    }
+
+    std::string type = parsed.value("type", "");
+
+    if (type != "tick" && type != "position")
+    {
+        send_client(session, payload);
+        return;
+    }
+
+    // the books and holdings of the other partitions are those of their last message, the trades only this one's
+    std::vector<json> &latest = session.latest[type];
+    latest.resize(m_partitions.size());
+    latest[partition] = parsed;
+
+    for (size_t p = 0; p < m_partitions.size(); ++p)
+    {
+        if (p == partition || !latest[p].is_object())
+            continue;
+
+        for (const char *key : { "orderbook", "position" })
+        {
+            if (parsed.contains(key) && latest[p].contains(key))
+                parsed[key].update(latest[p][key]);
+        }
+    }
+    parsed["id"] = ++session.tickid;
+    send_client(session, parsed.dump());
+}
+
+auto network::gateway::on_broadcast_reply(gateway_session &session, json &reply) -> void
+{
+    json &tag = reply["ref"]["gateway"];
+    auto it = tag.is_number_integer() ? session.broadcasts.find(tag.get<long long>()) : session.broadcasts.end();
+    if (it == session.broadcasts.end())
+        return;
+
+    gateway_broadcast &broadcast = it->second;
+    broadcast.replies += 1;
+
+    // the first answer is passed on unless a later one failed, a mass cancel counts the orders of every partition
+    int cancelled = broadcast.reply.value("cancelled", 0) + reply.value("cancelled", 0);
+    if (broadcast.reply.empty() || (!reply.value("ok", true) && broadcast.reply.value("ok", true)))
+        broadcast.reply = reply;
+    if (broadcast.reply.contains("cancelled"))
+        broadcast.reply["cancelled"] = cancelled;
+
+    if (broadcast.replies < m_partitions.size())
+        return;
+
+    // the client sees its own ref, or none
+    json merged = std::move(broadcast.reply);
+    if (broadcast.ref.is_null())
+        merged.erase("ref");
+    else
+        merged["ref"] = broadcast.ref;
+    if (merged.contains("cancelled") && merged.value("action", "") == "mass_cancel")
+        merged["message"] = fmt::format("cancelled {} orders", merged["cancelled"].get<int>());
+
+    session.broadcasts.erase(it);
+    send_client(session, merged.dump());
+}
+
+auto network::gateway::route(const json &payload) const -> std::optional<size_t>
+{
+    if (payload.contains("ticker") && payload["ticker"].is_string())
+    {
+        // an unknown ticker is rejected by whichever partition
+        auto it = m_tickers.find(payload["ticker"].get<std::string>());
+        return it != m_tickers.end() ? it->second : 0;
+    }
+
+    if (payload.contains("order") && payload["order"].is_number_unsigned())
+    {
+        return market::order_partition(payload["order"].get<ids::order_id>(), m_partitions.size());
+    }
+
+    return std::nullopt;
+}
+
+auto network::gateway::send_partition(gateway_session &session, size_t partition, const std::string &payload) -> void
+{
+    if (!session.open[partition])
+    {
+        session.backlog[partition].push_back(payload);
+        return;
+    }
+
+    websocketpp::lib::error_code ec;
+    m_client.send(session.upstream[partition], payload, ws_opcode::text, ec);
+}
+
+auto network::gateway::send_client(const gateway_session &session, const std::string &payload) -> void
+{
+    websocketpp::lib::error_code ec;
+    m_ws.send(session.client, payload, ws_opcode::text, ec);
+}
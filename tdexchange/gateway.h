@@ -0,0 +1,115 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/server.hpp>
+#include <websocketpp/client.hpp>
+#include <nlohmann/json.hpp>
+
+#include "partition.h"
+#include "universe.h"
+
+
+using websocket = websocketpp::server<websocketpp::config::asio>;
+using websocket_client = websocketpp::client<websocketpp::config::asio_client>;
+namespace ws = websocketpp;
+
+namespace network
+{
+
+// a request sent to every partition, answered once all of them have
+struct gateway_broadcast
+{
+    // the client's own ref, replaced by the gateway's
+    nlohmann::json ref;
+
+    // the answer passed on, the first failure or else the first answer, and how many partitions answered
+    nlohmann::json reply = nlohmann::json::object();
+    size_t replies = 0;
+};
+
+// a client of the gateway, and its connection to each partition
+struct gateway_session
+{
+    ws::connection_hdl client;
+    std::vector<ws::connection_hdl> upstream;
+
+    // what the client sent a partition before its connection opened
+    std::vector<bool> open;
+    std::vector<std::vector<std::string>> backlog;
+
+    // requests sent to every partition, by the ref the gateway tagged them with, until every partition answered
+    std::map<long long, gateway_broadcast> broadcasts;
+    long long nextref = 0;
+
+    // the last tick and position message of each partition, merged into those passed on
+    std::map<std::string, std::vector<nlohmann::json>> latest;
+    int tickid = 0;
+};
+
+/**
+ * @brief A websocket front end to exchange processes partitioned by ticker
+ *
+ * Every client is given a connection to every partition. Requests naming a ticker go to the partition owning
+ * it, those naming an order to the partition that numbered it, and the rest, like authentication, to all of
+ * them. Those are tagged with a ref of the gateway, which the partitions echo, and answered once by merging the
+ * answers of every partition. Ticks and positions carry the books and holdings of every partition, everything
+ * else is passed on as it is.
+*/
+class gateway
+{
+protected:
+    unsigned short m_port;
+    websocket m_ws;
+    websocket_client m_client;
+
+    // the websocket uri of each partition, and the partition owning each ticker alias
+    std::vector<std::string> m_partitions;
+    std::map<std::string, size_t> m_tickers;
+
+    int m_nextid;
+    std::map<ws::connection_hdl, int, std::owner_less<ws::connection_hdl>> m_connections;
+    std::map<int, gateway_session> m_sessions;
+
+public:
+    /**
+     * @brief Default constructor
+     * @param port Port to open the websocket at
+     * @param partitions The websocket uri of each partition, in partition order
+     * @param config The universe every partition was started with
+    */
+    gateway(unsigned short port, const std::vector<std::string> &partitions, const market::universe &config);
+
+    /**
+     * @brief Start the websocket at the specified port, clients and partitions are served on the same thread
+     * @return
+    */
+    auto start() -> void;
+
+protected:
+    auto on_open(ws::connection_hdl hdl) -> void;
+    auto on_close(ws::connection_hdl hdl) -> void;
+    auto on_message(ws::connection_hdl hdl, websocket::message_ptr ptr) -> void;
+
+    auto connect_partition(int id, size_t partition) -> void;
+    auto on_partition_open(int id, size_t partition) -> void;
+    auto on_partition_close(int id, size_t partition) -> void;
+    auto on_partition_message(int id, size_t partition, websocket_client::message_ptr ptr) -> void;
+
+    // returns the partition a request is for, or nothing when it is for all of them
+    auto route(const nlohmann::json &payload) const -> std::optional<size_t>;
+
+    // merges a partition's answer to a request sent to all of them, passing it on once every partition answered
+    auto on_broadcast_reply(gateway_session &session, nlohmann::json &reply) -> void;
+
+    auto send_partition(gateway_session &session, size_t partition, const std::string &payload) -> void;
+    auto send_client(const gateway_session &session, const std::string &payload) -> void;
+};
+
+};
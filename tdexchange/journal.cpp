@@ -0,0 +1,58 @@
+#include "journal.h"
+
+#include <fmt/core.h>
+#include <cassert>
+#include <algorithm>
+#include <stdexcept>
+
+market::journal_file::journal_file(const string &path)
+    : m_path(path), m_file(nullptr), m_last(0)
+{
+    m_file = std::fopen(path.c_str(), "w+b");
+    if (m_file == nullptr)
+        throw std::runtime_error(fmt::format("cannot create journal {}", path));
+}
+
+market::journal_file::~journal_file()
+{
+    std::fclose(m_file);
+}
+
+auto market::journal_file::append(const vector<command> &commands) -> void
+{
+    if (commands.empty())
+        return;
+
+    assert(commands.front().sequence == m_last + 1);
+
+    // commands are numbered without gaps, so a command is found at its sequence times the record size
+    std::fseek(m_file, 0, SEEK_END);
+    if (std::fwrite(commands.data(), sizeof(command), commands.size(), m_file) != commands.size())
+        throw std::runtime_error(fmt::format("cannot append to journal {}", m_path));
+    std::fflush(m_file);
+
+    m_last = commands.back().sequence;
+}
+
+auto market::journal_file::read(unsigned long long after, size_t limit) -> vector<command>
+{
+    if (after >= m_last)
+        return {};
+
+    vector<command> commands(std::min<unsigned long long>(limit, m_last - after));
+    std::fseek(m_file, static_cast<long>(after * sizeof(command)), SEEK_SET);
+    size_t read = std::fread(commands.data(), sizeof(command), commands.size(), m_file);
+    commands.resize(read);
+
+    return commands;
+}
+
+auto market::journal_file::get_last() const -> unsigned long long
+{
+    return m_last;
+}
+
+auto market::journal_file::get_path() const -> const string &
+{
+    return m_path;
+}
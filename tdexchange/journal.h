@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#include "id.h"
+#include "side.h"
+#include "order.h"
+#include "ticker.h"
+
+namespace market
+{
+
+using namespace std;
+
+// every call that changes an exchange
+enum class command_type
+{
+    ORDER = 0,
+    STOP_ORDER = 1,
+    CANCEL = 2,
+    AMEND = 3,
+    MASS_CANCEL = 4,
+    CANCEL_TICKER = 5,
+    PHASE = 6,
+    AUCTION = 7,
+    BATCH_AUCTIONS = 8,
+    STOPS = 9
+};
+static const char *command_type_repr[] = {
+    "order", "stop_order", "cancel", "amend", "mass_cancel", "cancel_ticker", "phase", "auction", "batch_auctions", "stops"
+};
+
+/**
+ * @brief A call that changed an exchange, with everything needed to make it again
+ *
+ * Applying the same commands in sequence to exchanges that start alike leaves them alike. The fields a type
+ * does not use are left at their defaults. Commands are written as they are, so they are only read back by
+ * the same build.
+*/
+struct command
+{
+    // numbered from 1 without gaps
+    unsigned long long sequence = 0;
+    // the clock of the exchange while the command was applied, in nanoseconds since the epoch
+    long long time = 0;
+
+    command_type type = command_type::ORDER;
+    side wish = side::BID;
+    ids::user_id user = 0;
+    ids::ticker_id ticker = 0;
+    ids::order_id order = 0;
+
+    int price = 0;
+    int volume = 0;
+    int trigger = 0;
+    int display = 0;
+    order_type kind = order_type::LIMIT;
+    self_trade stp = self_trade::NONE;
+    market_phase phase = market_phase::CONTINUOUS;
+};
+
+/**
+ * @brief An append-only file of commands, so a process joining late can be given every command from the first
+*/
+class journal_file
+{
+protected:
+    string m_path;
+    FILE *m_file;
+    unsigned long long m_last;
+
+public:
+    /**
+     * @brief Creates the journal, replacing any left by an earlier run, raising exceptions when it cannot
+     * @param path
+    */
+    explicit journal_file(const string &path);
+    ~journal_file();
+
+    journal_file(const journal_file &) = delete;
+    auto operator=(const journal_file &) -> journal_file & = delete;
+
+    // appends commands following the last one appended
+    auto append(const vector<command> &commands) -> void;
+
+    /**
+     * @brief Reads back the commands after a sequence
+     * @param after The sequence of the last command not returned
+     * @param limit The most commands returned
+     * @return The commands, in sequence
+    */
+    auto read(unsigned long long after, size_t limit) -> vector<command>;
+
+    // the sequence of the last command appended, 0 when empty
+    auto get_last() const -> unsigned long long;
+    auto get_path() const -> const string &;
+};
+
+};
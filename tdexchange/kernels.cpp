@@ -0,0 +1,216 @@
+#include "kernels.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// msvc compiles any intrinsic, gcc and clang only for the target of the function using it
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+using namespace market::kernels;
+
+// the kernels of one instruction set
+struct kernel_table
+{
+    instruction_set set;
+    long long (*sum_until)(const long long *, size_t, long long);
+    void (*prefix_sum)(const long long *, long long *, size_t);
+};
+
+/// SCALAR ///
+
+static auto sum_until_scalar(const long long *values, size_t n, long long limit) -> long long
+{
+    long long total = 0;
+    for (size_t i = 0; i < n && total < limit; ++i)
+    {
+        total += values[i];
+    }
+    return total;
+}
+
+static auto prefix_sum_scalar(const long long *values, long long *out, size_t n) -> void
+{
+    long long total = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        total += values[i];
+        out[i] = total;
+    }
+}
+
+#ifdef KERNELS_X86
+
+/// SSE2, two values per register ///
+
+static auto sum_until_sse2(const long long *values, size_t n, long long limit) -> long long
+{
+    long long total = 0;
+    size_t i = 0;
+
+    // 8 values per block between checks of the limit
+    for (; i + 8 <= n && total < limit; i += 8)
+    {
+        const __m128i *block = reinterpret_cast<const __m128i *>(values + i);
+        __m128i sum = _mm_add_epi64(
+            _mm_add_epi64(_mm_load_si128(block), _mm_load_si128(block + 1)),
+            _mm_add_epi64(_mm_load_si128(block + 2), _mm_load_si128(block + 3)));
+        total += _mm_cvtsi128_si64(sum) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum));
+    }
+
+    return total + sum_until_scalar(values + i, n - i, limit - total);
+}
+
+static auto prefix_sum_sse2(const long long *values, long long *out, size_t n) -> void
+{
+    __m128i carry = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i x = _mm_load_si128(reinterpret_cast<const __m128i *>(values + i));
+        // add the lower value into the upper, then everything before the pair
+        x = _mm_add_epi64(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi64(x, carry);
+        _mm_store_si128(reinterpret_cast<__m128i *>(out + i), x);
+        carry = _mm_unpackhi_epi64(x, x);
+    }
+
+    long long total = _mm_cvtsi128_si64(carry);
+    for (; i < n; ++i)
+    {
+        total += values[i];
+        out[i] = total;
+    }
+}
+
+/// AVX2, four values per register ///
+
+TARGET_AVX2 static auto sum_until_avx2(const long long *values, size_t n, long long limit) -> long long
+{
+    long long total = 0;
+    size_t i = 0;
+
+    // 16 values per block between checks of the limit
+    for (; i + 16 <= n && total < limit; i += 16)
+    {
+        const __m256i *block = reinterpret_cast<const __m256i *>(values + i);
+        __m256i sum = _mm256_add_epi64(
+            _mm256_add_epi64(_mm256_load_si256(block), _mm256_load_si256(block + 1)),
+            _mm256_add_epi64(_mm256_load_si256(block + 2), _mm256_load_si256(block + 3)));
+        __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        total += _mm_cvtsi128_si64(half) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half));
+    }
+
+    return total + sum_until_scalar(values + i, n - i, limit - total);
+}
+
+TARGET_AVX2 static auto prefix_sum_avx2(const long long *values, long long *out, size_t n) -> void
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i carry = zero;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i x = _mm256_load_si256(reinterpret_cast<const __m256i *>(values + i));
+        // shift by one value across the lanes and add, then by two
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03));
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x0F));
+        x = _mm256_add_epi64(x, carry);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(out + i), x);
+        carry = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    long long total = _mm_cvtsi128_si64(_mm256_castsi256_si128(carry));
+    for (; i < n; ++i)
+    {
+        total += values[i];
+        out[i] = total;
+    }
+}
+
+#endif
+
+/// DISPATCH ///
+
+static auto make_table(instruction_set set) -> kernel_table
+{
+#ifdef KERNELS_X86
+    switch (set)
+    {
+    case instruction_set::AVX2:
+        return { set, sum_until_avx2, prefix_sum_avx2 };
+    case instruction_set::SSE2:
+        return { set, sum_until_sse2, prefix_sum_sse2 };
+    default:
+        break;
+    }
+#endif
+    return { instruction_set::SCALAR, sum_until_scalar, prefix_sum_scalar };
+}
+
+// the kernels in use, resolved once on first use
+static auto table() -> kernel_table &
+{
+    static kernel_table kernels = make_table(detect());
+    return kernels;
+}
+
+auto market::kernels::detect() -> instruction_set
+{
+#if defined(KERNELS_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7)
+    {
+        __cpuid(info, 1);
+        // avx registers must also be saved by the os
+        bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info, 7, 0);
+        if (avx && (info[1] & (1 << 5)))
+        {
+            return instruction_set::AVX2;
+        }
+    }
+    return instruction_set::SSE2;
+#elif defined(KERNELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return instruction_set::AVX2;
+    }
+    return instruction_set::SSE2;
+#else
+    return instruction_set::SCALAR;
+#endif
+}
+
+auto market::kernels::active() -> instruction_set
+{
+    return table().set;
+}
+
+auto market::kernels::select(instruction_set set) -> instruction_set
+{
+    table() = make_table(std::min(set, detect()));
+    return table().set;
+}
+
+auto market::kernels::sum_until(const long long *values, size_t n, long long limit) -> long long
+{
+    return table().sum_until(values, n, limit);
+}
+
+auto market::kernels::prefix_sum(const long long *values, long long *out, size_t n) -> void
+{
+    table().prefix_sum(values, out, n);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace market
+{
+
+namespace kernels
+{
+
+using namespace std;
+
+// alignment of the arrays the kernels run over, one 256 bit register
+constexpr size_t ALIGNMENT = 32;
+
+// the instructions the kernels are compiled for, the widest the cpu supports is picked at runtime
+enum class instruction_set
+{
+    SCALAR = 0,
+    SSE2 = 1,
+    AVX2 = 2
+};
+static const char *instruction_set_repr[] = { "scalar", "sse2", "avx2" };
+
+/**
+ * @brief Allocates arrays aligned for the kernels' vector loads
+*/
+template<typename T, size_t Alignment = ALIGNMENT>
+struct aligned_allocator
+{
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = aligned_allocator<U, Alignment>;
+    };
+
+    aligned_allocator() noexcept = default;
+
+    template<typename U>
+    aligned_allocator(const aligned_allocator<U, Alignment> &) noexcept
+    {
+    }
+
+    auto allocate(size_t n) -> T *
+    {
+        return static_cast<T *>(::operator new(n * sizeof(T), align_val_t(Alignment)));
+    }
+
+    auto deallocate(T *p, size_t) noexcept -> void
+    {
+        ::operator delete(p, align_val_t(Alignment));
+    }
+
+    template<typename U>
+    auto operator==(const aligned_allocator<U, Alignment> &) const noexcept -> bool
+    {
+        return true;
+    }
+};
+
+template<typename T>
+using aligned_vector = vector<T, aligned_allocator<T>>;
+
+// returns the widest instruction set the cpu and os support
+auto detect() -> instruction_set;
+
+// returns the instruction set the kernels currently run with
+auto active() -> instruction_set;
+
+/**
+ * @brief Switches the kernels to an instruction set, capped to what the cpu supports
+ * @param set The instruction set
+ * @return The instruction set now active
+*/
+auto select(instruction_set set) -> instruction_set;
+
+/**
+ * @brief Sums values in order until the running total reaches a limit
+ *
+ * The vector kernels check the limit once per block, so the result may pass it, it is only exact below it
+ *
+ * @param values Aligned to ALIGNMENT
+ * @param n The number of values
+ * @param limit The total to stop at
+ * @return The sum of every value if it is below the limit, otherwise a partial sum of at least the limit
+*/
+auto sum_until(const long long *values, size_t n, long long limit) -> long long;
+
+/**
+ * @brief Writes the inclusive prefix sums of values, out[i] being the sum of values[0..i]
+ * @param values Aligned to ALIGNMENT
+ * @param out Aligned to ALIGNMENT, with room for n values, may be values
+ * @param n The number of values
+ * @return
+*/
+auto prefix_sum(const long long *values, long long *out, size_t n) -> void;
+
+};
+
+};
@@ -0,0 +1,206 @@
+#include "level.h"
+
+#include <cassert>
+
+// number of removed slots tolerated before a queue is rebuilt
+static const size_t COMPACT_THRESHOLD = 32;
+
+market::level::level()
+    : level(allocator_type())
+{
+}
+
+market::level::level(const allocator_type &alloc)
+    : m_orders(alloc), m_head(0), m_slots(alloc), m_volume(0), m_count(0), m_hidden(0), m_volume_tree(1, 0, alloc),
+    m_count_tree(1, 0, alloc)
+{
+}
+
+market::level::level(const level &other, const allocator_type &alloc)
+    : m_orders(other.m_orders, alloc), m_head(other.m_head), m_slots(other.m_slots, alloc), m_volume(other.m_volume),
+    m_count(other.m_count), m_hidden(other.m_hidden), m_volume_tree(other.m_volume_tree, alloc),
+    m_count_tree(other.m_count_tree, alloc)
+{
+}
+
+market::level::level(level &&other, const allocator_type &alloc)
+    : m_orders(std::move(other.m_orders), alloc), m_head(other.m_head), m_slots(std::move(other.m_slots), alloc),
+    m_volume(other.m_volume), m_count(other.m_count), m_hidden(other.m_hidden),
+    m_volume_tree(std::move(other.m_volume_tree), alloc), m_count_tree(std::move(other.m_count_tree), alloc)
+{
+}
+
+auto market::level::push(const order &ord) -> void
+{
+    assert(ord.volume > 0);
+    assert(!m_slots.contains(ord.id));
+
+    size_t slot = m_orders.size();
+    m_orders.push_back(ord);
+    m_slots[ord.id] = slot;
+
+    // append the new slot to both trees, the node covers the range (i - lowbit(i), i]
+    size_t i = slot + 1;
+    size_t low = i - (i & (~i + 1));
+    m_volume_tree.push_back(ord.volume + tree_sum(m_volume_tree, slot) - tree_sum(m_volume_tree, low));
+    m_count_tree.push_back(1 + tree_sum(m_count_tree, slot) - tree_sum(m_count_tree, low));
+
+    m_volume += ord.volume;
+    m_count += 1;
+    m_hidden += ord.hidden;
+}
+
+auto market::level::reduce(ids::order_id id, int volume) -> int
+{
+    assert(m_slots.contains(id));
+
+    size_t slot = m_slots.at(id);
+    order &ord = m_orders[slot];
+    assert(volume > 0 && volume <= ord.volume);
+
+    ord.volume -= volume;
+    m_volume -= volume;
+    tree_add(m_volume_tree, slot, -volume);
+
+    int left = ord.volume;
+    if (left == 0)
+    {
+        // the reserve goes with the order, replenishing is up to the caller
+        m_hidden -= ord.hidden;
+        m_slots.erase(id);
+        m_count -= 1;
+        tree_add(m_count_tree, slot, -1);
+        compact();
+    }
+
+    return left;
+}
+
+auto market::level::reduce_hidden(ids::order_id id, int volume) -> void
+{
+    assert(m_slots.contains(id));
+
+    order &ord = m_orders[m_slots.at(id)];
+    assert(volume >= 0 && volume <= ord.hidden);
+
+    ord.hidden -= volume;
+    m_hidden -= volume;
+}
+
+auto market::level::remove(ids::order_id id) -> order
+{
+    assert(m_slots.contains(id));
+
+    order ord = m_orders[m_slots.at(id)];
+    reduce(id, ord.volume);
+
+    return ord;
+}
+
+auto market::level::front() const -> const order &
+{
+    assert(m_count > 0);
+
+    // the head is always moved past removed slots
+    return m_orders[m_head];
+}
+
+auto market::level::contains(ids::order_id id) const -> bool
+{
+    return m_slots.contains(id);
+}
+
+auto market::level::at(ids::order_id id) const -> const order &
+{
+    assert(m_slots.contains(id));
+
+    return m_orders[m_slots.at(id)];
+}
+
+auto market::level::ahead(ids::order_id id) const -> pair<int, int>
+{
+    assert(m_slots.contains(id));
+
+    size_t slot = m_slots.at(id);
+    return { tree_sum(m_count_tree, slot), tree_sum(m_volume_tree, slot) };
+}
+
+auto market::level::get_volume() const -> int
+{
+    return m_volume;
+}
+
+auto market::level::get_hidden() const -> int
+{
+    return m_hidden;
+}
+
+auto market::level::get_count() const -> int
+{
+    return m_count;
+}
+
+auto market::level::empty() const -> bool
+{
+    return m_count == 0;
+}
+
+auto market::level::tree_add(pmr::vector<int> &tree, size_t slot, int delta) -> void
+{
+    for (size_t i = slot + 1; i < tree.size(); i += i & (~i + 1))
+    {
+        tree[i] += delta;
+    }
+}
+
+auto market::level::tree_sum(const pmr::vector<int> &tree, size_t slot) -> int
+{
+    int total = 0;
+    for (size_t i = slot; i > 0; i -= i & (~i + 1))
+    {
+        total += tree[i];
+    }
+    return total;
+}
+
+auto market::level::compact() -> void
+{
+    // removed orders at the front are simply skipped
+    while (m_head < m_orders.size() && m_orders[m_head].volume == 0)
+    {
+        m_head += 1;
+    }
+
+    size_t removed = m_orders.size() - m_count;
+    if (removed < COMPACT_THRESHOLD || removed < static_cast<size_t>(m_count))
+        return;
+
+    // otherwise rebuild the queue from the live orders only
+    pmr::vector<order> live(m_orders.get_allocator());
+    live.reserve(m_count);
+    for (const order &ord : orders())
+    {
+        live.push_back(ord);
+    }
+
+    m_orders = std::move(live);
+    m_head = 0;
+
+    m_volume_tree.assign(m_orders.size() + 1, 0);
+    m_count_tree.assign(m_orders.size() + 1, 0);
+    for (size_t slot = 0; slot < m_orders.size(); ++slot)
+    {
+        m_slots[m_orders[slot].id] = slot;
+
+        size_t i = slot + 1;
+        m_volume_tree[i] += m_orders[slot].volume;
+        m_count_tree[i] += 1;
+
+        size_t parent = i + (i & (~i + 1));
+        if (parent < m_volume_tree.size())
+        {
+            m_volume_tree[parent] += m_volume_tree[i];
+            m_count_tree[parent] += m_count_tree[i];
+        }
+    }
+}
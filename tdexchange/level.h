@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vector>
+#include <ranges>
+#include <unordered_map>
+#include <memory_resource>
+
+#include "id.h"
+#include "order.h"
+
+namespace market
+{
+
+using namespace std;
+
+/**
+ * @brief The queue of orders resting at a single price, in time priority
+ *
+ * Orders are kept in insertion order. Removing an order leaves an empty slot that is skipped
+ * until enough of them accumulate to compact the queue, so every operation on a single order
+ * is O(1) amortised, except queue position queries which are O(log n). Allocator-aware, so a level in a
+ * book allocates from the book's memory resource.
+*/
+class level
+{
+protected:
+    // orders in priority order, removed orders have a volume of zero
+    pmr::vector<order> m_orders;
+    // index of the first slot that may hold a live order
+    size_t m_head;
+
+    // order id to slot
+    pmr::unordered_map<ids::order_id, size_t> m_slots;
+
+    // live volume and order count
+    int m_volume;
+    int m_count;
+
+    // reserve volume of the iceberg orders, not shown in the volume
+    int m_hidden;
+
+    // fenwick trees over slot volumes and live slots, for the volume and orders ahead of a slot
+    pmr::vector<int> m_volume_tree;
+    pmr::vector<int> m_count_tree;
+
+public:
+    using allocator_type = pmr::polymorphic_allocator<>;
+
+    level();
+    explicit level(const allocator_type &alloc);
+    level(const level &other, const allocator_type &alloc);
+    level(level &&other, const allocator_type &alloc);
+
+    level(const level &) = default;
+    level(level &&) = default;
+    auto operator=(const level &) -> level & = default;
+    auto operator=(level &&) -> level & = default;
+
+    /**
+     * @brief Adds an order to the back of the queue
+     * @param ord The order, must have a positive volume
+     * @return
+    */
+    auto push(const order &ord) -> void;
+
+    /**
+     * @brief Reduces the volume of an order without changing its priority, removing it once empty
+     * @param id The order id
+     * @param volume The volume to remove
+     * @return The volume left on the order
+    */
+    auto reduce(ids::order_id id, int volume) -> int;
+
+    /**
+     * @brief Reduces the reserve volume of an iceberg order
+     * @param id The order id
+     * @param volume The hidden volume to remove
+     * @return
+    */
+    auto reduce_hidden(ids::order_id id, int volume) -> void;
+
+    /**
+     * @brief Removes an order from the queue
+     * @param id The order id
+     * @return The removed order
+    */
+    auto remove(ids::order_id id) -> order;
+
+    // returns the order first in priority, the level must not be empty
+    auto front() const -> const order &;
+
+    auto contains(ids::order_id id) const -> bool;
+    auto at(ids::order_id id) const -> const order &;
+
+    /**
+     * @brief Returns the number of orders and volume queued in front of an order
+     * @param id The order id
+     * @return A pair of order count and volume
+    */
+    auto ahead(ids::order_id id) const -> pair<int, int>;
+
+    // live volume and order count at this level, the volume is only what is shown
+    auto get_volume() const -> int;
+    auto get_hidden() const -> int;
+    auto get_count() const -> int;
+    auto empty() const -> bool;
+
+    /**
+     * @brief Returns the live orders in priority order
+     * @return A view over the orders
+    */
+    auto orders() const
+    {
+        return ranges::subrange(m_orders.begin() + m_head, m_orders.end())
+            | views::filter([](const order &ord) { return ord.volume > 0; });
+    }
+
+protected:
+    // adds a delta to a slot in the fenwick tree
+    static auto tree_add(pmr::vector<int> &tree, size_t slot, int delta) -> void;
+    // sums the slots before a slot
+    static auto tree_sum(const pmr::vector<int> &tree, size_t slot) -> int;
+
+    // moves the head past removed slots, and rebuilds the queue once most of it is removed
+    auto compact() -> void;
+};
+
+};
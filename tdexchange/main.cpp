@@ -6,14 +6,141 @@
 #include <string>
 #include <functional>
 #include <thread>
+#include <vector>
+#include <optional>
 
 #include "logger.h"
 #include "exchange.h"
 #include "server.h"
+#include "gateway.h"
+#include "settlement.h"
+#include "kernels.h"
+#include "config.h"
 
 
-auto main() -> int
+auto main(int argc, char *argv[]) -> int
 {
+    // --primary <address> streams every command to backups connecting there, --backup <address> follows the
+    // primary there until it is lost, both together make a backup that becomes the next primary
+    std::string primary, backup, journal = "tdexchange-journal.bin";
+
+    // --partition <index>/<count> owns some of the tickers, settled by a process run with --accounts <count>,
+    // and served together by a process run with --gateway <uri>,<uri>,... listing the partitions in order
+    market::partition part;
+    size_t accounts = 0;
+    std::vector<std::string> gateway;
+    std::optional<unsigned short> port;
+
+    // --config <path> reads the port, tick, limits, tickers and users from a file, --generate <tickers>x<users>
+    // prints the config of a synthetic universe of that size instead of starting
+    network::server_config config;
+    std::string generate;
+
+    // --profile low_latency spins instead of sleeping and locks memory, --cores <exchange>,<publisher>[,<io>]
+    // pins those threads, both override the config
+    std::optional<network::latency_profile> profile;
+    std::vector<int> cores;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--primary")
+            primary = value;
+        else if (flag == "--backup")
+            backup = value;
+        else if (flag == "--journal")
+            journal = value;
+        else if (flag == "--port")
+            port = static_cast<unsigned short>(std::stoi(value));
+        else if (flag == "--partition" && value.find('/') != std::string::npos)
+            part = { std::stoul(value.substr(0, value.find('/'))), std::stoul(value.substr(value.find('/') + 1)) };
+        else if (flag == "--accounts")
+            accounts = std::stoul(value);
+        else if (flag == "--config")
+        {
+            try
+            {
+                config = network::load_config(value);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "Cannot read config " << value << ": " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else if (flag == "--generate")
+            generate = value;
+        else if (flag == "--profile" && value == "low_latency")
+            profile = network::latency_profile::LOW_LATENCY;
+        else if (flag == "--profile" && value == "power_saving")
+            profile = network::latency_profile::POWER_SAVING;
+        else if (flag == "--cores")
+        {
+            for (size_t start = 0, end = 0; end != std::string::npos; start = end + 1)
+            {
+                end = value.find(',', start);
+                cores.push_back(std::stoi(value.substr(start, end - start)));
+            }
+        }
+        else if (flag == "--gateway")
+        {
+            for (size_t start = 0, end = 0; end != std::string::npos; start = end + 1)
+            {
+                end = value.find(',', start);
+                gateway.push_back(value.substr(start, end - start));
+            }
+        }
+        else
+            std::cout << "Unknown option " << flag << std::endl;
+    }
+
+    if (port)
+        config.port = *port;
+    if (profile)
+        config.runtime.profile = *profile;
+    if (cores.size() > 0)
+        config.runtime.exchange_core = cores[0];
+    if (cores.size() > 1)
+        config.runtime.publisher_core = cores[1];
+    if (cores.size() > 2)
+        config.runtime.io_core = cores[2];
+
+    if (!generate.empty())
+    {
+        size_t x = generate.find('x');
+        if (x == std::string::npos)
+        {
+            std::cout << "Expected --generate <tickers>x<users>" << std::endl;
+            return 1;
+        }
+        config.universe = market::synthetic_universe(std::stoul(generate.substr(0, x)), std::stoul(generate.substr(x + 1)));
+        std::cout << network::config_json(config).dump(4) << std::endl;
+        return 0;
+    }
+
+    if (part.count == 0 || part.index >= part.count)
+    {
+        std::cout << "Partition " << part.index << " of " << part.count << " does not exist" << std::endl;
+        return 1;
+    }
+
+    if (accounts > 0)
+    {
+        std::cout << "Settling " << accounts << " partitions" << std::endl;
+        network::account_service service{ accounts, config.universe };
+        service.run(config.runtime.profile == network::latency_profile::LOW_LATENCY);
+        return 0;
+    }
+
+    if (!gateway.empty())
+    {
+        std::cout << "Starting gateway to " << gateway.size() << " partitions on port " << config.port << std::endl;
+        network::gateway front{ config.port, gateway, config.universe };
+        front.start();
+        return 0;
+    }
+
     // start file server
     // TODO: fix this on servers not working?
     // std::thread file([]()
@@ -24,8 +151,20 @@ auto main() -> int
     // });
 
 
-    network::server server{ 8080 };
-    std::cout << "Starting exchange on port 8080" << std::endl;
+    std::cout << "Depth kernels using " << market::kernels::instruction_set_repr[static_cast<int>(market::kernels::active())] << std::endl;
+
+    // before the server is built, so its books and queues are allocated near the matcher's core
+    network::prepare_process(config.runtime);
+    network::server server{ config, part };
+    if (!primary.empty())
+        server.replicate_to(primary, journal);
+    if (!backup.empty())
+    {
+        std::cout << "Following the primary on " << backup << std::endl;
+        server.follow(backup);
+    }
+    std::cout << "Starting exchange on port " << config.port << " with " << config.universe.tickers.size()
+        << " tickers and " << config.universe.users.size() << " users" << std::endl;
     server.start();
 
     return 0;
@@ -0,0 +1,104 @@
+#include "mapped_file.h"
+
+#include <fmt/core.h>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+market::mapped_file::mapped_file(const string &path)
+    : m_data(nullptr), m_size(0), m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+{
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error(fmt::format("cannot open {} to map", path));
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(m_file, &size);
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size == 0)
+        return;
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping != nullptr)
+    {
+        m_data = static_cast<const unsigned char *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (m_data == nullptr)
+    {
+        if (m_mapping != nullptr)
+            CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        throw std::runtime_error(fmt::format("cannot map {}", path));
+    }
+}
+
+market::mapped_file::~mapped_file()
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mapping != nullptr)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+}
+
+#else
+
+market::mapped_file::mapped_file(const string &path)
+    : m_data(nullptr), m_size(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error(fmt::format("cannot open {} to map", path));
+
+    struct stat info;
+    if (::fstat(fd, &info) == -1)
+    {
+        ::close(fd);
+        throw std::runtime_error(fmt::format("cannot stat {}", path));
+    }
+
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size > 0)
+    {
+        void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error(fmt::format("cannot map {}", path));
+        }
+        m_data = static_cast<const unsigned char *>(data);
+    }
+
+    // the mapping keeps the file open
+    ::close(fd);
+}
+
+market::mapped_file::~mapped_file()
+{
+    if (m_data != nullptr)
+        ::munmap(const_cast<unsigned char *>(m_data), m_size);
+}
+
+#endif
+
+auto market::mapped_file::data() const -> const unsigned char *
+{
+    return m_data;
+}
+
+auto market::mapped_file::size() const -> size_t
+{
+    return m_size;
+}
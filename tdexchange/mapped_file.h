@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace market
+{
+
+using namespace std;
+
+/**
+ * @brief A read-only memory mapping of a whole file
+ *
+ * The pages are backed by the file, so the os can drop them under memory pressure and read them back on access.
+*/
+class mapped_file
+{
+protected:
+    const unsigned char *m_data;
+    size_t m_size;
+
+#ifdef _WIN32
+    void *m_file;
+    void *m_mapping;
+#endif
+
+public:
+    /**
+     * @brief Maps a file, raising exceptions when it cannot be opened or mapped
+     * @param path
+    */
+    mapped_file(const string &path);
+    ~mapped_file();
+
+    mapped_file(const mapped_file &) = delete;
+    auto operator=(const mapped_file &) -> mapped_file & = delete;
+
+    auto data() const -> const unsigned char *;
+    auto size() const -> size_t;
+};
+
+};
@@ -0,0 +1,205 @@
+#include "memory_arena.h"
+#include "logger.h"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// blocks up to this size are pooled, larger ones come straight from the pages, reused by size
+static const size_t POOL_BLOCK = 64 * 1024;
+
+static auto round_up(size_t bytes, size_t multiple) -> size_t
+{
+    return (bytes + multiple - 1) / multiple * multiple;
+}
+
+market::hugepage_resource::hugepage_resource(page_backing backing)
+    : m_requested(backing), m_backing(backing), m_chunks(), m_next(nullptr), m_left(0), m_free(), m_mapped(0), m_huge(0)
+{
+}
+
+market::hugepage_resource::~hugepage_resource()
+{
+    for (const auto &[data, size] : m_chunks)
+    {
+#ifdef _WIN32
+        VirtualFree(data, 0, MEM_RELEASE);
+#else
+        ::munmap(data, size);
+#endif
+    }
+}
+
+auto market::hugepage_resource::get_stats(memory_stats &stats) const -> void
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    stats.requested = m_requested;
+    stats.backing = m_backing;
+    stats.mapped = m_mapped;
+    stats.huge = m_huge;
+}
+
+auto market::hugepage_resource::do_allocate(size_t bytes, size_t alignment) -> void *
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    for (auto [it, end] = m_free.equal_range(bytes); it != end; ++it)
+    {
+        if (reinterpret_cast<uintptr_t>(it->second) % alignment == 0)
+        {
+            void *reused = it->second;
+            m_free.erase(it);
+            return reused;
+        }
+    }
+
+    size_t pad = m_next == nullptr ? 0 : (alignment - reinterpret_cast<uintptr_t>(m_next) % alignment) % alignment;
+    if (m_next == nullptr || pad + bytes > m_left)
+    {
+        // the tail of the last chunk is left unused, chunks start on a page boundary
+        map_chunk(bytes + alignment);
+        pad = (alignment - reinterpret_cast<uintptr_t>(m_next) % alignment) % alignment;
+    }
+
+    void *data = m_next + pad;
+    m_next += pad + bytes;
+    m_left -= pad + bytes;
+    return data;
+}
+
+auto market::hugepage_resource::do_deallocate(void *p, size_t bytes, size_t) -> void
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_free.insert({ bytes, p });
+}
+
+auto market::hugepage_resource::do_is_equal(const pmr::memory_resource &other) const noexcept -> bool
+{
+    return this == &other;
+}
+
+auto market::hugepage_resource::map_chunk(size_t bytes) -> void
+{
+    size_t size = round_up(std::max(bytes, ARENA_CHUNK), HUGEPAGE_SIZE);
+    void *data = nullptr;
+    page_backing backing = page_backing::DEFAULT;
+
+#ifdef _WIN32
+    // large pages need the lock pages in memory privilege, windows has no transparent hugepages
+    size_t large = GetLargePageMinimum();
+    if (m_requested == page_backing::EXPLICIT && large > 0)
+    {
+        size = round_up(size, large);
+        data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (data != nullptr)
+            backing = page_backing::EXPLICIT;
+    }
+    if (data == nullptr)
+        data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (data == nullptr)
+        throw std::bad_alloc();
+#else
+#ifdef MAP_HUGETLB
+    if (m_requested == page_backing::EXPLICIT)
+    {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_2MB
+        flags |= MAP_HUGE_2MB;
+#endif
+        data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (data == MAP_FAILED)
+            data = nullptr;
+        else
+            backing = page_backing::EXPLICIT;
+    }
+#endif
+    if (data == nullptr)
+    {
+        // a hugepage more is mapped and trimmed, so the chunk starts on a hugepage the kernel can back
+        void *raw = ::mmap(nullptr, size + HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            throw std::bad_alloc();
+
+        char *start = static_cast<char *>(raw);
+        char *aligned = reinterpret_cast<char *>(round_up(reinterpret_cast<uintptr_t>(start), HUGEPAGE_SIZE));
+        if (aligned > start)
+            ::munmap(start, aligned - start);
+        if (start + HUGEPAGE_SIZE > aligned)
+            ::munmap(aligned + size, start + HUGEPAGE_SIZE - aligned);
+        data = aligned;
+
+#ifdef MADV_HUGEPAGE
+        if (m_requested != page_backing::DEFAULT && ::madvise(data, size, MADV_HUGEPAGE) == 0)
+            backing = page_backing::TRANSPARENT;
+#endif
+    }
+#endif
+
+    if (backing != m_backing || m_chunks.empty())
+    {
+        logger::mode mode = backing == m_requested ? logger::mode::INFO : logger::mode::WARN;
+        logger::log(fmt::format("arena mapped {} MB with {} pages, {} asked for", size >> 20,
+            page_backing_repr[static_cast<int>(backing)], page_backing_repr[static_cast<int>(m_requested)]), mode);
+    }
+
+    m_chunks.emplace_back(data, size);
+    m_next = static_cast<char *>(data);
+    m_left = size;
+    m_backing = backing;
+    m_mapped += size;
+    if (backing != page_backing::DEFAULT)
+        m_huge += size;
+}
+
+market::memory_arena::memory_arena(page_backing backing)
+    : m_pages(), m_pool(), m_upstream(pmr::new_delete_resource()), m_stats{ .requested = backing }
+{
+    if (backing == page_backing::DEFAULT)
+        return;
+
+    pmr::pool_options options;
+    options.largest_required_pool_block = POOL_BLOCK;
+    m_pages = std::make_unique<hugepage_resource>(backing);
+    m_pool = std::make_unique<pmr::unsynchronized_pool_resource>(options, m_pages.get());
+    m_upstream = m_pool.get();
+}
+
+auto market::memory_arena::get_stats() const -> memory_stats
+{
+    memory_stats stats = m_stats;
+    if (m_pages != nullptr)
+        m_pages->get_stats(stats);
+    return stats;
+}
+
+auto market::memory_arena::do_allocate(size_t bytes, size_t alignment) -> void *
+{
+    void *data = m_upstream->allocate(bytes, alignment);
+
+    m_stats.in_use += bytes;
+    m_stats.peak = std::max(m_stats.peak, m_stats.in_use);
+    m_stats.allocations += 1;
+    return data;
+}
+
+auto market::memory_arena::do_deallocate(void *p, size_t bytes, size_t alignment) -> void
+{
+    m_upstream->deallocate(p, bytes, alignment);
+
+    m_stats.in_use -= bytes;
+    m_stats.deallocations += 1;
+}
+
+auto market::memory_arena::do_is_equal(const pmr::memory_resource &other) const noexcept -> bool
+{
+    return this == &other;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+namespace market
+{
+
+using namespace std;
+
+// the size of a hugepage on x86 and most arm kernels, arenas map whole hugepages
+constexpr size_t HUGEPAGE_SIZE = 2 * 1024 * 1024;
+// what an arena maps at once, more is mapped as it fills
+constexpr size_t ARENA_CHUNK = 16 * HUGEPAGE_SIZE;
+
+// the pages an arena is mapped with
+enum class page_backing
+{
+    // the heap, as without an arena
+    DEFAULT = 0,
+    // normal pages the kernel is advised to back with hugepages, transparent_hugepage set to madvise or always
+    TRANSPARENT = 1,
+    // hugepages reserved up front, in vm.nr_hugepages
+    EXPLICIT = 2
+};
+static const char *page_backing_repr[] = { "default", "transparent", "explicit" };
+
+struct memory_stats
+{
+    // the pages asked for, and those the last chunk was actually mapped with
+    page_backing requested = page_backing::DEFAULT;
+    page_backing backing = page_backing::DEFAULT;
+
+    // bytes mapped, and those of them on hugepages, or advised to be for transparent hugepages
+    size_t mapped = 0;
+    size_t huge = 0;
+
+    // bytes allocated and not yet freed, and the most there ever were
+    size_t in_use = 0;
+    size_t peak = 0;
+    unsigned long long allocations = 0;
+    unsigned long long deallocations = 0;
+};
+
+/**
+ * @brief Hands out memory from chunks mapped on hugepages, falling back to normal pages when there are none
+ *
+ * Explicit hugepages fall back to transparent ones, and those to normal pages. Chunks are only unmapped with
+ * the resource, freed blocks are kept by size for the next allocation of that size, which is what a pool
+ * resource above it asks for again. Safe to share between threads.
+*/
+class hugepage_resource : public pmr::memory_resource
+{
+protected:
+    page_backing m_requested;
+    page_backing m_backing;
+
+    // every chunk mapped, and the unused tail of the last one
+    vector<pair<void *, size_t>> m_chunks;
+    char *m_next;
+    size_t m_left;
+
+    // freed blocks, by size
+    multimap<size_t, void *> m_free;
+
+    size_t m_mapped;
+    size_t m_huge;
+    mutable mutex m_lock;
+
+public:
+    explicit hugepage_resource(page_backing backing);
+    ~hugepage_resource();
+
+    hugepage_resource(const hugepage_resource &) = delete;
+    auto operator=(const hugepage_resource &) -> hugepage_resource & = delete;
+
+    // fills in the backing and bytes mapped
+    auto get_stats(memory_stats &stats) const -> void;
+
+protected:
+    auto do_allocate(size_t bytes, size_t alignment) -> void * override;
+    auto do_deallocate(void *p, size_t bytes, size_t alignment) -> void override;
+    auto do_is_equal(const pmr::memory_resource &other) const noexcept -> bool override;
+
+    // maps a chunk of at least some bytes, with the best pages available
+    auto map_chunk(size_t bytes) -> void;
+};
+
+/**
+ * @brief The memory of one exchange, pooled over hugepages and counted
+ *
+ * Only used by the thread applying commands to the exchange. The default backing allocates from the heap
+ * directly, only counting.
+*/
+class memory_arena : public pmr::memory_resource
+{
+protected:
+    unique_ptr<hugepage_resource> m_pages;
+    unique_ptr<pmr::unsynchronized_pool_resource> m_pool;
+    pmr::memory_resource *m_upstream;
+
+    memory_stats m_stats;
+
+public:
+    explicit memory_arena(page_backing backing = page_backing::DEFAULT);
+
+    memory_arena(const memory_arena &) = delete;
+    auto operator=(const memory_arena &) -> memory_arena & = delete;
+
+    auto get_stats() const -> memory_stats;
+
+protected:
+    auto do_allocate(size_t bytes, size_t alignment) -> void * override;
+    auto do_deallocate(void *p, size_t bytes, size_t alignment) -> void override;
+    auto do_is_equal(const pmr::memory_resource &other) const noexcept -> bool override;
+};
+
+};
@@ -5,6 +5,21 @@
 
 auto market::order::repr() const -> string
 {
+    if (display > 0)
+    {
+        return fmt::format(
+            "Order {}, type {} by {} on {} of {} (+{} hidden, shows {}) @ {}",
+            id,
+            market::side_repr[static_cast<int>(wish)],
+            user_id,
+            ticker_id,
+            volume,
+            hidden,
+            display,
+            price
+        );
+    }
+
     return fmt::format(
         "Order {}, type {} by {} on {} of {} @ {}",
         id,
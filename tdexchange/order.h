@@ -9,6 +9,35 @@ namespace market
 {
 using namespace std;
 
+// how an order is matched, only limit and post only orders can rest in the book
+// stops wait for the last price to reach their trigger, then become a market or limit order
+enum class order_type
+{
+    LIMIT = 0,
+    IOC = 1,
+    MARKET = 2,
+    FOK = 3,
+    POST_ONLY = 4,
+    STOP = 5,
+    STOP_LIMIT = 6
+};
+static const char *order_type_repr[] = { "LIM", "IOC", "MKT", "FOK", "POST", "STOP", "STOPLIM" };
+
+// what happens when an order would trade against a resting order of the same user
+enum class self_trade
+{
+    // trade anyway
+    NONE = 0,
+    // cancel the rest of the incoming order
+    CANCEL_NEWEST = 1,
+    // cancel the resting order and keep matching
+    CANCEL_OLDEST = 2,
+    CANCEL_BOTH = 3,
+    // reduce both orders by the smaller volume, without trading
+    DECREMENT = 4
+};
+static const char *self_trade_repr[] = { "none", "cancel_newest", "cancel_oldest", "cancel_both", "decrement" };
+
 // represents an order in the order book
 struct order
 {
@@ -26,7 +55,28 @@ struct order
     int price;
     int volume;
 
+    // iceberg orders show at most display volume at a time, holding the rest in reserve
+    // in the order book volume is the shown slice and hidden the reserve,
+    // everywhere else volume is the total left and hidden is unused
+    int display = 0;
+    int hidden = 0;
+
+    // self-trade prevention, applied when the order is the aggressor
+    self_trade stp = self_trade::NONE;
+
     /// DISPLAY ///
     auto repr() const->string;
 };
+
+// an order waiting for the last traded price to reach its trigger
+struct stop_order
+{
+    order ord;
+
+    // buy stops trigger when the last price rises to the trigger, sell stops when it falls to it
+    int trigger;
+
+    // the type of the order once triggered, market or limit
+    order_type type;
+};
 };
\ No newline at end of file
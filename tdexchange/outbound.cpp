@@ -0,0 +1,128 @@
+#include "outbound.h"
+
+#include <algorithm>
+#include <utility>
+
+network::outbound_queue::outbound_queue(const outbound_limits &limits)
+    : m_limits(limits), m_metrics(), m_reliable(), m_bytes(0), m_tick(), m_tick_bytes(0), m_snapshots()
+{
+}
+
+auto network::outbound_queue::push(std::string message) -> bool
+{
+    m_bytes += message.size();
+    m_reliable.push_back(std::move(message));
+
+    m_metrics.peak_messages = std::max(m_metrics.peak_messages, m_reliable.size());
+    m_metrics.peak_bytes = std::max(m_metrics.peak_bytes, get_bytes());
+
+    return m_reliable.size() <= m_limits.max_messages && get_bytes() <= m_limits.max_bytes;
+}
+
+auto network::outbound_queue::push_tick(json tick) -> bool
+{
+    if (!m_tick)
+    {
+        m_metrics.lagging_ticks = 0;
+        m_tick = std::move(tick);
+        m_tick_bytes = 0;
+        return true;
+    }
+
+    // the previous tick is still unsent, keep its transactions but replace everything else,
+    // their size is only measured once a tick lags, so a connection keeping up never encodes them twice
+    json &transactions = (*m_tick)["transactions"];
+    if (m_metrics.lagging_ticks == 0)
+    {
+        m_tick_bytes = transactions.dump().size();
+    }
+    for (auto &trans : tick["transactions"])
+    {
+        // and a comma
+        m_tick_bytes += trans.dump().size() + 1;
+        transactions.push_back(std::move(trans));
+    }
+    tick["transactions"] = std::move(transactions);
+    m_tick = std::move(tick);
+
+    m_metrics.conflated += 1;
+    m_metrics.lagging_ticks += 1;
+    m_metrics.peak_bytes = std::max(m_metrics.peak_bytes, get_bytes());
+
+    return m_metrics.lagging_ticks <= m_limits.max_lagging_ticks && get_bytes() <= m_limits.max_bytes;
+}
+
+auto network::outbound_queue::push_snapshot(const std::string &topic, std::string message) -> bool
+{
+    auto it = std::find_if(m_snapshots.begin(), m_snapshots.end(), [&](const snapshot &queued)
+    {
+        return queued.topic == topic;
+    });
+    if (it == m_snapshots.end())
+    {
+        m_snapshots.push_back({ topic, std::move(message), 0 });
+    }
+    else
+    {
+        // the previous snapshot of the topic is still unsent, only the latest matters
+        it->message = std::move(message);
+        it->lagging += 1;
+        m_metrics.conflated += 1;
+    }
+
+    // the connection is as far behind as its most lagging topic
+    m_metrics.lagging_ticks = 0;
+    for (const snapshot &queued : m_snapshots)
+    {
+        m_metrics.lagging_ticks = std::max(m_metrics.lagging_ticks, queued.lagging);
+    }
+
+    return m_metrics.lagging_ticks <= m_limits.max_lagging_ticks;
+}
+
+auto network::outbound_queue::has_pending() const -> bool
+{
+    return !m_reliable.empty() || m_tick.has_value() || !m_snapshots.empty();
+}
+
+auto network::outbound_queue::pop() -> std::string
+{
+    std::string message;
+    if (!m_reliable.empty())
+    {
+        message = std::move(m_reliable.front());
+        m_reliable.pop_front();
+        m_bytes -= message.size();
+    }
+    else if (m_tick)
+    {
+        message = m_tick->dump();
+        m_tick.reset();
+        m_tick_bytes = 0;
+    }
+    else
+    {
+        message = std::move(m_snapshots.front().message);
+        m_snapshots.pop_front();
+    }
+
+    m_metrics.sent_messages += 1;
+    m_metrics.sent_bytes += message.size();
+
+    return message;
+}
+
+auto network::outbound_queue::get_metrics() const -> const outbound_metrics &
+{
+    return m_metrics;
+}
+
+auto network::outbound_queue::get_messages() const -> size_t
+{
+    return m_reliable.size() + (m_tick ? 1 : 0) + m_snapshots.size();
+}
+
+auto network::outbound_queue::get_bytes() const -> size_t
+{
+    return m_bytes + m_tick_bytes;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <optional>
+
+#include <nlohmann/json.hpp>
+
+using nlohmann::json;
+
+namespace network
+{
+
+/**
+ * @brief Limits on how far a connection may fall behind before it is treated as a slow consumer
+*/
+struct outbound_limits
+{
+    // maximum reliable messages waiting in the queue
+    size_t max_messages = 1024;
+    // maximum bytes of reliable messages waiting in the queue
+    size_t max_bytes = 4 * 1024 * 1024;
+    // stop handing messages to the socket once this many bytes are still unwritten
+    size_t max_buffered = 1024 * 1024;
+    // consecutive ticks conflated before the connection is dropped
+    int max_lagging_ticks = 250;
+};
+
+// counters kept for each connection
+struct outbound_metrics
+{
+    unsigned long long sent_messages = 0;
+    unsigned long long sent_bytes = 0;
+
+    // ticks replaced before they were sent
+    unsigned long long conflated = 0;
+
+    // high watermarks of the reliable queue
+    size_t peak_messages = 0;
+    size_t peak_bytes = 0;
+
+    // consecutive ticks where the previous tick was still unsent
+    int lagging_ticks = 0;
+};
+
+/**
+ * @brief A per-connection queue of messages waiting to be written to the socket
+ *
+ * Reliable messages (acks, fills) are kept in order and never dropped. Tick snapshots are conflated,
+ * so only the latest one is kept while the previous one is unsent, with their transactions merged.
+ * The transactions merged into a tick count towards the byte limit, as they are never dropped either.
+ * Topic snapshots are conflated the same way, keeping only the latest unsent one of each topic.
+*/
+class outbound_queue
+{
+protected:
+    outbound_limits m_limits;
+    outbound_metrics m_metrics;
+
+    // reliable messages, serialized
+    std::deque<std::string> m_reliable;
+    size_t m_bytes;
+
+    // latest unsent tick snapshot, and the encoded size of its transactions once another tick was merged into it
+    std::optional<json> m_tick;
+    size_t m_tick_bytes;
+
+    // latest unsent snapshot of each topic, serialized, with the ticks it has been replaced for
+    struct snapshot
+    {
+        std::string topic;
+        std::string message;
+        int lagging;
+    };
+    std::deque<snapshot> m_snapshots;
+
+public:
+    explicit outbound_queue(const outbound_limits &limits = {});
+
+    /**
+     * @brief Queue a message that must be delivered
+     * @param message Serialized message
+     * @return False if the connection is now over its limits and should be dropped
+    */
+    auto push(std::string message) -> bool;
+
+    /**
+     * @brief Queue a tick snapshot, replacing any unsent one but keeping its transactions
+     * @param tick The tick payload, with a "transactions" array
+     * @return False if the connection has lagged for too many ticks, or is now over its byte limit, and should be dropped
+    */
+    auto push_tick(json tick) -> bool;
+
+    /**
+     * @brief Queue the snapshot of a topic, replacing any unsent one of the same topic
+     * @param topic The topic, pushed at most once per tick
+     * @param message Serialized message
+     * @return False if the topic has lagged for too many ticks and the connection should be dropped
+    */
+    auto push_snapshot(const std::string &topic, std::string message) -> bool;
+
+    // returns whether there is anything left to send
+    auto has_pending() const -> bool;
+
+    /**
+     * @brief Removes the next message to write, reliable messages first, then the tick, then topic snapshots
+     * @return The serialized message
+    */
+    auto pop() -> std::string;
+
+    auto get_metrics() const -> const outbound_metrics &;
+    auto get_messages() const -> size_t;
+    // bytes of reliable messages and of the transactions merged into the tick
+    auto get_bytes() const -> size_t;
+};
+
+}
@@ -0,0 +1,26 @@
+#include "partition.h"
+
+#include <cassert>
+
+auto market::partition::owns(ids::ticker_id ticker_id) const -> bool
+{
+    return ticker_partition(ticker_id, count) == index;
+}
+
+auto market::partition::order_id(ids::order_id n) const -> ids::order_id
+{
+    assert(n > 0);
+    return n * count + index;
+}
+
+auto market::ticker_partition(ids::ticker_id ticker_id, size_t count) -> size_t
+{
+    assert(ticker_id > 0 && count > 0);
+    return static_cast<size_t>((ticker_id - 1) % count);
+}
+
+auto market::order_partition(ids::order_id order_id, size_t count) -> size_t
+{
+    assert(count > 0);
+    return static_cast<size_t>(order_id % count);
+}
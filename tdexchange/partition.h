@@ -0,0 +1,33 @@
+#pragma once
+
+#include "id.h"
+
+namespace market
+{
+
+using namespace std;
+
+/**
+ * @brief The tickers an exchange process owns, when tickers are partitioned over several processes
+ *
+ * Tickers are dealt round robin by id. Order ids are striped by partition, so every partition numbers
+ * its own orders and the partition holding an order follows from its id.
+*/
+struct partition
+{
+    size_t index = 0;
+    size_t count = 1;
+
+    auto owns(ids::ticker_id ticker_id) const -> bool;
+
+    // the id of the n-th order numbered by this partition, from 1
+    auto order_id(ids::order_id n) const -> ids::order_id;
+};
+
+// returns the partition owning a ticker, out of count
+auto ticker_partition(ids::ticker_id ticker_id, size_t count) -> size_t;
+
+// returns the partition that numbered an order, out of count
+auto order_partition(ids::order_id order_id, size_t count) -> size_t;
+
+};
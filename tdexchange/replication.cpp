@@ -0,0 +1,348 @@
+#include "replication.h"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+#include "logger.h"
+
+namespace asio = boost::asio;
+
+auto network::replication_endpoint(const std::string &address) -> stream::endpoint
+{
+    size_t colon = address.rfind(':');
+    bool tcp = colon != std::string::npos && colon + 1 < address.size()
+        && std::all_of(address.begin() + colon + 1, address.end(), [](char c) { return c >= '0' && c <= '9'; });
+    if (tcp)
+    {
+        asio::io_context io;
+        asio::ip::tcp::resolver resolver(io);
+        auto results = resolver.resolve(address.substr(0, colon), address.substr(colon + 1));
+        if (results.empty())
+            throw std::runtime_error(fmt::format("cannot resolve {}", address));
+        return stream::endpoint(results.begin()->endpoint());
+    }
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    return stream::endpoint(asio::local::stream_protocol::endpoint(address));
+#else
+    throw std::runtime_error(fmt::format("{} is not host:port, and there are no unix sockets here", address));
+#endif
+}
+
+static auto is_local(const network::stream::endpoint &endpoint) -> bool
+{
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    return endpoint.protocol().family() == AF_UNIX;
+#else
+    return false;
+#endif
+}
+
+// sends a hello and checks the one received back, raising exceptions when they do not match
+static auto exchange_hellos(network::stream::socket &socket, unsigned long long sequence) -> unsigned long long
+{
+    network::replication_hello hello{
+        network::REPLICATION_MAGIC, network::REPLICATION_VERSION, sizeof(market::command), sequence
+    };
+    asio::write(socket, asio::buffer(&hello, sizeof(hello)));
+
+    network::replication_hello other{};
+    asio::read(socket, asio::buffer(&other, sizeof(other)));
+    if (other.magic != network::REPLICATION_MAGIC || other.version != network::REPLICATION_VERSION
+        || other.record != sizeof(market::command))
+        throw std::runtime_error("the other end of replication is another build");
+
+    return other.sequence;
+}
+
+network::replication_primary::replication_primary(const std::string &address, std::unique_ptr<market::journal_file> journal, size_t backlog)
+    : m_address(address), m_journal(std::move(journal)), m_backlog(backlog), m_acceptor(m_io), m_pushed(0), m_stopping(false),
+    m_journaled(m_journal->get_last()), m_backup_count(0)
+{
+    stream::endpoint endpoint = replication_endpoint(address);
+    if (is_local(endpoint))
+    {
+        // a socket left over by a crashed run refuses the bind
+        std::remove(address.c_str());
+    }
+
+    m_acceptor.open(endpoint.protocol());
+    if (!is_local(endpoint))
+        m_acceptor.set_option(asio::socket_base::reuse_address(true));
+    m_acceptor.bind(endpoint);
+    m_acceptor.listen();
+
+    accept();
+    m_acceptor_thread = std::thread([this]() { m_io.run(); });
+    m_sender_thread = std::thread(&replication_primary::send, this);
+
+    logger::log(fmt::format("replicating to backups on {} from sequence {}", address, m_journaled.load()));
+}
+
+network::replication_primary::~replication_primary()
+{
+    m_io.stop();
+    m_acceptor_thread.join();
+
+    m_stopping.store(true);
+    m_pushed.fetch_add(1, std::memory_order_release);
+    m_pushed.notify_one();
+    m_sender_thread.join();
+
+    if (is_local(replication_endpoint(m_address)))
+        std::remove(m_address.c_str());
+}
+
+auto network::replication_primary::replicate(std::vector<market::command> commands) -> void
+{
+    if (commands.empty())
+        return;
+
+    auto batch = std::make_unique<std::vector<market::command>>(std::move(commands));
+    while (!m_batches.try_push(std::move(batch)))
+    {
+        // a full queue means the disk is slower than the exchange, which waits rather than lose commands,
+        // backups never fill it as they are written without blocking
+        std::this_thread::yield();
+    }
+    m_pushed.fetch_add(1, std::memory_order_release);
+    m_pushed.notify_one();
+}
+
+auto network::replication_primary::get_backups() const -> size_t
+{
+    return m_backup_count.load(std::memory_order_relaxed);
+}
+
+auto network::replication_primary::accept() -> void
+{
+    m_acceptor.async_accept([this](const boost::system::error_code &error, stream::socket socket)
+        {
+            if (error == asio::error::operation_aborted)
+                return;
+            if (!error)
+                handshake(std::make_shared<stream::socket>(std::move(socket)));
+            accept();
+        });
+}
+
+auto network::replication_primary::handshake(std::shared_ptr<stream::socket> socket) -> void
+{
+    auto hello = std::make_shared<replication_hello>();
+    asio::async_read(*socket, asio::buffer(hello.get(), sizeof(replication_hello)),
+        [this, socket, hello](const boost::system::error_code &error, size_t)
+        {
+            if (error)
+                return;
+
+            unsigned long long journaled = m_journaled.load(std::memory_order_acquire);
+            if (hello->magic != REPLICATION_MAGIC || hello->version != REPLICATION_VERSION
+                || hello->record != sizeof(market::command) || hello->sequence > journaled)
+            {
+                // closing without a hello tells the backup it was refused
+                logger::log(fmt::format("refused a backup at sequence {}, journaled {}", hello->sequence, journaled),
+                    logger::mode::WARN);
+                return;
+            }
+
+            boost::system::error_code ignored;
+            socket->set_option(asio::ip::tcp::no_delay(true), ignored);
+
+            auto reply = std::make_shared<replication_hello>(replication_hello{
+                REPLICATION_MAGIC, REPLICATION_VERSION, sizeof(market::command), journaled
+            });
+            unsigned long long sequence = hello->sequence;
+            asio::async_write(*socket, asio::buffer(reply.get(), sizeof(replication_hello)),
+                [this, socket, reply, sequence](const boost::system::error_code &error, size_t)
+                {
+                    if (error)
+                        return;
+                    {
+                        std::lock_guard<std::mutex> lock(m_pending_lock);
+                        m_pending.emplace_back(socket, sequence);
+                    }
+                    m_pushed.fetch_add(1, std::memory_order_release);
+                    m_pushed.notify_one();
+                });
+        });
+}
+
+auto network::replication_primary::catch_up(replication_link &link) -> void
+{
+    // only up to half the backlog, so the batches queued once it has caught up have room
+    while (link.sequence < m_journal->get_last() && link.bytes < m_backlog / 2)
+    {
+        size_t room = std::max<size_t>((m_backlog / 2 - link.bytes) / sizeof(market::command), 1);
+        auto commands = std::make_shared<std::vector<market::command>>(m_journal->read(link.sequence, std::min(room, CATCH_UP_BATCH)));
+        if (commands->empty())
+            break;
+
+        link.sequence = commands->back().sequence;
+        link.bytes += commands->size() * sizeof(market::command);
+        link.queued.push_back(std::move(commands));
+    }
+}
+
+auto network::replication_primary::flush(replication_link &link) -> bool
+{
+    std::vector<asio::const_buffer> buffers;
+    while (!link.queued.empty())
+    {
+        buffers.clear();
+        buffers.push_back(asio::buffer(*link.queued.front()) + link.offset);
+        for (auto it = link.queued.begin() + 1; it != link.queued.end(); ++it)
+            buffers.push_back(asio::buffer(**it));
+
+        boost::system::error_code error;
+        size_t written = link.socket->write_some(buffers, error);
+        if (error == asio::error::would_block || error == asio::error::try_again)
+            return true;
+        if (error)
+        {
+            logger::log(fmt::format("backup lost at sequence {}: {}", link.sequence, error.message()), logger::mode::WARN);
+            return false;
+        }
+
+        // whole batches written leave the queue, the rest of a batch cut short is written next time
+        link.bytes -= written;
+        written += link.offset;
+        while (!link.queued.empty() && written >= link.queued.front()->size() * sizeof(market::command))
+        {
+            written -= link.queued.front()->size() * sizeof(market::command);
+            link.queued.pop_front();
+        }
+        link.offset = written;
+    }
+    return true;
+}
+
+auto network::replication_primary::send() -> void
+{
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+
+    while (true)
+    {
+        unsigned long long pushed = m_pushed.load(std::memory_order_acquire);
+
+        std::vector<std::shared_ptr<const std::vector<market::command>>> batches;
+        while (auto batch = m_batches.try_pop())
+        {
+            m_journal->append(**batch);
+            batches.push_back(std::move(*batch));
+        }
+        if (!batches.empty())
+            m_journaled.store(m_journal->get_last(), std::memory_order_release);
+
+        std::vector<std::pair<std::shared_ptr<stream::socket>, unsigned long long>> pending;
+        {
+            std::lock_guard<std::mutex> lock(m_pending_lock);
+            pending.swap(m_pending);
+        }
+        for (auto &[socket, sequence] : pending)
+        {
+            boost::system::error_code error;
+            socket->non_blocking(true, error);
+            if (error)
+                continue;
+
+            logger::log(fmt::format("backup joined at sequence {}, catching up to {}", sequence, m_journal->get_last()));
+            m_backups.push_back({ socket, sequence });
+        }
+
+        // a backup caught up is queued the batches themselves, one still behind reads them from the journal,
+        // and one that stopped reading is dropped before it holds much memory
+        std::erase_if(m_backups, [&](replication_link &link)
+            {
+                for (const auto &batch : batches)
+                {
+                    if (link.sequence + 1 != batch->front().sequence)
+                        continue;
+
+                    link.sequence = batch->back().sequence;
+                    link.bytes += batch->size() * sizeof(market::command);
+                    link.queued.push_back(batch);
+                    if (link.bytes > m_backlog && flush(link) && link.bytes > m_backlog)
+                    {
+                        logger::log(fmt::format("backup fell {} bytes behind at sequence {}, dropped", link.bytes, link.sequence),
+                            logger::mode::WARN);
+                        return true;
+                    }
+                }
+
+                catch_up(link);
+                return !flush(link);
+            });
+        m_backup_count.store(m_backups.size(), std::memory_order_relaxed);
+
+        bool writing = std::ranges::any_of(m_backups, [&](const replication_link &link)
+            {
+                return !link.queued.empty() || link.sequence < m_journal->get_last();
+            });
+
+        // everything queued is still sent on shutdown, for as long as the backups keep reading
+        if (m_stopping.load())
+        {
+            if (!deadline)
+                deadline = std::chrono::steady_clock::now() + DRAIN_TIMEOUT;
+            if (!writing || std::chrono::steady_clock::now() > *deadline)
+                return;
+        }
+
+        if (writing)
+            std::this_thread::sleep_for(SEND_RETRY);
+        else if (batches.empty() && pending.empty() && !m_stopping.load())
+            m_pushed.wait(pushed, std::memory_order_acquire);
+    }
+}
+
+network::replication_backup::replication_backup(const std::string &address, unsigned long long sequence)
+    : m_socket(m_io), m_primary_sequence(0)
+{
+    stream::endpoint endpoint = replication_endpoint(address);
+    m_socket.connect(endpoint);
+
+    boost::system::error_code ignored;
+    m_socket.set_option(asio::ip::tcp::no_delay(true), ignored);
+
+    try
+    {
+        m_primary_sequence = exchange_hellos(m_socket, sequence);
+    }
+    catch (const boost::system::system_error &)
+    {
+        throw std::runtime_error(fmt::format("primary on {} refused a backup at sequence {}", address, sequence));
+    }
+}
+
+auto network::replication_backup::receive(std::vector<market::command> &commands) -> bool
+{
+    commands.clear();
+
+    while (commands.empty())
+    {
+        // reads straight after the bytes of a command cut short by the last read
+        size_t kept = m_partial.size();
+        m_partial.resize(kept + RECEIVE_BUFFER);
+
+        boost::system::error_code error;
+        size_t received = m_socket.read_some(asio::buffer(m_partial.data() + kept, RECEIVE_BUFFER), error);
+        m_partial.resize(kept + received);
+        if (error)
+            return false;
+
+        size_t whole = m_partial.size() / sizeof(market::command);
+        commands.resize(whole);
+        std::memcpy(commands.data(), m_partial.data(), whole * sizeof(market::command));
+        m_partial.erase(m_partial.begin(), m_partial.begin() + whole * sizeof(market::command));
+    }
+    return true;
+}
+
+auto network::replication_backup::get_primary_sequence() const -> unsigned long long
+{
+    return m_primary_sequence;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+#include <boost/asio.hpp>
+
+#include "journal.h"
+#include "spsc_ring.h"
+
+namespace network
+{
+
+using stream = boost::asio::generic::stream_protocol;
+
+// both ends of a replication link send this first, so different builds never apply each other's commands
+struct replication_hello
+{
+    uint64_t magic;
+    uint32_t version;
+    // the size of a command
+    uint32_t record;
+    // the last command the backup applied, or the primary journaled
+    unsigned long long sequence;
+};
+constexpr uint64_t REPLICATION_MAGIC = 0x7464787265706c31ULL;
+constexpr uint32_t REPLICATION_VERSION = 1;
+
+// ticks the exchange loop may run ahead of the replication sender, and commands a joining backup is sent at once
+constexpr size_t REPLICATION_QUEUE = 256;
+constexpr size_t CATCH_UP_BATCH = 4096;
+
+// bytes queued for a backup that is sent every command, past which it is dropped as too slow, and rejoins from the journal
+constexpr size_t BACKUP_BACKLOG = 64 * 1024 * 1024;
+
+// how long the sender waits for a backup's socket to take more bytes, and for the backups to take everything on shutdown
+constexpr std::chrono::microseconds SEND_RETRY(100);
+constexpr std::chrono::seconds DRAIN_TIMEOUT(5);
+
+// bytes a backup reads at once
+constexpr size_t RECEIVE_BUFFER = 64 * 1024;
+
+// a backup connected to the primary, with the commands queued for it
+struct replication_link
+{
+    std::shared_ptr<stream::socket> socket;
+
+    // the last command queued, the backup is sent every batch once it has caught up to the journal
+    unsigned long long sequence;
+
+    // batches not yet written, shared between the backups, and how far into the first one was written
+    std::deque<std::shared_ptr<const std::vector<market::command>>> queued;
+    size_t offset = 0;
+    size_t bytes = 0;
+};
+
+/**
+ * @brief Parses the address of a replication link
+ * @param address host:port for tcp, anything else is the path of a unix socket
+ * @return
+*/
+auto replication_endpoint(const std::string &address) -> stream::endpoint;
+
+/**
+ * @brief The primary end of replication, journaling the commands of the exchange and streaming them to backups
+ *
+ * The exchange loop only hands over each tick's commands, a sender thread appends them to the journal and
+ * queues them for every backup. Backups are written without blocking, so a backup that stops reading only
+ * grows its own queue until it is dropped, and never holds back the sender or the exchange. A backup joining
+ * late is first sent the journal from the command after the last one it applied.
+*/
+class replication_primary
+{
+protected:
+    std::string m_address;
+    std::unique_ptr<market::journal_file> m_journal;
+
+    // bytes queued for a backup before it is dropped
+    size_t m_backlog;
+
+    // accepts backups and reads their hellos
+    boost::asio::io_context m_io;
+    boost::asio::basic_socket_acceptor<stream> m_acceptor;
+    std::thread m_acceptor_thread;
+
+    // commands from the exchange loop, and their count to wait on when there are none
+    spsc_ring<std::unique_ptr<std::vector<market::command>>, REPLICATION_QUEUE> m_batches;
+    std::atomic<unsigned long long> m_pushed;
+    std::atomic<bool> m_stopping;
+    std::thread m_sender_thread;
+
+    // the last command journaled, for the hellos
+    std::atomic<unsigned long long> m_journaled;
+
+    // backups that said hello and the last command they applied, until the sender catches them up
+    std::mutex m_pending_lock;
+    std::vector<std::pair<std::shared_ptr<stream::socket>, unsigned long long>> m_pending;
+
+    // backups connected, caught up or catching up, only used by the sender
+    std::vector<replication_link> m_backups;
+    std::atomic<size_t> m_backup_count;
+
+public:
+    /**
+     * @brief Listens for backups, raising exceptions when it cannot
+     * @param address Where backups connect to
+     * @param journal The journal appended to, holding every command from the first
+     * @param backlog Bytes queued for a backup before it is dropped
+    */
+    replication_primary(const std::string &address, std::unique_ptr<market::journal_file> journal, size_t backlog = BACKUP_BACKLOG);
+    ~replication_primary();
+
+    replication_primary(const replication_primary &) = delete;
+    auto operator=(const replication_primary &) -> replication_primary & = delete;
+
+    // hands the commands of a tick over to the sender, only called by the exchange loop
+    auto replicate(std::vector<market::command> commands) -> void;
+
+    // the number of backups connected, caught up or catching up
+    auto get_backups() const -> size_t;
+
+protected:
+    auto accept() -> void;
+    auto handshake(std::shared_ptr<stream::socket> socket) -> void;
+
+    // the sender loop
+    auto send() -> void;
+
+    // queues the journal after the last command queued for a backup, while its queue has room for it
+    auto catch_up(replication_link &link) -> void;
+
+    // writes what the socket of a backup takes without blocking, returning whether it is still there
+    auto flush(replication_link &link) -> bool;
+};
+
+/**
+ * @brief The backup end of replication, receiving the commands of a primary
+*/
+class replication_backup
+{
+protected:
+    boost::asio::io_context m_io;
+    stream::socket m_socket;
+
+    unsigned long long m_primary_sequence;
+
+    // bytes received past the last whole command
+    std::vector<unsigned char> m_partial;
+
+public:
+    /**
+     * @brief Connects to a primary and exchanges hellos, raising exceptions when it cannot
+     * @param address Where the primary listens
+     * @param sequence The last command applied
+    */
+    replication_backup(const std::string &address, unsigned long long sequence);
+
+    /**
+     * @brief Waits for the next commands of the primary
+     * @param commands Replaced with the commands received, in sequence
+     * @return False once the primary is gone
+    */
+    auto receive(std::vector<market::command> &commands) -> bool;
+
+    // the last command the primary had journaled when it said hello
+    auto get_primary_sequence() const -> unsigned long long;
+};
+
+};
@@ -0,0 +1,103 @@
+#include "risk.h"
+#include "logger.h"
+
+#include <fmt/core.h>
+#include <cstdlib>
+#include <algorithm>
+
+market::risk::risk(const risk_limits &limits)
+    : m_limits(limits), m_rates()
+{
+}
+
+auto market::risk::check(const user &u, const ticker &t, const order &ord, order_type type, long long now, const order *replaced) -> risk_check
+{
+    rate_window &window = current_rate(ord.user_id, now);
+    if (window.count >= m_limits.max_orders_per_window)
+        return risk_check::RATE;
+
+    // a rejected order does not use up the budget of the orders that pass
+    risk_check result = check_limits(u, t, ord, type, replaced);
+    if (result == risk_check::PASSED)
+    {
+        window.count += 1;
+    }
+    return result;
+}
+
+auto market::risk::check_limits(const user &u, const ticker &t, const order &ord, order_type type, const order *replaced) const -> risk_check
+{
+    if (ord.volume > m_limits.max_order_volume)
+        return risk_check::ORDER_VOLUME;
+
+    // the band follows the last price, so there is nothing to check it against before the first trade
+    bool priced = type != order_type::MARKET;
+    long long last = t.get_valuation();
+    if (priced && last > 0 && std::llabs(ord.price - last) * 100 > m_limits.price_band_percent * last)
+        return risk_check::PRICE_BAND;
+
+    // exposure of the user, without the order being replaced
+    int open_orders = u.get_open_orders();
+    open_volume open = u.get_open(ord.ticker_id);
+    long long open_total = u.get_open_volume();
+    long long notional = u.get_bid_notional();
+    if (replaced != nullptr)
+    {
+        open_orders -= 1;
+        open_total -= replaced->volume;
+        if (replaced->wish == side::BID)
+        {
+            open.bid -= replaced->volume;
+            notional -= static_cast<long long>(replaced->price) * replaced->volume;
+        }
+        else
+        {
+            open.ask -= replaced->volume;
+        }
+    }
+
+    bool rests = type == order_type::LIMIT || type == order_type::POST_ONLY;
+    if (rests && open_orders >= m_limits.max_open_orders)
+        return risk_check::OPEN_ORDERS;
+
+    // the worst position on each side is reached if every open order on it fills
+    long long holding = u.get_holding(ord.ticker_id);
+    if (ord.wish == side::BID && holding + open.bid + ord.volume > m_limits.max_position)
+        return risk_check::POSITION;
+    if (ord.wish == side::ASK && holding - open.ask - ord.volume < -m_limits.max_position)
+        return risk_check::POSITION;
+
+    if (u.get_gross() + open_total + ord.volume > m_limits.max_gross_position)
+        return risk_check::GROSS_POSITION;
+
+    if (ord.wish == side::BID)
+    {
+        // a market bid is not held to the band, it pays for as much of the asks as its volume takes,
+        // and what the asks cannot fill is cancelled rather than resting
+        long long spend = priced ? static_cast<long long>(ord.price) * ord.volume : t.cost(ord);
+        if (u.get_cash() - notional - spend < -m_limits.credit_limit)
+            return risk_check::CREDIT;
+    }
+
+    return risk_check::PASSED;
+}
+
+auto market::risk::get_limits() const -> const risk_limits &
+{
+    return m_limits;
+}
+
+auto market::risk::set_limits(const risk_limits &limits) -> void
+{
+    m_limits = limits;
+}
+
+auto market::risk::current_rate(ids::user_id userid, long long now) -> rate_window &
+{
+    rate_window &window = m_rates[userid];
+    if (now - window.start >= chrono::duration_cast<chrono::nanoseconds>(m_limits.rate_window).count())
+    {
+        window = { now, 0 };
+    }
+    return window;
+}
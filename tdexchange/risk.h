@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <unordered_map>
+
+#include "id.h"
+#include "order.h"
+#include "user.h"
+#include "ticker.h"
+
+namespace market
+{
+
+using namespace std;
+
+/**
+ * @brief Limits every order is checked against before it reaches the matcher
+*/
+struct risk_limits
+{
+    // largest volume of a single order
+    int max_order_volume = 100000;
+
+    // furthest a priced order may be from the last price, in percent of it, unchecked before the first trade
+    int price_band_percent = 50;
+
+    // most resting orders per user
+    int max_open_orders = 10000;
+
+    // largest position per ticker, long or short, if every open order on that side filled
+    long long max_position = 1000000;
+
+    // largest sum of absolute positions and open order volume over all tickers
+    long long max_gross_position = 10000000;
+
+    // how far cash may go below zero, counting what open bids would spend
+    long long credit_limit = 1000000000;
+
+    // most orders per user within a rate window, only orders passing the checks are counted
+    int max_orders_per_window = 500;
+    chrono::milliseconds rate_window = chrono::milliseconds(1000);
+};
+
+// the outcome of a pre-trade check, anything but passed rejects the order
+enum class risk_check
+{
+    PASSED = 0,
+    ORDER_VOLUME = 1,
+    PRICE_BAND = 2,
+    OPEN_ORDERS = 3,
+    POSITION = 4,
+    GROSS_POSITION = 5,
+    CREDIT = 6,
+    RATE = 7
+};
+static const char *risk_check_repr[] = {
+    "passed", "order volume limit", "outside price band", "open orders limit",
+    "position limit", "gross position limit", "credit limit", "order rate limit"
+};
+
+// orders of a user that passed the checks since the window started
+struct rate_window
+{
+    // in nanoseconds since the epoch
+    long long start;
+    int count;
+};
+
+/**
+ * @brief Pre-trade risk checks
+ *
+ * Every check compares against the exposure counters kept by the user as its orders and holdings change,
+ * so an order is checked in constant time regardless of how many orders the user has open.
+*/
+class risk
+{
+protected:
+    risk_limits m_limits;
+
+    // orders counted in the current window of each user
+    unordered_map<ids::user_id, rate_window> m_rates;
+
+public:
+    risk(const risk_limits &limits = {});
+
+    /**
+     * @brief Checks an order before it is matched, counting it towards the user's order rate if it passes
+     * @param u The user placing the order
+     * @param t The ticker the order is on
+     * @param ord The order, with its total volume
+     * @param type How the order is matched
+     * @param now The clock of the exchange, in nanoseconds since the epoch
+     * @param replaced A resting order the new one replaces, whose exposure is not counted
+     * @return Passed, or the first limit the order breaks
+    */
+    auto check(const user &u, const ticker &t, const order &ord, order_type type, long long now, const order *replaced = nullptr) -> risk_check;
+
+    /**
+     * @brief Checks an order against every limit but the order rate, so a stop is checked again as it triggers
+     * @param u The user placing the order
+     * @param t The ticker the order is on
+     * @param ord The order, with its total volume
+     * @param type How the order is matched
+     * @param replaced A resting order the new one replaces, whose exposure is not counted
+     * @return Passed, or the first limit the order breaks
+    */
+    auto check_limits(const user &u, const ticker &t, const order &ord, order_type type, const order *replaced = nullptr) const -> risk_check;
+
+    auto get_limits() const -> const risk_limits &;
+    auto set_limits(const risk_limits &limits) -> void;
+
+protected:
+
+    // the rate window of a user, started anew once the last one has passed
+    auto current_rate(ids::user_id userid, long long now) -> rate_window &;
+};
+
+};
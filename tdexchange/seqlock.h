@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace network
+{
+
+// writes a value of any size behind a seqlock sequence, only ever called by the one writer
+inline auto seqlock_store(std::atomic<unsigned> &sequence, void *target, const void *value, size_t size) -> void
+{
+    unsigned current = sequence.load(std::memory_order_relaxed);
+    sequence.store(current + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(target, value, size);
+
+    sequence.store(current + 2, std::memory_order_release);
+}
+
+// copies a consistent value of any size from behind a seqlock sequence, spinning while a write is in progress
+inline auto seqlock_load(const std::atomic<unsigned> &sequence, const void *source, void *value, size_t size) -> void
+{
+    unsigned before;
+    unsigned after;
+    do
+    {
+        before = sequence.load(std::memory_order_acquire);
+        std::memcpy(value, source, size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence.load(std::memory_order_relaxed);
+    } while (before != after || (before & 1) != 0);
+}
+
+/**
+ * @brief A value written by one writer and read by any number of readers without either ever blocking
+ *
+ * The sequence is odd while a write is in progress, a reader copies the value and retries if the sequence
+ * was odd or changed meanwhile. Holds no pointers, so it may live in memory shared between processes.
+ * @tparam T A trivially copyable value
+*/
+template<typename T>
+class seqlock
+{
+    static_assert(std::is_trivially_copyable_v<T>, "a seqlock value is copied byte for byte");
+    static_assert(std::atomic<unsigned>::is_always_lock_free, "the sequence must be lock-free to be shared");
+
+protected:
+    std::atomic<unsigned> m_sequence;
+    T m_value;
+
+public:
+    seqlock()
+        : m_sequence(0), m_value()
+    {
+    }
+
+    seqlock(const seqlock &) = delete;
+    auto operator=(const seqlock &) -> seqlock & = delete;
+
+    // replaces the value, only ever called by the one writer
+    auto store(const T &value) -> void
+    {
+        seqlock_store(m_sequence, &m_value, &value, sizeof(T));
+    }
+
+    // returns a consistent copy of the value, spinning while a write is in progress
+    auto load() const -> T
+    {
+        T value;
+        seqlock_load(m_sequence, &m_value, &value, sizeof(T));
+        return value;
+    }
+
+    // returns the number of writes times two, so a reader can poll for a new value without copying it
+    auto get_sequence() const -> unsigned
+    {
+        return m_sequence.load(std::memory_order_acquire);
+    }
+};
+
+};
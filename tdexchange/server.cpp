@@ -43,11 +43,185 @@ static std::optional<json> try_parse_json(const std::string &j)
     return wrap_optional(fn);
 }
 
-network::server::server(unsigned short port)
-    : m_port(port), m_nextid(0), m_pool(8), m_ws(), m_exchange_next_transaction(0)
+/**
+ * @brief Parse the kind of an order payload
+ * @param kind One of limit, ioc, market, fok, post_only, stop or stop_limit
+ * @return The order type, if known
+*/
+static std::optional<market::order_type> parse_order_type(const std::string &kind)
+{
+    static const std::map<std::string, market::order_type> kinds = {
+        {"limit", market::order_type::LIMIT},
+        {"ioc", market::order_type::IOC},
+        {"market", market::order_type::MARKET},
+        {"fok", market::order_type::FOK},
+        {"post_only", market::order_type::POST_ONLY},
+        {"stop", market::order_type::STOP},
+        {"stop_limit", market::order_type::STOP_LIMIT}
+    };
+
+    if (!kinds.contains(kind))
+        return std::nullopt;
+
+    return kinds.at(kind);
+}
+
+static std::optional<market::self_trade> parse_self_trade(const std::string &stp)
+{
+    static const std::map<std::string, market::self_trade> modes = {
+        {"none", market::self_trade::NONE},
+        {"cancel_newest", market::self_trade::CANCEL_NEWEST},
+        {"cancel_oldest", market::self_trade::CANCEL_OLDEST},
+        {"cancel_both", market::self_trade::CANCEL_BOTH},
+        {"decrement", market::self_trade::DECREMENT}
+    };
+
+    if (!modes.contains(stp))
+        return std::nullopt;
+
+    return modes.at(stp);
+}
+
+static std::optional<market::market_phase> parse_market_phase(const std::string &phase)
+{
+    static const std::map<std::string, market::market_phase> phases = {
+        {"continuous", market::market_phase::CONTINUOUS},
+        {"batch", market::market_phase::BATCH},
+        {"call", market::market_phase::CALL}
+    };
+
+    if (!phases.contains(phase))
+        return std::nullopt;
+
+    return phases.at(phase);
+}
+
+static std::optional<market::resolution> parse_resolution(const std::string &res)
+{
+    static const std::map<std::string, market::resolution> resolutions = {
+        {"1s", market::resolution::SECOND},
+        {"1m", market::resolution::MINUTE},
+        {"5m", market::resolution::FIVE_MINUTES}
+    };
+
+    if (!resolutions.contains(res))
+        return std::nullopt;
+
+    return resolutions.at(res);
+}
+
+// admin messages are sent once a second, whatever the tick
+static const int ADMIN_MS = 1000;
+
+static std::optional<network::channel> parse_channel(const std::string &chan)
+{
+    static const std::map<std::string, network::channel> channels = {
+        {"depth", network::channel::DEPTH},
+        {"trades", network::channel::TRADES},
+        {"position", network::channel::POSITION},
+        {"admin", network::channel::ADMIN}
+    };
+
+    if (!channels.contains(chan))
+        return std::nullopt;
+
+    return channels.at(chan);
+}
+
+// the action of a shared memory request, nothing when it is misformed
+static std::optional<network::action> shm_action(const network::shm_request &request, int user)
+{
+    json ref = request.ref;
+    switch (request.kind)
+    {
+    case network::shm_request_kind::ORDER:
+        if (request.type < 0 || request.type >= static_cast<int>(std::size(market::order_type_repr))
+            || request.stp < 0 || request.stp >= static_cast<int>(std::size(market::self_trade_repr)))
+            return std::nullopt;
+
+        return network::action_order{
+            network::read_name(request.ticker), static_cast<market::order_type>(request.type), request.bid != 0,
+            request.price, request.volume, user, request.trigger, request.display, static_cast<market::self_trade>(request.stp), ref
+        };
+    case network::shm_request_kind::CANCEL:
+        return network::cancel_order{ static_cast<ids::order_id>(request.order), user, ref };
+    case network::shm_request_kind::AMEND:
+        return network::amend_order{ static_cast<ids::order_id>(request.order), request.price, request.volume, user, ref };
+    case network::shm_request_kind::MASS_CANCEL:
+        return network::mass_cancel{ user, true, ref };
+    }
+
+    return std::nullopt;
+}
+
+// the shared memory reply of an ack, nothing for replies that are not acks of a shared memory request
+static std::optional<network::shm_reply> shm_ack(const json &reply)
+{
+    static const std::map<std::string, network::shm_request_kind> kinds = {
+        {"order", network::shm_request_kind::ORDER},
+        {"cancel", network::shm_request_kind::CANCEL},
+        {"amend", network::shm_request_kind::AMEND},
+        {"mass_cancel", network::shm_request_kind::MASS_CANCEL}
+    };
+
+    if (reply.value("type", "") != "ack" || !kinds.contains(reply.value("action", "")))
+        return std::nullopt;
+
+    // acks of orders carry their status, the others have none
+    int status = -1;
+    if (reply.contains("status"))
+    {
+        const char **begin = std::begin(market::order_status_repr);
+        const char **end = std::end(market::order_status_repr);
+        const char **found = std::find(begin, end, reply["status"].get<std::string>());
+        status = found == end ? -1 : static_cast<int>(found - begin);
+    }
+
+    json ref = reply.value("ref", json());
+    return network::shm_reply{
+        kinds.at(reply.value("action", "")),
+        reply["ok"] ? 1 : 0,
+        static_cast<long long>(reply.value("order", 0ULL)),
+        status,
+        reply.value("filled", reply.value("cancelled", 0)),
+        ref.is_number_integer() ? ref.get<long long>() : 0
+    };
+}
+
+static json candle_json(const market::candle &bar)
+{
+    return {
+        {"start", bar.start},
+        {"open", bar.open},
+        {"high", bar.high},
+        {"low", bar.low},
+        {"close", bar.close},
+        {"volume", bar.volume},
+        {"vwap", bar.vwap()},
+        {"trades", bar.trades}
+    };
+}
+
+network::server::server(const server_config &config, const market::partition &part)
+    : m_port(config.port), m_ws(), m_tick_ms(config.tick_ms), m_runtime(config.runtime), m_nextid(0),
+    m_cancel_on_disconnect(config.cancel_on_disconnect), m_shm_count(config.shm_sessions), m_limits(config.outbound),
+    m_throttle_limits(config.throttles), m_throttle_disconnects(0), m_exchange(config.universe, part),
+    m_exchange_next_transaction(0), m_update_count(0), m_publisher_flag(false), m_mbo_snapshot_wanted(false),
+    m_capture_all(true), m_admintick(0), m_published_accounts(), m_pool(config.threads)
 {
 }
 
+auto network::server::replicate_to(const std::string &address, const std::string &journal) -> void
+{
+    m_replicate_address = address;
+    m_journal_path = journal;
+}
+
+auto network::server::follow(const std::string &address) -> void
+{
+    m_follow_address = address;
+}
+
 auto network::server::start() -> void
 {
     // TODO: make this shutdown gracefully
@@ -55,8 +229,57 @@ auto network::server::start() -> void
     using std::placeholders::_1;
     using std::placeholders::_2;
 
-    // start exchange in new thread
+    if (!m_follow_address.empty())
+        follow_primary();
+
+    // a backup taking over has already become the primary, with the journal of every command it applied
+    if (!m_replicate_address.empty() && m_follow_address.empty())
+    {
+        try
+        {
+            m_primary = std::make_unique<replication_primary>(m_replicate_address,
+                std::make_unique<market::journal_file>(m_journal_path));
+        }
+        catch (const std::exception &e)
+        {
+            logger::log(fmt::format("cannot replicate to {}: {}", m_replicate_address, e.what()), logger::mode::ERR);
+        }
+    }
+    m_exchange.set_journaling(m_primary != nullptr);
+
+    // a partition runs alone when the account service is unavailable, its users' cash only reflects its trades
+    const market::partition &part = m_exchange.get_partition();
+    if (part.count > 1)
+    {
+        try
+        {
+            m_settlement = std::make_unique<settlement_feed>(part.index);
+            logger::log(fmt::format("partition {} of {} settled by {}", part.index, part.count, SETTLE_NAME));
+        }
+        catch (const std::exception &e)
+        {
+            logger::log(fmt::format("cannot settle partition {}: {}", part.index, e.what()), logger::mode::ERR);
+        }
+    }
+
+    // the exchange still runs over websockets when shared memory is unavailable, partitions on one box name theirs apart
+    for (size_t i = 0; i < m_shm_count; ++i)
+    {
+        std::string name = part.count > 1 ? fmt::format("tdexchange-p{}-{:02}", part.index, i) : fmt::format("tdexchange-{:02}", i);
+        try
+        {
+            m_shm_sessions.push_back(std::make_unique<shm_session>(name));
+            logger::log(fmt::format("shared memory session {} created", name));
+        }
+        catch (const std::exception &e)
+        {
+            logger::log(fmt::format("cannot create shared memory session {}: {}", name, e.what()), logger::mode::ERR);
+        }
+    }
+
+    // start exchange in new thread, and the publisher sending what it produces in another
     std::thread exchange{ &network::server::start_exchange, this };
+    std::thread publisher{ &network::server::start_publisher, this };
 
     try {
         m_ws.init_asio();
@@ -67,10 +290,26 @@ auto network::server::start() -> void
         // disable logging
         m_ws.set_access_channels(websocketpp::log::alevel::none);
 
-        logger::log(fmt::format("server started on port {}", m_port));
+        if (m_runtime.io_core >= 0 && !pin_thread({ m_runtime.io_core }))
+            logger::log(fmt::format("cannot pin the websocket thread to core {}", m_runtime.io_core), logger::mode::WARN);
+
+        logger::log(fmt::format("server started on port {}, {}", m_port,
+            latency_profile_repr[static_cast<int>(m_runtime.profile)]));
         m_ws.listen(m_port);
         m_ws.start_accept();
-        m_ws.run();
+        if (m_runtime.profile == latency_profile::LOW_LATENCY)
+        {
+            // handlers run as soon as their socket is ready, instead of once the thread is woken
+            while (!m_ws.stopped())
+            {
+                if (m_ws.poll() == 0)
+                    cpu_relax();
+            }
+        }
+        else
+        {
+            m_ws.run();
+        }
     }
     catch (const ws::exception &ex)
     {
@@ -85,6 +324,64 @@ auto network::server::start() -> void
     stop_exchange();
     exchange.join();
     logger::log("...exchange stopped");
+
+    m_publisher_flag = true;
+    m_update_count.fetch_add(1, std::memory_order_release);
+    m_update_count.notify_one();
+    publisher.join();
+    logger::log("...publisher stopped");
+
+    m_primary.reset();
+}
+
+auto network::server::follow_primary() -> void
+{
+    // only a backup that becomes a primary needs every command kept
+    std::unique_ptr<market::journal_file> journal;
+    try
+    {
+        if (!m_replicate_address.empty())
+            journal = std::make_unique<market::journal_file>(m_journal_path);
+
+        replication_backup backup(m_follow_address, m_exchange.get_sequence());
+        logger::log(fmt::format("following the primary on {}, at sequence {}", m_follow_address, backup.get_primary_sequence()));
+
+        std::vector<market::command> commands;
+        std::vector<market::command> applied;
+        while (backup.receive(commands))
+        {
+            // commands sent twice are dropped, so the journal holds each once
+            applied.clear();
+            for (const market::command &cmd : commands)
+            {
+                if (m_exchange.apply(cmd))
+                    applied.push_back(cmd);
+            }
+            if (journal != nullptr)
+                journal->append(applied);
+
+            // nothing is published while following, connections arrive once this exchange takes over
+            m_exchange.consume_transactions();
+            m_exchange.consume_events();
+        }
+        logger::log(fmt::format("primary lost at sequence {}, taking over", m_exchange.get_sequence()), logger::mode::WARN);
+    }
+    catch (const std::exception &e)
+    {
+        logger::log(fmt::format("cannot follow the primary on {}: {}", m_follow_address, e.what()), logger::mode::ERR);
+    }
+
+    if (journal != nullptr)
+    {
+        try
+        {
+            m_primary = std::make_unique<replication_primary>(m_replicate_address, std::move(journal));
+        }
+        catch (const std::exception &e)
+        {
+            logger::log(fmt::format("cannot replicate to {}: {}", m_replicate_address, e.what()), logger::mode::ERR);
+        }
+    }
 }
 
 auto network::server::on_open(ws::connection_hdl hdl) -> void
@@ -93,6 +390,8 @@ auto network::server::on_open(ws::connection_hdl hdl) -> void
     int id = m_nextid++;
     m_connections[hdl] = id;
     m_rconnections[id] = hdl;
+    m_outbound.emplace(id, outbound_queue{ m_limits });
+    m_inbound.emplace(id, throttle{ m_throttle_limits });
     m_connection_lock.unlock();
 
     // attempt to authorize user
@@ -127,10 +426,23 @@ auto network::server::on_close(ws::connection_hdl hdl) -> void
         // we only erase the reverse user exchange id if it corresponds with the connection id,
         // otherwise leave it unchanged towards the new connection id
         int user_exchange_id = m_user_map.at(id);
-        if (m_r_user_map.at(user_exchange_id) == id)
+        if (m_r_user_map.contains(user_exchange_id) && m_r_user_map.at(user_exchange_id) == id)
+        {
             m_r_user_map.erase(user_exchange_id);
 
+            // quotes are pulled on the next tick, a reconnect only replaces the connection so it keeps them
+            if (m_disconnect_policy.at(id))
+            {
+                logger::log(fmt::format("user {} cancelling orders on disconnect", user_exchange_id));
+
+                m_action_lock.lock();
+                m_actions.emplace(mass_cancel{ user_exchange_id, false, json() });
+                m_action_lock.unlock();
+            }
+        }
+
         m_user_map.erase(id);
+        m_disconnect_policy.erase(id);
     }
     else
     {
@@ -139,13 +451,24 @@ auto network::server::on_close(ws::connection_hdl hdl) -> void
 
     m_connections.erase(hdl);
     m_rconnections.erase(id);
+    m_outbound.erase(id);
+    m_inbound.erase(id);
+
+    m_topic_connections.erase(id);
+    for (auto it = m_topics.begin(); it != m_topics.end();)
+    {
+        it->second.erase(id);
+        it = it->second.empty() ? m_topics.erase(it) : std::next(it);
+    }
+    m_mbo_subscribers.erase(id);
+    m_mbo_pending.erase(id);
+    m_candle_subscribers.erase(id);
     m_connection_lock.unlock();
 }
 
 auto network::server::on_message(ws::connection_hdl hdl, websocket::message_ptr ptr) -> void
 {
     int id = rand() % 100;
-    logger::log(fmt::format("id {}, received message {} with code {}", id, ptr->get_payload(), static_cast<int>(ptr->get_opcode())));
 
     // check if user the authorized
     m_connection_lock.lock();
@@ -156,6 +479,15 @@ auto network::server::on_message(ws::connection_hdl hdl, websocket::message_ptr
         return;
     }
 
+    // throttled messages are dropped before anything is done with them
+    if (!admit_message(m_connections.at(hdl), ptr->get_payload().size()))
+    {
+        m_connection_lock.unlock();
+        return;
+    }
+
+    logger::log(fmt::format("id {}, received message {} with code {}", id, ptr->get_payload(), static_cast<int>(ptr->get_opcode())));
+
     if (ptr->get_opcode() == ws_opcode::text)
     {
         // try parsing json
@@ -189,21 +521,43 @@ auto network::server::start_exchange() -> void
     m_exchange.user_order(market::side::BID, 2, 1, 10100, 3);
     m_exchange_lock.unlock();*/
 
-    std::default_random_engine rng;
-    int ms = 40;
+    if (m_runtime.exchange_core >= 0 && !pin_thread({ m_runtime.exchange_core }))
+        logger::log(fmt::format("cannot pin the exchange loop to core {}", m_runtime.exchange_core), logger::mode::WARN);
+
     int tickid = 0;
-    int adminclock = 1000 / ms;
-    int admintick = 0;
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
 
     while (!m_exchange_flag)
     {
-        // once a second
-        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        if (m_runtime.profile == latency_profile::LOW_LATENCY)
+        {
+            // spins to a tick after the start of the last one, a tick that overran is followed at once
+            next = std::max(next + std::chrono::milliseconds(m_tick_ms), std::chrono::steady_clock::now());
+            while (std::chrono::steady_clock::now() < next)
+            {
+                cpu_relax();
+            }
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_tick_ms));
+        }
 
         // tick
         logger::log(fmt::format("TICK {}", tickid));
         tickid++;
 
+        // replies to actions, by exchange user id, sent once the connections are locked
+        std::vector<std::pair<int, json>> replies;
+
+        // co-located sessions feed the same actions as the websocket connections, their requests wait in
+        // the ring for a later tick rather than have matching wait on the publisher holding the connections
+        if (!m_shm_sessions.empty() && m_connection_lock.try_lock())
+        {
+            poll_shm_sessions(replies);
+            m_connection_lock.unlock();
+        }
+
         // process queue
         m_action_lock.lock();
         while (!m_actions.empty())
@@ -213,22 +567,89 @@ auto network::server::start_exchange() -> void
             if (const action_order *order = std::get_if<action_order>(&act))
             {
                 // when action is to order, process the order
-                const auto &[ticker, ioc, bid, price, volume, user] = *order;
+                const auto &[ticker, type, bid, price, volume, user, trigger, display, stp, ref] = *order;
 
                 if (!m_exchange.has_ticker(ticker))
                 {
+                    replies.emplace_back(user, json{
+                        {"type", "ack"},
+                        {"action", "order"},
+                        {"ok", false},
+                        {"ref", ref},
+                        {"message", "unknown ticker"}
+                    });
                     goto next;
                 }
 
                 ids::ticker_id tickerid = m_exchange.get_ticker(ticker).get_id();
-                m_exchange.user_order(
-                    bid ? market::side::BID : market::side::ASK,
-                    user,
-                    tickerid,
-                    price,
-                    volume,
-                    ioc
-                );
+                market::side side = bid ? market::side::BID : market::side::ASK;
+                market::order_result result;
+                if (type == market::order_type::STOP || type == market::order_type::STOP_LIMIT)
+                {
+                    result = m_exchange.user_stop_order(side, user, tickerid, trigger, price, volume, type, stp);
+                }
+                else
+                {
+                    result = m_exchange.user_order(side, user, tickerid, price, volume, type, display, stp);
+                }
+
+                replies.emplace_back(user, json{
+                    {"type", "ack"},
+                    {"action", "order"},
+                    {"ok", result.status != market::order_status::REJECTED},
+                    {"order", result.id},
+                    {"status", market::order_status_repr[static_cast<int>(result.status)]},
+                    {"filled", result.filled},
+                    {"ref", ref},
+                    {"message", result.risk == market::risk_check::PASSED
+                        ? fmt::format("order {}", market::order_status_repr[static_cast<int>(result.status)])
+                        : fmt::format("order rejected, {}", market::risk_check_repr[static_cast<int>(result.risk)])}
+                });
+            }
+            else if (const cancel_order *cancel = std::get_if<cancel_order>(&act))
+            {
+                const auto &[orderid, user, ref] = *cancel;
+
+                bool ok = m_exchange.user_cancel_order(user, orderid);
+                replies.emplace_back(user, json{
+                    {"type", "ack"},
+                    {"action", "cancel"},
+                    {"ok", ok},
+                    {"order", orderid},
+                    {"ref", ref},
+                    {"message", ok ? "order cancelled" : "no such resting order"}
+                });
+            }
+            else if (const amend_order *amend = std::get_if<amend_order>(&act))
+            {
+                const auto &[orderid, price, volume, user, ref] = *amend;
+
+                bool ok = m_exchange.user_amend_order(user, orderid, price, volume);
+                replies.emplace_back(user, json{
+                    {"type", "ack"},
+                    {"action", "amend"},
+                    {"ok", ok},
+                    {"order", orderid},
+                    {"ref", ref},
+                    {"message", ok ? "order amended" : "no such resting order, or rejected"}
+                });
+            }
+            else if (const mass_cancel *cancel = std::get_if<mass_cancel>(&act))
+            {
+                const auto &[user, requested, ref] = *cancel;
+
+                int cancelled = m_exchange.user_cancel(user);
+                if (requested)
+                {
+                    replies.emplace_back(user, json{
+                        {"type", "ack"},
+                        {"action", "mass_cancel"},
+                        {"ok", true},
+                        {"cancelled", cancelled},
+                        {"ref", ref},
+                        {"message", fmt::format("cancelled {} orders", cancelled)}
+                    });
+                }
             }
             else if (const delete_order *order = std::get_if<delete_order>(&act))
             {
@@ -242,173 +663,883 @@ auto network::server::start_exchange() -> void
                 ids::ticker_id tickerid = m_exchange.get_ticker(ticker).get_id();
                 m_exchange.user_cancel_ticker(user, tickerid);
             }
-            else
+            else if (const queue_query *query = std::get_if<queue_query>(&act))
             {
-                logger::log("unknown action encountered", logger::mode::WARN);
-            }
+                const auto &[ticker, user] = *query;
 
-        next:
-            m_actions.pop();
-        }
-        m_action_lock.unlock();
+                if (!m_exchange.has_ticker(ticker))
+                {
+                    goto next;
+                }
 
+                ids::ticker_id tickerid = m_exchange.get_ticker(ticker).get_id();
+                json orders = json::array();
+                for (const market::queue_position &pos : m_exchange.user_queue_positions(user, tickerid))
+                {
+                    orders.push_back({
+                        {"order", pos.id},
+                        {"bid", pos.wish == market::side::BID},
+                        {"price", pos.price},
+                        {"volume", pos.volume},
+                        {"orders_ahead", pos.orders_ahead},
+                        {"volume_ahead", pos.volume_ahead}
+                    });
+                }
 
-        m_connection_lock.lock();
-        // preparing data to send tick updates
-        const std::map<ids::ticker_id, int> &valuations = m_exchange.get_valuations();
-        json orderbook = generate_orderbook();
-
-        // compute transactions
-        json ts = json::array();
-        const auto &transactions = m_exchange.consume_transactions();
-        for (auto it = transactions.begin(); it < transactions.end(); ++it)
-        {
-            const market::transaction &trans = *it;
-            json trans_json = {
-                {"id", trans.id},
-                {"bidder", m_exchange.get_user(trans.bidder_id).get_alias()},
-                {"asker", m_exchange.get_user(trans.asker_id).get_alias()},
-                {"bid_order", trans.bid_id},
-                {"ask_order", trans.ask_id},
-                {"ticker", m_exchange.get_ticker(trans.ticker_id).get_alias()},
-                {"aggressor_bid", trans.aggressor == market::side::BID},
-                {"price", trans.price},
-                {"volume", trans.volume}
-            };
-            ts.push_back(trans_json);
-        }
-        //m_exchange_next_transaction += (int)ts.size();
+                replies.emplace_back(user, json{
+                    {"type", "queue"},
+                    {"id", tickid},
+                    {"ticker", ticker},
+                    {"orders", orders}
+                });
+            }
+            else if (const candle_query *query = std::get_if<candle_query>(&act))
+            {
+                const auto &[ticker, res, count, user] = *query;
 
+                if (!m_exchange.has_ticker(ticker))
+                {
+                    goto next;
+                }
 
-        // randomize the user order that the ticks are sent to
-        auto kv = std::views::keys(m_user_map);
-        std::vector<int> ids{ kv.begin(), kv.end() };
-        std::shuffle(ids.begin(), ids.end(), rng);
+                json bars = json::array();
+                for (const market::candle &bar : m_exchange.get_candles().get(m_exchange.get_ticker(ticker).get_id(), res, count))
+                {
+                    bars.push_back(candle_json(bar));
+                }
 
-        // for each user, send its customized update
-        for (const auto &id : ids)
-        {
-            int userid = m_user_map.at(id);
+                replies.emplace_back(user, json{
+                    {"type", "candles"},
+                    {"id", tickid},
+                    {"ticker", ticker},
+                    {"resolution", market::resolution_repr[static_cast<int>(res)]},
+                    {"candles", bars}
+                });
+            }
+            else if (const phase_change *change = std::get_if<phase_change>(&act))
+            {
+                const auto &[ticker, phase, user, ref] = *change;
 
-            // get user holdings
-            const market::user &user = m_exchange.get_user(userid);
-            const std::map<ids::ticker_id, int> &holdings = user.get_holdings();
+                bool ok = m_exchange.get_user(user).get_admin() && m_exchange.has_ticker(ticker);
+                if (ok)
+                {
+                    m_exchange.set_phase(m_exchange.get_ticker(ticker).get_id(), phase);
+                }
 
-            json position = generate_user_position(userid);
+                replies.emplace_back(user, json{
+                    {"type", "ack"},
+                    {"action", "phase"},
+                    {"ok", ok},
+                    {"ref", ref},
+                    {"message", ok ? fmt::format("phase set to {}", market::market_phase_repr[static_cast<int>(phase)]) : "not allowed"}
+                });
+            }
+            else if (const auction_call *call = std::get_if<auction_call>(&act))
+            {
+                const auto &[ticker, user, ref] = *call;
 
-            json usr = {
-                {"wealth", user.get_assets(valuations)},
-                {"cash", user.get_cash()},
-            };
+                bool ok = m_exchange.get_user(user).get_admin() && m_exchange.has_ticker(ticker);
+                int volume = 0;
+                if (ok)
+                {
+                    volume = m_exchange.run_auction(m_exchange.get_ticker(ticker).get_id());
+                }
 
-            json payload = {
-                {"type", "tick"},
-                {"id", tickid},
-                {"position", position},
-                {"orderbook", orderbook},
-                {"user", usr},
-                {"transactions", ts}
-            };
-            send_json(payload, id);
+                replies.emplace_back(user, json{
+                    {"type", "ack"},
+                    {"action", "auction"},
+                    {"ok", ok},
+                    {"filled", volume},
+                    {"ref", ref},
+                    {"message", ok ? fmt::format("auction crossed {}", volume) : "not allowed"}
+                });
+            }
+            else
+            {
+                logger::log("unknown action encountered", logger::mode::WARN);
+            }
+
+        next:
+            m_actions.pop();
         }
 
+        // tickers in the batch phase cross everything collected during the tick at once
+        m_exchange.run_batch_auctions();
 
-        // create admin message
-        if (admintick <= 0)
-        {
-            admintick = adminclock;
-            json admin = {
-                {"type", "admin-tick"},
-                {"id", tickid},
-                {"users", json::object()}
-            };
-            for (const auto &[id, user] : m_exchange.get_users())
-            {
-                json user_json = {
-                    {"cash", user.get_cash()},
-                    {"wealth", user.get_assets(valuations)},
-                    {"holdings", generate_user_position(id)}
-                };
+        // stops deferred by a long cascade still run within the tick they were triggered
+        m_exchange.run_stops();
+        m_action_lock.unlock();
 
-                admin["users"][user.get_alias()] = user_json;
-            }
+        // backups are sent the tick's commands as its replies are published, not before
+        if (m_primary != nullptr)
+            m_primary->replicate(m_exchange.consume_journal());
 
-            // check for admin
-            for (const auto &id : ids)
-            {
-                int userid = m_user_map.at(id);
 
-                if (m_exchange.get_user(userid).get_admin())
-                {
-                    send_json(admin, id);
-                }
+        // everything published of the tick is copied out of the exchange, the publisher encodes and sends it
+        std::unique_ptr<market_update> update = capture_update(tickid, std::move(replies));
+        if (!m_updates.try_push(std::move(update)))
+        {
+            logger::log(fmt::format("publisher is {} ticks behind, matching waits for it", UPDATE_QUEUE), logger::mode::WARN);
+            while (!m_updates.try_push(std::move(update)))
+            {
+                std::this_thread::yield();
             }
         }
-        else
+        m_update_count.fetch_add(1, std::memory_order_release);
+        m_update_count.notify_one();
+    }
+}
+
+auto network::server::start_publisher() -> void
+{
+    if (m_runtime.publisher_core >= 0 && !pin_thread({ m_runtime.publisher_core }))
+        logger::log(fmt::format("cannot pin the publisher to core {}", m_runtime.publisher_core), logger::mode::WARN);
+
+    bool spin = m_runtime.profile == latency_profile::LOW_LATENCY;
+    while (true)
+    {
+        // read before the ring, so an update pushed after an empty ring still wakes us
+        unsigned long long seen = m_update_count.load(std::memory_order_acquire);
+
+        std::optional<std::unique_ptr<market_update>> update = m_updates.try_pop();
+        if (update)
         {
-            admintick -= 1;
+            m_connection_lock.lock();
+            publish(*update.value());
+            m_connection_lock.unlock();
+            continue;
         }
-        
 
-        m_connection_lock.unlock();
+        // every update is published before stopping
+        if (m_publisher_flag)
+            return;
+
+        if (spin)
+            cpu_relax();
+        else
+            m_update_count.wait(seen, std::memory_order_acquire);
     }
 }
 
-auto network::server::stop_exchange() -> void
+auto network::server::capture_update(int tickid, std::vector<std::pair<int, json>> replies) -> std::unique_ptr<market_update>
 {
-    m_exchange_flag = true;
-}
+    std::unique_ptr<market_update> update = std::make_unique<market_update>();
+    update->tickid = tickid;
+    update->replies = std::move(replies);
+    update->events = m_exchange.consume_events();
+    update->transactions = m_exchange.consume_transactions();
+    update->memory = m_exchange.get_memory_stats();
+    if (m_settlement)
+    {
+        m_settlement->settle(update->transactions, m_exchange.get_clock());
+    }
+
+    // the order by order book is only copied while a new subscriber waits for it
+    if (m_mbo_snapshot_wanted.exchange(false))
+    {
+        update->mbo_snapshot = generate_mbo_snapshot();
+    }
 
-auto network::server::generate_orderbook() const -> json
-{
-    json prices = json::object();
     for (const auto &[id, ticker] : m_exchange.get_tickers())
     {
-        market::orderbook book = ticker.get_orderbook();
-        json bids = json::array();
-        for (const auto &[price, volume] : book.bids)
+        std::optional<market::auction_price> indicative;
+        if (ticker.get_phase() != market::market_phase::CONTINUOUS)
         {
-            bids.push_back({ {"price", price}, {"volume", volume} });
+            indicative = ticker.clearing_price();
         }
-        std::sort(bids.begin(), bids.end(), [&](const auto &v1, const auto &v2)
-        {
-            return v1["price"] > v2["price"];
+
+        update->tickers.emplace(id, ticker_update{
+            ticker.get_alias(), ticker.get_orderbook(), ticker.get_valuation(), ticker.get_phase(), indicative
         });
+    }
 
-        json asks = json::array();
-        for (const auto &[price, volume] : book.asks)
+    // only the accounts trading changed are copied, the publisher keeps the others and values them itself
+    std::vector<market::user> changed = m_capture_all ? m_exchange.get_users() : m_exchange.consume_changed_users();
+    if (m_capture_all)
+    {
+        m_exchange.consume_changed_users();
+        m_capture_all = false;
+    }
+    for (const market::user &user : changed)
+    {
+        std::vector<int> holdings;
+        holdings.reserve(update->tickers.size());
+        for (const auto &[id, _] : update->tickers)
         {
-            asks.push_back({ {"price", price}, {"volume", volume} });
+            holdings.push_back(user.get_holding(id));
         }
-        std::sort(asks.begin(), asks.end(), [&](const auto &v1, const auto &v2)
-        {
-            return v1["price"] < v2["price"];
+
+        update->accounts.emplace(user.get_id(), account_update{
+            user.get_alias(), user.get_admin(), user.get_index(), user.get_cash(), 0, std::move(holdings)
         });
+    }
 
-        prices[ticker.get_alias()] = { {"bids", bids}, {"asks", asks}, {"last_price", ticker.get_valuation() } };
+    // the latest candles of every ticker that traded
+    std::set<ids::ticker_id> traded;
+    for (const market::transaction &trans : update->transactions)
+    {
+        traded.insert(trans.ticker_id);
+    }
+    for (ids::ticker_id id : traded)
+    {
+        for (size_t res = 0; res < market::RESOLUTIONS; ++res)
+        {
+            update->candles.emplace(
+                std::make_pair(update->tickers.at(id).alias, static_cast<market::resolution>(res)),
+                m_exchange.get_candles().last(id, static_cast<market::resolution>(res)).value()
+            );
+        }
     }
 
-    return prices;
+    return update;
 }
 
-auto network::server::generate_user_position(int userid) const -> json
+auto network::server::publish(const market_update &update) -> void
 {
-    json holdings_json = json::object();
+    int tickid = update.tickid;
 
-    const auto &user = m_exchange.get_user(userid);
-    const std::map<ids::ticker_id, int> &holdings = user.get_holdings();
-    for (const auto &[id, ticker] : m_exchange.get_tickers())
+    // accounts changed replace those kept, and every account sent this tick is valued at its prices
+    for (const auto &[userid, account] : update.accounts)
     {
-        int amount = 0;
-        if (holdings.contains(id))
-        {
-            amount = holdings.at(id);
-        }
-        holdings_json[ticker.get_alias()] = amount;
+        m_published_accounts.insert_or_assign(userid, account);
+    }
+    std::set<ids::user_id> valued;
+    auto value = [&](ids::user_id userid)
+    {
+        if (m_published_accounts.contains(userid) && valued.insert(userid).second)
+            value_account(update, userid, m_published_accounts.at(userid));
+    };
+    for (const auto &[_, userid] : m_user_map)
+    {
+        value(userid);
+    }
+    for (const auto &[userid, _] : m_shm_users)
+    {
+        value(userid);
+    }
+
+    for (const auto &[user, reply] : update.replies)
+    {
+        if (m_r_user_map.contains(user))
+        {
+            send_json(reply, m_r_user_map.at(user));
+        }
+        else if (m_shm_users.contains(user))
+        {
+            reply_shm(user, reply);
+        }
+    }
+
+    // co-located sessions see the book before anything is serialised for the websocket connections
+    publish_shm(update);
+
+    // market-by-order feed, new subscribers get a snapshot after this tick's events instead
+    json events = generate_mbo_events(update);
+    if (!events.empty())
+    {
+        json payload = {
+            {"type", "mbo"},
+            {"id", tickid},
+            {"events", events}
+        };
+        for (int id : std::vector<int>{ m_mbo_subscribers.begin(), m_mbo_subscribers.end() })
+        {
+            send_json(payload, id);
+        }
+    }
+
+    if (!m_mbo_pending.empty() && update.mbo_snapshot)
+    {
+        json snapshot = {
+            {"type", "mbo-snapshot"},
+            {"id", tickid},
+            {"orderbook", update.mbo_snapshot.value()}
+        };
+        for (int id : m_mbo_pending)
+        {
+            send_json(snapshot, id);
+            m_mbo_subscribers.insert(id);
+        }
+        m_mbo_pending.clear();
+    }
+
+    // preparing data to send tick updates
+    json orderbook = generate_orderbook(update);
+
+    // compute transactions
+    json ts = json::array();
+    for (const market::transaction &trans : update.transactions)
+    {
+        json trans_json = {
+            {"id", trans.id},
+            {"bidder", m_published_accounts.at(trans.bidder_id).alias},
+            {"asker", m_published_accounts.at(trans.asker_id).alias},
+            {"bid_order", trans.bid_id},
+            {"ask_order", trans.ask_id},
+            {"ticker", update.tickers.at(trans.ticker_id).alias},
+            {"aggressor_bid", trans.aggressor == market::side::BID},
+            {"price", trans.price},
+            {"volume", trans.volume},
+            {"auction", trans.auction},
+            {"time", trans.time}
+        };
+        ts.push_back(trans_json);
+    }
+    //m_exchange_next_transaction += (int)ts.size();
+
+    // the transactions of each ticker, for connections subscribed to trades by ticker
+    std::map<std::string, json> trades;
+    if (!m_topic_connections.empty())
+    {
+        for (const json &trans_json : ts)
+        {
+            json &ticker_trades = trades[trans_json["ticker"]];
+            if (ticker_trades.is_null())
+            {
+                ticker_trades = json::array();
+            }
+            ticker_trades.push_back(trans_json);
+        }
+    }
+
+    // the latest candle of every ticker that traded, serialised once for all of its subscribers
+    if (!m_candle_subscribers.empty() && !update.candles.empty())
+    {
+        std::map<std::pair<std::string, market::resolution>, std::string> updates;
+        for (const auto &[id, subscriptions] : m_candle_subscribers)
+        {
+            for (const auto &subscription : subscriptions)
+            {
+                const auto &[ticker, res] = subscription;
+                if (!update.candles.contains(subscription))
+                    continue;
+
+                if (!updates.contains(subscription))
+                {
+                    updates[subscription] = json{
+                        {"type", "candle"},
+                        {"id", tickid},
+                        {"ticker", ticker},
+                        {"resolution", market::resolution_repr[static_cast<int>(res)]},
+                        {"candle", candle_json(update.candles.at(subscription))}
+                    }.dump();
+                }
+                send_serialized(updates.at(subscription), id);
+            }
+        }
+    }
+
+
+    // randomize the user order that the ticks are sent to
+    auto kv = std::views::keys(m_user_map);
+    std::vector<int> ids{ kv.begin(), kv.end() };
+    std::shuffle(ids.begin(), ids.end(), m_publisher_rng);
+
+    // for each user, send its customized update, unless it chose its topics instead
+    for (const auto &id : ids)
+    {
+        if (m_topic_connections.contains(id))
+            continue;
+
+        // get user holdings
+        const account_update &user = m_published_accounts.at(m_user_map.at(id));
+
+        json position = generate_user_position(update, user);
+
+        json usr = {
+            {"wealth", user.wealth},
+            {"cash", user.cash},
+        };
+
+        json payload = {
+            {"type", "tick"},
+            {"id", tickid},
+            {"position", position},
+            {"orderbook", orderbook},
+            {"user", usr},
+            {"transactions", ts}
+        };
+        send_tick(std::move(payload), id);
+    }
+
+    publish_topics(update, orderbook, trades);
+
+
+    // create admin message
+    if (m_admintick <= 0)
+    {
+        m_admintick = std::max(1, ADMIN_MS / m_tick_ms);
+        json admin = {
+            {"type", "admin-tick"},
+            {"id", tickid},
+            {"users", json::object()}
+        };
+        for (auto &[userid, user] : m_published_accounts)
+        {
+            value(userid);
+            json user_json = {
+                {"cash", user.cash},
+                {"wealth", user.wealth},
+                {"holdings", generate_user_position(update, user)}
+            };
+
+            admin["users"][user.alias] = user_json;
+        }
+        admin["connections"] = generate_connection_metrics(update);
+        admin["memory"] = {
+            {"requested", market::page_backing_repr[static_cast<int>(update.memory.requested)]},
+            {"backing", market::page_backing_repr[static_cast<int>(update.memory.backing)]},
+            {"mapped_bytes", update.memory.mapped},
+            {"huge_bytes", update.memory.huge},
+            {"in_use_bytes", update.memory.in_use},
+            {"peak_bytes", update.memory.peak},
+            {"allocations", update.memory.allocations},
+            {"deallocations", update.memory.deallocations}
+        };
+        admin["throttle_disconnects"] = m_throttle_disconnects;
+        admin["penalty_box"] = json::array();
+        for (const auto &[userid, until] : m_penalty_box)
+        {
+            if (until > network::throttle_clock::now())
+            {
+                admin["penalty_box"].push_back(m_published_accounts.at(userid).alias);
+            }
+        }
+
+        // check for admin, subscribers of the admin channel only keep the latest one
+        std::string message = admin.dump();
+        for (const auto &id : ids)
+        {
+            int userid = m_user_map.at(id);
+
+            if (m_topic_connections.contains(id) || !m_published_accounts.at(userid).admin)
+                continue;
+
+            send_serialized(message, id);
+        }
+        for (int id : topic_subscribers(channel::ADMIN, ""))
+        {
+            if (m_user_map.contains(id) && m_published_accounts.at(m_user_map.at(id)).admin)
+            {
+                send_snapshot("admin", message, id);
+            }
+        }
+    }
+    else
+    {
+        m_admintick -= 1;
+    }
+
+    // retry connections whose sockets were too full to take everything earlier
+    auto outbound_ids = std::views::keys(m_outbound);
+    for (int id : std::vector<int>{ outbound_ids.begin(), outbound_ids.end() })
+    {
+        flush_user(id);
+    }
+}
+
+auto network::server::stop_exchange() -> void
+{
+    m_exchange_flag = true;
+}
+
+auto network::server::generate_orderbook(const market_update &update) const -> json
+{
+    json prices = json::object();
+    for (const auto &[id, ticker] : update.tickers)
+    {
+        const market::orderbook &book = ticker.book;
+        json bids = json::array();
+        for (const auto &[price, volume] : book.bids)
+        {
+            bids.push_back({ {"price", price}, {"volume", volume} });
+        }
+
+        json asks = json::array();
+        for (const auto &[price, volume] : book.asks)
+        {
+            asks.push_back({ {"price", price}, {"volume", volume} });
+        }
+
+        prices[ticker.alias] = {
+            {"bids", bids},
+            {"asks", asks},
+            {"last_price", ticker.last_price },
+            {"phase", market::market_phase_repr[static_cast<int>(ticker.phase)]}
+        };
+
+        // during auctions the price the book would cross at if the auction ran now
+        if (ticker.indicative)
+        {
+            prices[ticker.alias]["indicative"] = {
+                {"price", ticker.indicative->price},
+                {"volume", ticker.indicative->volume},
+                {"imbalance", ticker.indicative->imbalance}
+            };
+        }
+    }
+
+    return prices;
+}
+
+auto network::server::value_account(const market_update &update, ids::user_id userid, account_update &account) const -> void
+{
+    account.wealth = account.cash;
+    size_t index = 0;
+    for (const auto &[_, ticker] : update.tickers)
+    {
+        account.wealth += static_cast<long long>(account.holdings[index++]) * ticker.last_price;
+    }
+
+    // users hold cash and tickers over every partition, as settled so far
+    std::optional<settled_account> settled = m_settlement ? m_settlement->get_account(account.index) : std::nullopt;
+    if (!settled || settled->user != userid)
+        return;
+
+    account.cash = settled->cash;
+    account.wealth = settled->wealth;
+    index = 0;
+    for (const auto &[id, _] : update.tickers)
+    {
+        std::optional<size_t> slot = m_settlement->get_slot(id);
+        if (slot)
+            account.holdings[index] = settled->holdings[*slot];
+        index += 1;
+    }
+}
+
+auto network::server::generate_user_position(const market_update &update, const account_update &user) const -> json
+{
+    json holdings_json = json::object();
+
+    size_t index = 0;
+    for (const auto &[id, ticker] : update.tickers)
+    {
+        holdings_json[ticker.alias] = user.holdings[index++];
     }
     return holdings_json;
 }
 
+auto network::server::generate_mbo_snapshot() const -> json
+{
+    // every resting order in priority order, best prices first
+    auto level_orders = [](const market::level &orders, json &out)
+    {
+        for (const market::order &ord : orders.orders())
+        {
+            out.push_back({ {"order", ord.id}, {"price", ord.price}, {"volume", ord.volume} });
+        }
+    };
+
+    json tickers = json::object();
+    for (const auto &[id, ticker] : m_exchange.get_tickers())
+    {
+        json bids = json::array();
+        for (const auto &[price, orders] : ticker.get_bids())
+        {
+            level_orders(orders, bids);
+        }
+
+        json asks = json::array();
+        for (const auto &[price, orders] : ticker.get_asks())
+        {
+            level_orders(orders, asks);
+        }
+
+        tickers[ticker.get_alias()] = { {"sequence", ticker.get_sequence()}, {"bids", bids}, {"asks", asks} };
+    }
+
+    return tickers;
+}
+
+auto network::server::generate_mbo_events(const market_update &update) const -> json
+{
+    static const char *actions[] = { "add", "modify", "execute", "delete" };
+
+    json events_json = json::array();
+    for (const market::book_event &event : update.events)
+    {
+        events_json.push_back({
+            {"sequence", event.sequence},
+            {"action", actions[static_cast<int>(event.action)]},
+            {"order", event.order_id},
+            {"ticker", update.tickers.at(event.ticker_id).alias},
+            {"bid", event.wish == market::side::BID},
+            {"price", event.price},
+            {"volume", event.volume},
+            {"executed", event.executed}
+        });
+    }
+    return events_json;
+}
+
+auto network::server::publish_topics(const market_update &update, const json &orderbook, const std::map<std::string, json> &trades) -> void
+{
+    if (m_topic_connections.empty())
+        return;
+
+    int tickid = update.tickid;
+
+    // depth is a snapshot, a subscriber that falls behind only gets the latest book of each ticker
+    for (const auto &[ticker, book] : orderbook.items())
+    {
+        std::set<int> subscribers = topic_subscribers(channel::DEPTH, ticker);
+        if (subscribers.empty())
+            continue;
+
+        std::string message = json{
+            {"type", "depth"},
+            {"id", tickid},
+            {"ticker", ticker},
+            {"book", book}
+        }.dump();
+        for (int id : subscribers)
+        {
+            send_snapshot(fmt::format("depth:{}", ticker), message, id);
+        }
+    }
+
+    // trades are never conflated
+    for (const auto &[ticker, transactions] : trades)
+    {
+        std::set<int> subscribers = topic_subscribers(channel::TRADES, ticker);
+        if (subscribers.empty())
+            continue;
+
+        std::string message = json{
+            {"type", "trades"},
+            {"id", tickid},
+            {"ticker", ticker},
+            {"transactions", transactions}
+        }.dump();
+        for (int id : subscribers)
+        {
+            send_serialized(message, id);
+        }
+    }
+
+    // the position differs for every user, so it is serialised per subscriber
+    for (int id : topic_subscribers(channel::POSITION, ""))
+    {
+        if (!m_user_map.contains(id))
+            continue;
+
+        const account_update &user = m_published_accounts.at(m_user_map.at(id));
+
+        json payload = {
+            {"type", "position"},
+            {"id", tickid},
+            {"position", generate_user_position(update, user)},
+            {"user", {
+                {"wealth", user.wealth},
+                {"cash", user.cash}
+            }}
+        };
+        send_snapshot("position", payload.dump(), id);
+    }
+}
+
+auto network::server::topic_subscribers(channel chan, const std::string &ticker) const -> std::set<int>
+{
+    std::set<int> subscribers;
+    for (const std::string &key : { ticker, ALL_TICKERS })
+    {
+        auto it = m_topics.find({ chan, key });
+        if (it != m_topics.end())
+        {
+            subscribers.insert(it->second.begin(), it->second.end());
+        }
+    }
+    return subscribers;
+}
+
+auto network::server::poll_shm_sessions(std::vector<std::pair<int, json>> &replies) -> void
+{
+    throttle_clock::time_point now = throttle_clock::now();
+    for (const std::unique_ptr<shm_session> &session : m_shm_sessions)
+    {
+        if (std::optional<std::pair<std::string, std::string>> credentials = session->auth_request())
+        {
+            const auto &[name, passphase] = credentials.value();
+            std::optional<int> user = m_exchange.user_auth(name, passphase);
+            if (user && m_penalty_box.contains(user.value()) && m_penalty_box.at(user.value()) > now)
+            {
+                logger::log(fmt::format("session {} cannot authenticate user {} in the penalty box", session->get_name(), user.value()), logger::mode::WARN);
+                user.reset();
+            }
+
+            // a user has one login, as over websockets a new one replaces the old
+            if (session->get_user())
+            {
+                m_shm_users.erase(session->get_user().value());
+            }
+            if (user)
+            {
+                if (m_shm_users.contains(user.value()))
+                {
+                    m_shm_users.at(user.value())->revoke();
+                }
+                if (m_r_user_map.contains(user.value()))
+                {
+                    force_close_user(m_r_user_map.at(user.value()));
+                    m_r_user_map.erase(user.value());
+                }
+                m_shm_users[user.value()] = session.get();
+            }
+            session->authorize(user);
+
+            logger::log(fmt::format("session {}, user {} {}", session->get_name(), name, user ? "authorized" : "unauthorized"));
+        }
+
+        if (!session->get_user())
+            continue;
+
+        int user = session->get_user().value();
+        token_bucket &bucket = m_user_throttles.try_emplace(
+            user, m_throttle_limits.user_messages_per_second, m_throttle_limits.user_message_burst
+        ).first->second;
+
+        // requests over the user's rate wait in the ring for a later tick
+        m_action_lock.lock();
+        for (const shm_request *next = session->peek_request(); next != nullptr; next = session->peek_request())
+        {
+            if (!bucket.take(1.0, now))
+                break;
+
+            // the slot is the client's again once popped
+            shm_request request = *next;
+            session->pop_request();
+
+            std::optional<action> act = shm_action(request, user);
+            if (act)
+            {
+                m_actions.push(std::move(act.value()));
+            }
+            else
+            {
+                // only the publisher writes replies, so the rejection goes out with the other replies
+                int kind = static_cast<int>(request.kind);
+                replies.emplace_back(user, json{
+                    {"type", "ack"},
+                    {"action", kind >= 0 && kind < static_cast<int>(std::size(shm_request_kind_repr)) ? shm_request_kind_repr[kind] : "unknown"},
+                    {"ok", false},
+                    {"order", request.order},
+                    {"status", market::order_status_repr[static_cast<int>(market::order_status::REJECTED)]},
+                    {"ref", request.ref},
+                    {"message", "misformed request"}
+                });
+            }
+        }
+        m_action_lock.unlock();
+    }
+}
+
+auto network::server::publish_shm(const market_update &update) -> void
+{
+    if (m_shm_users.empty())
+        return;
+
+    // the depth is the same for every session, so it is built once
+    std::vector<shm_depth> depths;
+    for (const auto &[id, ticker] : update.tickers)
+    {
+        if (depths.size() == SHM_TICKERS)
+            break;
+
+        const market::orderbook &book = ticker.book;
+        shm_depth &depth = depths.emplace_back();
+        copy_name(depth.ticker, ticker.alias);
+        depth.tick = update.tickid;
+        depth.last_price = ticker.last_price;
+        depth.phase = static_cast<int>(ticker.phase);
+
+        depth.bid_levels = static_cast<int>(std::min(book.bids.size(), SHM_LEVELS));
+        for (int i = 0; i < depth.bid_levels; ++i)
+        {
+            depth.bids[i] = { book.bids[i].price, book.bids[i].volume };
+        }
+        depth.ask_levels = static_cast<int>(std::min(book.asks.size(), SHM_LEVELS));
+        for (int i = 0; i < depth.ask_levels; ++i)
+        {
+            depth.asks[i] = { book.asks[i].price, book.asks[i].volume };
+        }
+    }
+
+    for (const auto &[userid, session] : m_shm_users)
+    {
+        for (size_t i = 0; i < depths.size(); ++i)
+        {
+            session->publish_depth(i, depths[i]);
+        }
+        session->set_tickers(static_cast<int>(depths.size()));
+
+        const account_update &user = m_published_accounts.at(userid);
+        shm_position position{};
+        position.tick = update.tickid;
+        position.cash = user.cash;
+        position.wealth = user.wealth;
+        for (const auto &[id, ticker] : update.tickers)
+        {
+            if (position.holding_count == static_cast<int>(SHM_TICKERS))
+                break;
+
+            shm_holding &holding = position.holdings[position.holding_count];
+            copy_name(holding.ticker, ticker.alias);
+            holding.volume = user.holdings[position.holding_count++];
+        }
+        session->publish_position(position);
+    }
+}
+
+auto network::server::reply_shm(int user, const json &reply) -> void
+{
+    std::optional<shm_reply> ack = shm_ack(reply);
+    if (!ack)
+        return;
+
+    if (!m_shm_users.at(user)->push_reply(ack.value()))
+    {
+        logger::log(fmt::format("session {} is not reading its replies, dropped {} ack",
+            m_shm_users.at(user)->get_name(), shm_request_kind_repr[static_cast<int>(ack->kind)]), logger::mode::WARN);
+    }
+}
+
+auto network::server::generate_connection_metrics(const market_update &update) const -> json
+{
+    json connections = json::object();
+    for (const auto &[id, queue] : m_outbound)
+    {
+        const outbound_metrics &metrics = queue.get_metrics();
+
+        json connection = {
+            {"queued_messages", queue.get_messages()},
+            {"queued_bytes", queue.get_bytes()},
+            {"sent_messages", metrics.sent_messages},
+            {"sent_bytes", metrics.sent_bytes},
+            {"conflated", metrics.conflated},
+            {"peak_messages", metrics.peak_messages},
+            {"peak_bytes", metrics.peak_bytes},
+            {"lagging_ticks", metrics.lagging_ticks}
+        };
+        if (m_inbound.contains(id))
+        {
+            const throttle &inbound = m_inbound.at(id);
+            connection["accepted_messages"] = inbound.get_metrics().accepted_messages;
+            connection["accepted_bytes"] = inbound.get_metrics().accepted_bytes;
+            connection["rejected_messages"] = inbound.get_metrics().rejected_messages;
+            connection["rejected_bytes"] = inbound.get_metrics().rejected_bytes;
+            connection["message_tokens"] = inbound.get_message_tokens();
+        }
+        if (m_user_map.contains(id))
+        {
+            connection["user"] = m_published_accounts.at(m_user_map.at(id)).alias;
+        }
+
+        connections[std::to_string(id)] = connection;
+    }
+    return connections;
+}
+
 auto network::server::parse_payload(const json &payload, int id, int user) -> void
 {
     if (!payload.contains("type"))
@@ -417,173 +1548,597 @@ auto network::server::parse_payload(const json &payload, int id, int user) -> vo
         return;
     }
 
-    std::string type = payload["type"];
-    if (type != "auth" && !is_user_auth(user))
-    {
+    // every reply to the message itself echoes its ref, so it can be told apart from the others
+    auto reply = [&](json pl)
+    {
+        if (payload.contains("ref"))
+            pl["ref"] = payload["ref"];
+        send_json(pl, user);
+    };
+
+    std::string type = payload["type"];
+    if (type != "auth" && !is_user_auth(user))
+    {
+        json pl = {
+                {"type", "auth"},
+                {"ok", false},
+                {"message", "unauthorized action"}
+        };
+        reply(pl);
+
+        logger::log(fmt::format("id {}, unauthorized user", id));
+        return;
+    }
+
+    if (type == "auth")
+    {
+        // process the authentication
+
+        // check if the payload is well formed
+        if (!(payload.contains("name") && payload.contains("passphase")))
+        {
+            json pl = {
+                {"type", "auth"},
+                {"ok", false},
+                {"message", "misformed auth payload"}
+            };
+            reply(pl);
+
+            logger::log(fmt::format("id {}, misformed auth payload", id));
+            return;
+        }
+
+        // ignore if already authorized
+        if (is_user_auth(user))
+        {
+            json pl = {
+                {"type", "auth"},
+                {"ok", false},
+                {"message", "user already authed"}
+            };
+            reply(pl);
+
+            return;
+        }
+
+        bool ok = user_auth(user, payload["name"], payload["passphase"]);
+        if (ok)
+        {
+            m_disconnect_policy[user] = payload.value("cancel_on_disconnect", m_cancel_on_disconnect);
+
+            json pl = {
+                {"type", "auth"},
+                {"ok", true},
+                {"message", "auth success"}
+            };
+            reply(pl);
+            logger::log(fmt::format("id {}, user {} authorized", id, static_cast<std::string>(payload["name"])));
+        }
+        else
+        {
+            json pl = {
+                {"type", "auth"},
+                {"ok", false},
+                {"message", "incorrect auth details"}
+            };
+            reply(pl);
+            logger::log(fmt::format("id {}, unauthorized", id));
+        }
+    }
+    else if (type == "order")
+    {
+        // process the order
+
+        // the kind of order defaults to the legacy ioc flag
+        std::optional<market::order_type> kind;
+        if (payload.contains("kind"))
+        {
+            kind = parse_order_type(payload["kind"]);
+        }
+        else if (payload.contains("ioc"))
+        {
+            kind = payload["ioc"] ? market::order_type::IOC : market::order_type::LIMIT;
+        }
+
+        // self-trade prevention is off unless asked for
+        std::optional<market::self_trade> stp = market::self_trade::NONE;
+        if (payload.contains("stp"))
+        {
+            stp = parse_self_trade(payload["stp"]);
+        }
+
+        // check if the payload is well formed, market orders and stops need no price but stops need a trigger
+        bool unpriced = kind == market::order_type::MARKET || kind == market::order_type::STOP;
+        bool stop = kind == market::order_type::STOP || kind == market::order_type::STOP_LIMIT;
+        if (!(payload.contains("ticker")
+            && (payload.contains("price") || unpriced)
+            && (payload.contains("trigger") || !stop)
+            && payload.contains("volume")
+            && kind.has_value()
+            && stp.has_value()
+            && payload.contains("bid")))
+        {
+            json pl = {
+                {"type", "order"},
+                {"ok", false},
+                {"message", "misformed order payload"}
+            };
+            reply(pl);
+
+            logger::log(fmt::format("id {}, misformed order payload", id));
+            return;
+        }
+
+        std::string ticker = payload["ticker"];
+        int price = payload.value("price", 0);
+        int volume = payload["volume"];
+        bool bid = payload["bid"];
+        int trigger = payload.value("trigger", 0);
+        int display = payload.value("display", 0);
+        json ref = payload.value("ref", json());
+
+        m_action_lock.lock();
+        m_actions.emplace(action_order{ ticker, kind.value(), bid, price, volume, m_user_map.at(user), trigger, display, stp.value(), ref });
+        m_action_lock.unlock();
+
+
+        json pl = {
+                {"type", "order"},
+                {"ok", true},
+                {"message", "successfully queued order"}
+        };
+        reply(pl);
+
+        logger::log(fmt::format("id {}, queued order on {} with {} @ {}", id, ticker, volume, price));
+    }
+    else if (type == "mass_cancel")
+    {
+        json ref = payload.value("ref", json());
+
+        m_action_lock.lock();
+        m_actions.emplace(mass_cancel{ m_user_map.at(user), true, ref });
+        m_action_lock.unlock();
+
+        logger::log(fmt::format("id {}, queued mass cancel", id));
+    }
+    else if (type == "delete")
+    {
+        if (!payload.contains("ticker"))
+        {
+            json pl = {
+               {"type", "delete"},
+               {"ok", false},
+               {"message", "misformed delete payload"}
+            };
+            reply(pl);
+
+            logger::log(fmt::format("id {}, misformed delete payload", id));
+            return;
+        }
+
+        std::string ticker = payload["ticker"];
+
+        m_action_lock.lock();
+        m_actions.emplace(delete_order{ ticker, m_user_map.at(user) });
+        m_action_lock.unlock();
+
         json pl = {
-                {"type", "auth"},
-                {"ok", false},
-                {"message", "unauthorized action"}
+                {"type", "delete"},
+                {"ok", true},
+                {"message", "successfully queued deletion"}
         };
-        send_json(pl, user);
+        reply(pl);
 
-        logger::log(fmt::format("id {}, unauthorized user", id));
-        return;
+        logger::log(fmt::format("id {}, queued deletion on {}", id, ticker));
     }
-
-    if (type == "auth")
+    else if (type == "cancel")
     {
-        // process the authentication
-
-        // check if the payload is well formed
-        if (!(payload.contains("name") && payload.contains("passphase")))
+        if (!payload.contains("order"))
         {
             json pl = {
-                {"type", "auth"},
-                {"ok", false},
-                {"message", "misformed auth payload"}
+               {"type", "cancel"},
+               {"ok", false},
+               {"message", "misformed cancel payload"}
             };
-            send_json(pl, user);
+            reply(pl);
 
-            logger::log(fmt::format("id {}, misformed auth payload", id));
+            logger::log(fmt::format("id {}, misformed cancel payload", id));
             return;
         }
 
-        // ignore if already authorized
-        if (is_user_auth(user))
+        ids::order_id order = payload["order"];
+        json ref = payload.value("ref", json());
+
+        m_action_lock.lock();
+        m_actions.emplace(cancel_order{ order, m_user_map.at(user), ref });
+        m_action_lock.unlock();
+
+        logger::log(fmt::format("id {}, queued cancel of order {}", id, order));
+    }
+    else if (type == "amend")
+    {
+        if (!(payload.contains("order")
+            && payload.contains("price")
+            && payload.contains("volume")))
         {
             json pl = {
-                {"type", "auth"},
-                {"ok", false},
-                {"message", "user already authed"}
+               {"type", "amend"},
+               {"ok", false},
+               {"message", "misformed amend payload"}
             };
-            send_json(pl, user);
+            reply(pl);
 
+            logger::log(fmt::format("id {}, misformed amend payload", id));
             return;
         }
 
-        bool ok = user_auth(user, payload["name"], payload["passphase"]);
-        if (ok)
+        ids::order_id order = payload["order"];
+        int price = payload["price"];
+        int volume = payload["volume"];
+        json ref = payload.value("ref", json());
+
+        m_action_lock.lock();
+        m_actions.emplace(amend_order{ order, price, volume, m_user_map.at(user), ref });
+        m_action_lock.unlock();
+
+        logger::log(fmt::format("id {}, queued amend of order {} to {} @ {}", id, order, volume, price));
+    }
+    else if (type == "mbo")
+    {
+        if (!payload.contains("subscribe"))
         {
             json pl = {
-                {"type", "auth"},
-                {"ok", true},
-                {"message", "auth success"}
+               {"type", "mbo"},
+               {"ok", false},
+               {"message", "misformed mbo payload"}
             };
-            send_json(pl, user);
-            logger::log(fmt::format("id {}, user {} authorized", id, static_cast<std::string>(payload["name"])));
+            reply(pl);
+
+            logger::log(fmt::format("id {}, misformed mbo payload", id));
+            return;
         }
-        else
+
+        bool subscribe = payload["subscribe"];
+        if (subscribe && !m_mbo_subscribers.contains(user))
+        {
+            // the snapshot is taken on the next tick
+            m_mbo_pending.insert(user);
+            m_mbo_snapshot_wanted = true;
+        }
+        else if (!subscribe)
+        {
+            m_mbo_subscribers.erase(user);
+            m_mbo_pending.erase(user);
+        }
+
+        json pl = {
+                {"type", "mbo"},
+                {"ok", true},
+                {"message", subscribe ? "subscribed to mbo" : "unsubscribed from mbo"}
+        };
+        reply(pl);
+
+        logger::log(fmt::format("id {}, mbo subscription {}", id, subscribe));
+    }
+    else if (type == "queue")
+    {
+        if (!payload.contains("ticker"))
         {
             json pl = {
-                {"type", "auth"},
-                {"ok", false},
-                {"message", "incorrect auth details"}
+               {"type", "queue"},
+               {"ok", false},
+               {"message", "misformed queue payload"}
             };
-            send_json(pl, user);
-            logger::log(fmt::format("id {}, unauthorized", id));
+            reply(pl);
+
+            logger::log(fmt::format("id {}, misformed queue payload", id));
+            return;
         }
+
+        std::string ticker = payload["ticker"];
+
+        m_action_lock.lock();
+        m_actions.emplace(queue_query{ ticker, m_user_map.at(user) });
+        m_action_lock.unlock();
+
+        logger::log(fmt::format("id {}, queued queue position query on {}", id, ticker));
     }
-    else if (type == "order")
+    else if (type == "candles")
     {
-        // process the order
+        std::optional<market::resolution> res;
+        if (payload.contains("resolution"))
+        {
+            res = parse_resolution(payload["resolution"]);
+        }
 
-        // check if the payload is well formed
-        if (!(payload.contains("ticker")
-            && payload.contains("price")
-            && payload.contains("volume")
-            && payload.contains("ioc")
-            && payload.contains("bid")))
+        if (!(payload.contains("ticker") && res))
         {
             json pl = {
-                {"type", "order"},
-                {"ok", false},
-                {"message", "misformed order payload"}
+               {"type", "candles"},
+               {"ok", false},
+               {"message", "misformed candles payload"}
             };
-            send_json(pl, user);
+            reply(pl);
 
-            logger::log(fmt::format("id {}, misformed order payload", id));
+            logger::log(fmt::format("id {}, misformed candles payload", id));
             return;
         }
 
         std::string ticker = payload["ticker"];
-        int price = payload["price"];
-        int volume = payload["volume"];
-        bool ioc = payload["ioc"];
-        bool bid = payload["bid"];
+        size_t count = payload.value("count", 100);
+
+        // subscribers get the latest candle every tick their ticker trades in
+        if (payload.contains("subscribe"))
+        {
+            if (payload["subscribe"])
+            {
+                m_candle_subscribers[user].insert({ ticker, res.value() });
+            }
+            else if (m_candle_subscribers.contains(user))
+            {
+                m_candle_subscribers.at(user).erase({ ticker, res.value() });
+                if (m_candle_subscribers.at(user).empty())
+                {
+                    m_candle_subscribers.erase(user);
+                }
+            }
+        }
 
         m_action_lock.lock();
-        m_actions.emplace(action_order{ ticker, ioc, bid, price, volume, m_user_map.at(user) });
+        m_actions.emplace(candle_query{ ticker, res.value(), count, m_user_map.at(user) });
         m_action_lock.unlock();
 
+        logger::log(fmt::format("id {}, queued candles query on {} at {}", id, ticker, market::resolution_repr[static_cast<int>(res.value())]));
+    }
+    else if (type == "subscribe")
+    {
+        std::optional<channel> chan;
+        if (payload.contains("channel") && payload["channel"].is_string())
+        {
+            chan = parse_channel(payload["channel"]);
+        }
+
+        bool tickers_ok = !payload.contains("tickers") || (payload["tickers"].is_array()
+            && std::ranges::all_of(payload["tickers"], [](const json &ticker) { return ticker.is_string(); }));
+
+        if (!(chan && tickers_ok))
+        {
+            json pl = {
+               {"type", "subscribe"},
+               {"ok", false},
+               {"message", "misformed subscribe payload"}
+            };
+            reply(pl);
+
+            logger::log(fmt::format("id {}, misformed subscribe payload", id));
+            return;
+        }
+
+        // depth and trades are by ticker, every ticker unless listed, position and admin have no ticker
+        std::vector<std::string> tickers;
+        if (chan == channel::POSITION || chan == channel::ADMIN)
+        {
+            tickers.push_back("");
+        }
+        else if (payload.contains("tickers"))
+        {
+            tickers = payload["tickers"].get<std::vector<std::string>>();
+        }
+        else
+        {
+            tickers.push_back(ALL_TICKERS);
+        }
+
+        bool subscribe = payload.value("subscribe", true);
+        for (const std::string &ticker : tickers)
+        {
+            topic key{ chan.value(), ticker };
+            if (subscribe)
+            {
+                m_topics[key].insert(user);
+            }
+            else if (m_topics.contains(key))
+            {
+                m_topics.at(key).erase(user);
+                if (m_topics.at(key).empty())
+                {
+                    m_topics.erase(key);
+                }
+            }
+        }
+
+        // from the first subscription on the connection gets its topics instead of the full tick
+        m_topic_connections.insert(user);
 
         json pl = {
-                {"type", "order"},
-                {"ok", true},
-                {"message", "successfully queued order"}
+           {"type", "subscribe"},
+           {"ok", true},
+           {"channel", channel_repr[static_cast<int>(chan.value())]},
+           {"message", subscribe ? "subscribed" : "unsubscribed"}
         };
-        send_json(pl, user);
+        reply(pl);
 
-        logger::log(fmt::format("id {}, queued order on {} with {} @ {}", id, ticker, volume, price));
+        logger::log(fmt::format("id {}, {} {} on {} tickers", id, subscribe ? "subscribed to" : "unsubscribed from",
+            channel_repr[static_cast<int>(chan.value())], tickers.size()));
     }
-    else if (type == "delete")
+    else if (type == "phase")
+    {
+        std::optional<market::market_phase> phase;
+        if (payload.contains("phase"))
+        {
+            phase = parse_market_phase(payload["phase"]);
+        }
+
+        if (!(payload.contains("ticker") && phase))
+        {
+            json pl = {
+               {"type", "phase"},
+               {"ok", false},
+               {"message", "misformed phase payload"}
+            };
+            reply(pl);
+
+            logger::log(fmt::format("id {}, misformed phase payload", id));
+            return;
+        }
+
+        std::string ticker = payload["ticker"];
+        json ref = payload.value("ref", json());
+
+        // admin rights are checked against the exchange on the tick
+        m_action_lock.lock();
+        m_actions.emplace(phase_change{ ticker, phase.value(), m_user_map.at(user), ref });
+        m_action_lock.unlock();
+
+        logger::log(fmt::format("id {}, queued phase change on {}", id, ticker));
+    }
+    else if (type == "auction")
     {
         if (!payload.contains("ticker"))
         {
             json pl = {
-               {"type", "delete"},
+               {"type", "auction"},
                {"ok", false},
-               {"message", "misformed delete payload"}
+               {"message", "misformed auction payload"}
             };
-            send_json(pl, user);
+            reply(pl);
 
-            logger::log(fmt::format("id {}, misformed delete payload", id));
+            logger::log(fmt::format("id {}, misformed auction payload", id));
             return;
         }
 
         std::string ticker = payload["ticker"];
+        json ref = payload.value("ref", json());
 
         m_action_lock.lock();
-        m_actions.emplace(delete_order{ ticker, m_user_map.at(user) });
+        m_actions.emplace(auction_call{ ticker, m_user_map.at(user), ref });
         m_action_lock.unlock();
 
+        logger::log(fmt::format("id {}, queued auction on {}", id, ticker));
+    }
+    else
+    {
         json pl = {
-                {"type", "delete"},
-                {"ok", true},
-                {"message", "successfully queued deletion"}
+            {"type", "error"},
+            {"ok", false},
+            {"message", fmt::format("unknown payload type {}", type)}
         };
-        send_json(pl, user);
+        reply(pl);
 
-        logger::log(fmt::format("id {}, queued deletion on {}", id, ticker));
+        logger::log(fmt::format("id {}, unknown payload type {}", id, type));
     }
-    else
+}
+
+auto network::server::send_json(const json &message, int user) -> void
+{
+    // check if the user exists or not, dropped connections have no queue
+    if (!m_rconnections.contains(user) || !m_outbound.contains(user))
     {
-        logger::log(fmt::format("id {}, unknown payload type {}", id, static_cast<std::string>(payload["type"])));
+        logger::log(fmt::format("sending to user {} failed, no user found", user));
+        return;
     }
+
+    send_serialized(message.dump(), user);
 }
 
-auto network::server::send_json(const json &message, int user) -> void
+auto network::server::send_serialized(std::string message, int user) -> void
 {
-    // check if the user exists or not
-    if (!m_rconnections.contains(user))
+    if (!m_rconnections.contains(user) || !m_outbound.contains(user))
     {
         logger::log(fmt::format("sending to user {} failed, no user found", user));
         return;
     }
 
+    logger::log(fmt::format("queueing to user {} message {}", user, message));
+    if (!m_outbound.at(user).push(std::move(message)))
+    {
+        drop_slow_consumer(user);
+        return;
+    }
+
+    flush_user(user);
+}
+
+auto network::server::send_snapshot(const std::string &topic, std::string message, int user) -> void
+{
+    if (!m_rconnections.contains(user) || !m_outbound.contains(user))
+    {
+        logger::log(fmt::format("sending {} to user {} failed, no user found", topic, user));
+        return;
+    }
+
+    if (!m_outbound.at(user).push_snapshot(topic, std::move(message)))
+    {
+        drop_slow_consumer(user);
+        return;
+    }
+
+    flush_user(user);
+}
+
+auto network::server::send_tick(json tick, int user) -> void
+{
+    if (!m_rconnections.contains(user) || !m_outbound.contains(user))
+    {
+        logger::log(fmt::format("sending tick to user {} failed, no user found", user));
+        return;
+    }
+
+    if (!m_outbound.at(user).push_tick(std::move(tick)))
+    {
+        drop_slow_consumer(user);
+        return;
+    }
+
+    flush_user(user);
+}
+
+auto network::server::flush_user(int user) -> void
+{
+    if (!m_rconnections.contains(user) || !m_outbound.contains(user))
+        return;
+
+    outbound_queue &queue = m_outbound.at(user);
+    if (!queue.has_pending())
+        return;
+
     // if we can't send because the handle was closed before we process on_close,
     // too bad and just fail here whatever
-    try
+    ws::lib::error_code ec;
+    websocket::connection_ptr con = m_ws.get_con_from_hdl(m_rconnections.at(user), ec);
+    if (ec)
     {
-        logger::log(fmt::format("sending to user {} of message {}", user, message.dump()));
-        m_ws.send(m_rconnections.at(user), message.dump(), ws_opcode::text);
+        logger::log(fmt::format("error in sending, reason: {}", ec.message()), logger::mode::ERR);
+        return;
     }
-    catch (const std::exception &ex)
+
+    // only hand over what the socket is able to take, the rest waits in our queue
+    while (queue.has_pending() && con->get_buffered_amount() < m_limits.max_buffered)
     {
-        logger::log(fmt::format("error in sending, reason: {}", ex.what()), logger::mode::ERR);
+        m_ws.send(m_rconnections.at(user), queue.pop(), ws_opcode::text, ec);
+        if (ec)
+        {
+            logger::log(fmt::format("error in sending, reason: {}", ec.message()), logger::mode::ERR);
+            return;
+        }
     }
 }
 
+auto network::server::drop_slow_consumer(int user) -> void
+{
+    const outbound_queue &queue = m_outbound.at(user);
+    logger::log(fmt::format(
+        "dropping slow consumer {} with {} messages ({} bytes) queued, {} ticks behind",
+        user, queue.get_messages(), queue.get_bytes(), queue.get_metrics().lagging_ticks
+    ), logger::mode::WARN);
+
+    // release the queue now, nothing more is sent to this connection
+    m_outbound.erase(user);
+
+    ws::lib::error_code ec;
+    m_ws.close(m_rconnections.at(user), ws::close::status::policy_violation, "slow consumer", ec);
+}
+
 auto network::server::force_close_user(int id) -> void
 {
     m_ws.close(m_rconnections.at(id), 1000, "forced closure");
@@ -597,11 +2152,27 @@ auto network::server::user_auth(int id, const std::string &name, const std::stri
         return false;
 
     int user = value.value();
+    if (m_penalty_box.contains(user))
+    {
+        if (m_penalty_box.at(user) > throttle_clock::now())
+        {
+            logger::log(fmt::format("connection {} cannot authenticate user {} in the penalty box", id, user), logger::mode::WARN);
+            return false;
+        }
+        m_penalty_box.erase(user);
+    }
+
     if (m_r_user_map.contains(user))
     {
         // first log the current one out
         force_close_user(m_r_user_map.at(user));
     }
+    if (m_shm_users.contains(user))
+    {
+        logger::log(fmt::format("connection {} replaces the shared memory session of user {}", id, user));
+        m_shm_users.at(user)->revoke();
+        m_shm_users.erase(user);
+    }
 
     // no locking here because we've locked in parse_payload
     // TODO: this is scuffed
@@ -611,6 +2182,46 @@ auto network::server::user_auth(int id, const std::string &name, const std::stri
     return true;
 }
 
+auto network::server::admit_message(int user, size_t bytes) -> bool
+{
+    // a connection being disconnected for abuse has no throttle left
+    if (!m_inbound.contains(user))
+        return false;
+
+    throttle_clock::time_point now = throttle_clock::now();
+    throttle &inbound = m_inbound.at(user);
+
+    token_bucket *user_throttle = nullptr;
+    if (m_user_map.contains(user))
+    {
+        int exchange_user = m_user_map.at(user);
+        user_throttle = &m_user_throttles.try_emplace(
+            exchange_user, m_throttle_limits.user_messages_per_second, m_throttle_limits.user_message_burst
+        ).first->second;
+    }
+
+    if (inbound.admit(bytes, now, user_throttle))
+        return true;
+
+    if (inbound.reject(bytes, now))
+        return false;
+
+    logger::log(fmt::format("disconnecting connection {} after {} rate limited messages",
+        user, inbound.get_metrics().rejected_messages), logger::mode::WARN);
+
+    if (m_user_map.contains(user))
+    {
+        m_penalty_box[m_user_map.at(user)] = now + m_throttle_limits.penalty;
+    }
+
+    m_inbound.erase(user);
+    m_throttle_disconnects += 1;
+
+    ws::lib::error_code ec;
+    m_ws.close(m_rconnections.at(user), ws::close::status::policy_violation, "rate limited", ec);
+    return false;
+}
+
 auto network::server::is_user_auth(int user) const -> bool
 {
     return m_user_map.contains(user);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
+#include <random>
 #include <set>
 #include <string>
 #include <variant>
@@ -12,6 +14,12 @@
 #include <BS_thread_pool.hpp>
 
 #include "exchange.h"
+#include "outbound.h"
+#include "throttle.h"
+#include "shm_session.h"
+#include "replication.h"
+#include "settlement.h"
+#include "config.h"
 
 
 using websocket = websocketpp::server<websocketpp::config::asio>;
@@ -33,14 +41,149 @@ struct delete_order
 struct action_order
 {
     std::string ticker;
-    bool ioc;
+    market::order_type type;
     bool bid;
     int price;
     int volume;
     int user;
+    // last price that triggers stop orders
+    int trigger;
+    // volume shown at once by iceberg orders
+    int display;
+    // self-trade prevention
+    market::self_trade stp;
+    // client reference echoed in the ack
+    json ref;
 };
 
-using action = std::variant<action_order, delete_order>;
+struct cancel_order
+{
+    ids::order_id order;
+    int user;
+    json ref;
+};
+
+struct amend_order
+{
+    ids::order_id order;
+    int price;
+    int volume;
+    int user;
+    json ref;
+};
+
+// cancels every order of a user, on request or when it disconnects
+struct mass_cancel
+{
+    int user;
+    // whether the user asked, and is sent an ack
+    bool requested;
+    json ref;
+};
+
+struct queue_query
+{
+    std::string ticker;
+    int user;
+};
+
+// the latest candles of a ticker
+struct candle_query
+{
+    std::string ticker;
+    market::resolution res;
+    size_t count;
+    int user;
+};
+
+// admin only, moves a ticker between continuous trading and auctions
+struct phase_change
+{
+    std::string ticker;
+    market::market_phase phase;
+    int user;
+    json ref;
+};
+
+// admin only, crosses a ticker's book now, as a closing auction
+struct auction_call
+{
+    std::string ticker;
+    int user;
+    json ref;
+};
+
+// what a connection can subscribe to, depth and trades are per ticker, position and admin are not
+enum class channel
+{
+    DEPTH = 0,
+    TRADES = 1,
+    POSITION = 2,
+    ADMIN = 3
+};
+static const char *channel_repr[] = { "depth", "trades", "position", "admin" };
+
+// a channel on a ticker, on every ticker with ALL_TICKERS, or on no ticker for the position and admin channels
+using topic = std::pair<channel, std::string>;
+static const std::string ALL_TICKERS = "*";
+
+using action = std::variant<action_order, delete_order, queue_query, cancel_order, amend_order, phase_change, auction_call, mass_cancel, candle_query>;
+
+// a ticker at the end of a tick
+struct ticker_update
+{
+    std::string alias;
+    market::orderbook book;
+    int last_price;
+    market::market_phase phase;
+    // the price an auction would cross at, outside the continuous phase
+    std::optional<market::auction_price> indicative;
+};
+
+// the account of a user at the end of a tick
+struct account_update
+{
+    std::string alias;
+    bool admin;
+    // the index of the user in the accounts, and in the settled accounts
+    size_t index;
+    long long cash;
+    // valued by the publisher at the prices of the tick it publishes
+    long long wealth;
+    // holdings in the order of the tickers
+    std::vector<int> holdings;
+};
+
+/**
+ * @brief Everything published of one tick, copied out of the exchange by the matcher
+ *
+ * Immutable once handed to the publisher, which never reads the exchange itself.
+*/
+struct market_update
+{
+    int tickid;
+
+    // replies to actions, by exchange user id
+    std::vector<std::pair<int, json>> replies;
+
+    std::vector<market::book_event> events;
+    // the order by order book, only while a market-by-order subscriber waits for it
+    std::optional<json> mbo_snapshot;
+    std::vector<market::transaction> transactions;
+
+    std::map<ids::ticker_id, ticker_update> tickers;
+    // only the accounts whose cash or holdings changed, every account in the first update
+    std::map<ids::user_id, account_update> accounts;
+
+    // the latest candle at every resolution of each ticker that traded, by ticker name
+    std::map<std::pair<std::string, market::resolution>, market::candle> candles;
+
+    // the memory of the exchange, for admins
+    market::memory_stats memory;
+};
+
+// ticks the matcher may run ahead of the publisher
+constexpr size_t UPDATE_QUEUE = 64;
 
 // server representing an websocket interface with the exchange
 class server
@@ -49,9 +192,11 @@ class server
 public:
     /**
      * @brief Default constructor
-     * @param port Port to open the websocket at
+     * @param config The port, limits and universe of the exchange, those of the exchange game by default
+     * @param part The tickers this exchange owns, when they are partitioned over several processes settled
+     * by the account service
     */
-    explicit server(unsigned short port = 8080);
+    explicit server(const server_config &config = {}, const market::partition &part = {});
 
     /**
      * @brief Start the websocket at the specified port
@@ -59,6 +204,20 @@ public:
     */
     auto start() -> void;
 
+    /**
+     * @brief Streams every command of the exchange to backups once started
+     * @param address Where backups connect, host:port or the path of a unix socket
+     * @param journal The file every command is kept in, for backups joining late
+     * @return
+    */
+    auto replicate_to(const std::string &address, const std::string &journal) -> void;
+    /**
+     * @brief Follows a primary once started, applying its commands until it is lost and only then serving
+     * @param address Where the primary listens
+     * @return
+    */
+    auto follow(const std::string &address) -> void;
+
 protected:  // raw connection callbacks
     /**
      * @brief Handles when a new connection is opened, by adding it into the connection map/queue
@@ -92,8 +251,79 @@ protected:  // exchange related stuff
     */
     auto stop_exchange() -> void;
 
-    auto generate_orderbook() const -> json;
-    auto generate_user_position(int userid) const -> json;
+    /**
+     * @brief Start the publisher loop that encodes and sends the updates of the exchange loop, until the
+     * exchange loop has stopped and every update is sent
+     * @return
+    */
+    auto start_publisher() -> void;
+
+    /**
+     * @brief Applies the commands of the primary being followed until it is lost, so this exchange takes over
+     * from the last command it sent
+     * @return
+    */
+    auto follow_primary() -> void;
+
+    /**
+     * @brief Copies what is published of a tick out of the exchange, on the exchange loop
+     * @param tickid
+     * @param replies The replies to the tick's actions
+     * @return
+    */
+    auto capture_update(int tickid, std::vector<std::pair<int, json>> replies) -> std::unique_ptr<market_update>;
+
+    /**
+     * @brief Sends a tick to every connection and session, on the publisher loop with the connections locked
+     * @param update
+     * @return
+    */
+    auto publish(const market_update &update) -> void;
+
+    auto generate_orderbook(const market_update &update) const -> json;
+    /**
+     * @brief Values an account at the prices of a tick, merging in what the account service settled over every partition
+     * @param update The tick published
+     * @param userid The exchange user id of the account
+     * @param account The account kept by the publisher
+     * @return
+    */
+    auto value_account(const market_update &update, ids::user_id userid, account_update &account) const -> void;
+
+    auto generate_user_position(const market_update &update, const account_update &user) const -> json;
+    auto generate_connection_metrics(const market_update &update) const -> json;
+    auto generate_mbo_snapshot() const -> json;
+    auto generate_mbo_events(const market_update &update) const -> json;
+
+    /**
+     * @brief Sends every topic to its subscribers, serialising each topic once
+     * @param update
+     * @param orderbook The orderbook of every ticker, by ticker name
+     * @param trades This tick's transactions, by ticker name
+     * @return
+    */
+    auto publish_topics(const market_update &update, const json &orderbook, const std::map<std::string, json> &trades) -> void;
+
+    // returns the connection ids subscribed to a channel on a ticker, directly or through every ticker
+    auto topic_subscribers(channel chan, const std::string &ticker) const->std::set<int>;
+
+    /**
+     * @brief Answers the authentication requests of shared memory sessions, and queues the requests of
+     * authenticated sessions as actions, as far as their user's rate allows
+     * @param replies Gets the rejections of misformed requests
+     * @return
+    */
+    auto poll_shm_sessions(std::vector<std::pair<int, json>> &replies) -> void;
+
+    /**
+     * @brief Writes the depth of every ticker and the position of its user into each authenticated session
+     * @param update
+     * @return
+    */
+    auto publish_shm(const market_update &update) -> void;
+
+    // passes an ack to the shared memory session of an exchange user
+    auto reply_shm(int user, const json &reply) -> void;
 
 protected:  // user related stuff
     /**
@@ -128,8 +358,59 @@ protected:  // server logic
     */
     auto parse_payload(const json &payload, int id, int user) -> void;
 
+    /**
+     * @brief Queue a message that must be delivered to a connection
+     * @param message The message
+     * @param user The connection id
+     * @return
+    */
     auto send_json(const json &message, int user) -> void;
 
+    // queue a message already serialized, so one message sent to many connections is serialized once
+    auto send_serialized(std::string message, int user) -> void;
+
+    /**
+     * @brief Queue the snapshot of a topic to a connection, conflating it with any unsent one of the same topic
+     * @param topic The topic key
+     * @param message Serialized message
+     * @param user The connection id
+     * @return
+    */
+    auto send_snapshot(const std::string &topic, std::string message, int user) -> void;
+
+    /**
+     * @brief Queue a tick snapshot to a connection, conflating it with any unsent tick
+     * @param tick The tick payload
+     * @param user The connection id
+     * @return
+    */
+    auto send_tick(json tick, int user) -> void;
+
+    /**
+     * @brief Write queued messages to the connection while its socket buffer is below the limit
+     * @param user The connection id
+     * @return
+    */
+    auto flush_user(int user) -> void;
+
+    /**
+     * @brief Drop a connection that cannot keep up with its outbound queue
+     * @param user The connection id
+     * @return
+    */
+    auto drop_slow_consumer(int user) -> void;
+
+    /**
+     * @brief Admits an incoming message against the connection's and its user's rate limits, without parsing it
+     *
+     * Connections that keep sending past their limits are disconnected and their user is put in the penalty box.
+     *
+     * @param user The connection id
+     * @param bytes The size of the message
+     * @return Whether the message should be processed
+    */
+    auto admit_message(int user, size_t bytes) -> bool;
+
 protected:
     using connections = std::map<ws::connection_hdl, int, std::owner_less<ws::connection_hdl>>;
     using r_connections = std::map<int, ws::connection_hdl>;
@@ -139,6 +420,10 @@ protected:
     // port and websocket instance
     unsigned short m_port;
     websocket m_ws;
+    // time between two ticks of the exchange loop
+    int m_tick_ms;
+    // the cores of the exchange, publisher and websocket threads, and whether they spin instead of sleeping
+    runtime_config m_runtime;
 
     // the connection/user id generator
     int m_nextid;
@@ -153,6 +438,40 @@ protected:
     // mapping from connection user id to exchange user id
     user_map m_user_map;
 
+    // whether orders are pulled when a connection closes, by default and for each authenticated connection id
+    bool m_cancel_on_disconnect;
+    std::map<int, bool> m_disconnect_policy;
+
+    // connection ids receiving the market-by-order feed, and those waiting for their snapshot
+    std::set<int> m_mbo_subscribers;
+    std::set<int> m_mbo_pending;
+
+    // the ticker and resolution of the candles each connection id is sent as they change
+    std::map<int, std::set<std::pair<std::string, market::resolution>>> m_candle_subscribers;
+
+    // connection ids subscribed to each topic, and the connections that have subscribed to any topic,
+    // which are sent their topics instead of the full tick
+    std::map<topic, std::set<int>> m_topics;
+    std::set<int> m_topic_connections;
+
+    // shared memory sessions, created once serving so a backup leaves those of its primary alone,
+    // and the session of each authenticated exchange user id, guarded by the connection lock
+    size_t m_shm_count;
+    std::vector<std::unique_ptr<shm_session>> m_shm_sessions;
+    std::map<int, shm_session *> m_shm_users;
+
+    // outbound queues for each connection id, guarded by the connection lock
+    outbound_limits m_limits;
+    std::map<int, outbound_queue> m_outbound;
+
+    // inbound throttles for each connection id, and each exchange user id, guarded by the connection lock
+    throttle_limits m_throttle_limits;
+    std::map<int, throttle> m_inbound;
+    std::map<int, token_bucket> m_user_throttles;
+    // exchange user ids that cannot authenticate until the given time
+    std::map<int, throttle_clock::time_point> m_penalty_box;
+    unsigned long long m_throttle_disconnects;
+
 
     // exchange instance
     market::exchange m_exchange;
@@ -165,6 +484,31 @@ protected:
     std::queue<action> m_actions;
     std::mutex m_action_lock;
 
+    // updates from the exchange loop to the publisher loop, and their count to wait on when there are none
+    spsc_ring<std::unique_ptr<market_update>, UPDATE_QUEUE> m_updates;
+    std::atomic<unsigned long long> m_update_count;
+    std::atomic<bool> m_publisher_flag;
+    // set when a market-by-order subscriber waits for a snapshot of the book
+    std::atomic<bool> m_mbo_snapshot_wanted;
+
+    // whether the next update copies every account rather than those changed, only used by the exchange loop
+    bool m_capture_all;
+
+    // publisher loop state, the order ticks are sent in and the ticks until the next admin message
+    std::default_random_engine m_publisher_rng;
+    int m_admintick;
+    // every account as of the last update that changed it, valued as it is published
+    std::map<ids::user_id, account_update> m_published_accounts;
+
+    // where backups connect and the journal kept for them, the primary once serving, and the primary followed
+    std::string m_replicate_address;
+    std::string m_journal_path;
+    std::unique_ptr<replication_primary> m_primary;
+    std::string m_follow_address;
+
+    // the account service, settling the trades of this partition with those of the others
+    std::unique_ptr<settlement_feed> m_settlement;
+
     // task runner
     BS::thread_pool m_pool;
 };
@@ -0,0 +1,268 @@
+#include "settlement.h"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "logger.h"
+#include "exchange.h"
+#include "affinity.h"
+
+static auto round_up(size_t bytes, size_t multiple) -> size_t
+{
+    return (bytes + multiple - 1) / multiple * multiple;
+}
+
+// where the ticker slots and the records start, after the header
+static auto slots_offset() -> size_t
+{
+    return round_up(sizeof(network::settlement_segment), alignof(ids::ticker_id));
+}
+
+static auto records_offset(size_t tickers) -> size_t
+{
+    return round_up(slots_offset() + tickers * sizeof(ids::ticker_id), alignof(network::settled_record));
+}
+
+static auto record_size(size_t tickers) -> size_t
+{
+    return round_up(sizeof(network::settled_record) + tickers * sizeof(int), alignof(network::settled_record));
+}
+
+auto network::settlement_segment::size(size_t users, size_t tickers) -> size_t
+{
+    return records_offset(tickers) + users * record_size(tickers);
+}
+
+auto network::settlement_segment::slots() -> ids::ticker_id *
+{
+    return reinterpret_cast<ids::ticker_id *>(reinterpret_cast<unsigned char *>(this) + slots_offset());
+}
+
+auto network::settlement_segment::record(size_t index) -> settled_record *
+{
+    return reinterpret_cast<settled_record *>(
+        reinterpret_cast<unsigned char *>(this) + records_offset(tickers) + index * record_size(tickers));
+}
+
+auto network::settlement_segment::record(size_t index) const -> const settled_record *
+{
+    return const_cast<settlement_segment *>(this)->record(index);
+}
+
+auto network::settlement_segment::record_bytes() const -> size_t
+{
+    return sizeof(settled_totals) + tickers * sizeof(int);
+}
+
+network::settlement_feed::settlement_feed(size_t partition)
+    : m_memory(), m_segment(nullptr), m_partition(partition), m_backlog(), m_sequence(0), m_slots()
+{
+    // the header says how many users and tickers the service sized the rest for
+    {
+        shared_memory header(SETTLE_NAME, sizeof(settlement_segment), false);
+        const settlement_segment *segment = static_cast<const settlement_segment *>(header.data());
+        if (segment->magic != SETTLE_MAGIC || segment->version != SETTLE_VERSION)
+            throw std::runtime_error("the account service is another build, or still starting");
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        m_memory = std::make_unique<shared_memory>(SETTLE_NAME, settlement_segment::size(segment->users, segment->tickers), false);
+    }
+    m_segment = static_cast<settlement_segment *>(m_memory->data());
+
+    if (partition >= m_segment->partitions)
+        throw std::runtime_error(fmt::format("the account service settles {} partitions, not partition {}",
+            m_segment->partitions, partition));
+
+    for (size_t slot = 0; slot < m_segment->tickers; ++slot)
+    {
+        m_slots[m_segment->slots()[slot]] = slot;
+    }
+}
+
+auto network::settlement_feed::settle(const std::vector<market::transaction> &transactions, long long clock) -> void
+{
+    for (const market::transaction &trans : transactions)
+    {
+        m_backlog.push_back({
+            ++m_sequence, trans.time, trans.ticker_id, trans.bidder_id, trans.asker_id, trans.price, trans.volume
+        });
+    }
+
+    // a full queue holds back the watermark instead of the exchange
+    spsc_ring<settle_fill, SETTLE_QUEUE> &fills = m_segment->fills[m_partition];
+    while (!m_backlog.empty() && fills.try_push(m_backlog.front()))
+    {
+        m_backlog.pop_front();
+    }
+
+    long long watermark = m_backlog.empty() ? clock : m_backlog.front().time;
+    m_segment->watermarks[m_partition].store(watermark, std::memory_order_release);
+}
+
+auto network::settlement_feed::get_account(size_t index) const -> std::optional<settled_account>
+{
+    if (index >= m_segment->users)
+        return std::nullopt;
+
+    // the totals and holdings are copied together, as one value behind the sequence
+    const settled_record *record = m_segment->record(index);
+    std::vector<unsigned char> bytes(m_segment->record_bytes());
+    seqlock_load(record->sequence, &record->totals, bytes.data(), bytes.size());
+
+    settled_totals totals;
+    std::memcpy(&totals, bytes.data(), sizeof(totals));
+    settled_account account{ totals.user, totals.cash, totals.wealth, std::vector<int>(m_segment->tickers) };
+    std::memcpy(account.holdings.data(), bytes.data() + sizeof(totals), account.holdings.size() * sizeof(int));
+    return account;
+}
+
+auto network::settlement_feed::get_slot(ids::ticker_id ticker) const -> std::optional<size_t>
+{
+    auto it = m_slots.find(ticker);
+    if (it == m_slots.end())
+        return std::nullopt;
+    return it->second;
+}
+
+network::account_service::account_service(size_t partitions, const market::universe &config)
+    : m_memory(), m_segment(nullptr), m_partitions(partitions), m_accounts(), m_prices(), m_tickers(), m_pending(partitions),
+    m_sequences(partitions, 0), m_settled(0), m_record()
+{
+    if (partitions == 0 || partitions > SETTLE_PARTITIONS)
+        throw std::runtime_error(fmt::format("cannot settle {} partitions, at most {}", partitions, SETTLE_PARTITIONS));
+
+    // every partition starts from the same users, so their accounts start from those of an exchange
+    market::exchange initial(config);
+    m_accounts = initial.get_accounts();
+    m_prices = initial.get_valuations();
+    for (const market::ticker_spec &ticker : config.tickers)
+    {
+        m_tickers.push_back(ticker.id);
+    }
+
+    size_t size = settlement_segment::size(m_accounts.size(), m_tickers.size());
+    m_memory = std::make_unique<shared_memory>(SETTLE_NAME, size, true);
+    m_segment = new (m_memory->data()) settlement_segment();
+    m_segment->version = SETTLE_VERSION;
+    m_segment->partitions = static_cast<uint32_t>(partitions);
+    m_segment->users = static_cast<uint32_t>(m_accounts.size());
+    m_segment->tickers = static_cast<uint32_t>(m_tickers.size());
+    std::copy(m_tickers.begin(), m_tickers.end(), m_segment->slots());
+    for (size_t index = 0; index < m_accounts.size(); ++index)
+    {
+        new (m_segment->record(index)) settled_record();
+        publish(index);
+    }
+
+    // the magic is written last, a partition seeing it sees the whole layout initialised
+    std::atomic_thread_fence(std::memory_order_release);
+    m_segment->magic = SETTLE_MAGIC;
+    logger::log(fmt::format("settling {} users and {} tickers in {} kB", m_accounts.size(), m_tickers.size(), size >> 10));
+}
+
+network::account_service::~account_service()
+{
+    m_segment->magic = 0;
+    m_segment->~settlement_segment();
+}
+
+auto network::account_service::poll() -> size_t
+{
+    // watermarks are read before the fills, so every fill before them has been pushed already
+    long long watermark = std::numeric_limits<long long>::max();
+    for (size_t p = 0; p < m_partitions; ++p)
+    {
+        watermark = std::min(watermark, m_segment->watermarks[p].load(std::memory_order_acquire));
+    }
+
+    for (size_t p = 0; p < m_partitions; ++p)
+    {
+        while (std::optional<settle_fill> fill = m_segment->fills[p].try_pop())
+        {
+            // a partition restarted, or a backup that took over from it, numbers its fills from 1 again
+            if (fill->sequence != m_sequences[p] + 1)
+                logger::log(fmt::format("partition {} skipped from fill {} to {}", p, m_sequences[p], fill->sequence),
+                    logger::mode::WARN);
+            m_sequences[p] = fill->sequence;
+            m_pending[p].push_back(*fill);
+        }
+    }
+
+    // merges the partitions by time, then partition, then sequence
+    size_t applied = 0;
+    while (true)
+    {
+        std::optional<size_t> next;
+        for (size_t p = 0; p < m_partitions; ++p)
+        {
+            if (m_pending[p].empty() || m_pending[p].front().time >= watermark)
+                continue;
+            if (!next || m_pending[p].front().time < m_pending[*next].front().time)
+                next = p;
+        }
+        if (!next)
+            break;
+
+        const settle_fill &fill = m_pending[*next].front();
+        m_accounts.fill(fill.buyer, fill.ticker, fill.price, fill.volume, market::side::BID);
+        m_accounts.fill(fill.seller, fill.ticker, fill.price, fill.volume, market::side::ASK);
+        m_prices[fill.ticker] = fill.price;
+
+        m_pending[*next].pop_front();
+        applied += 1;
+    }
+
+    // a price moves the wealth of everyone holding the ticker, so every account is published
+    if (applied > 0)
+    {
+        for (size_t index = 0; index < m_accounts.size(); ++index)
+        {
+            publish(index);
+        }
+        m_settled += applied;
+        m_segment->settled.store(m_settled, std::memory_order_release);
+    }
+
+    return applied;
+}
+
+auto network::account_service::run(bool spin) -> void
+{
+    logger::log(fmt::format("settling {} partitions in {}", m_partitions, SETTLE_NAME));
+    while (true)
+    {
+        if (poll() > 0)
+            continue;
+
+        if (spin)
+            cpu_relax();
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_POLL_MS));
+    }
+}
+
+auto network::account_service::get_accounts() const -> const market::accounts &
+{
+    return m_accounts;
+}
+
+auto network::account_service::publish(size_t index) -> void
+{
+    // the totals and holdings are laid out as in the record, then written in one go
+    m_record.resize(m_segment->record_bytes());
+    settled_totals totals{ m_accounts.get_id(index), m_accounts.get_cash(index), m_accounts.get_assets(index, m_prices) };
+    std::memcpy(m_record.data(), &totals, sizeof(totals));
+    for (size_t slot = 0; slot < m_tickers.size(); ++slot)
+    {
+        int holding = m_accounts.get_position(index, m_tickers[slot]);
+        std::memcpy(m_record.data() + sizeof(totals) + slot * sizeof(int), &holding, sizeof(int));
+    }
+
+    settled_record *record = m_segment->record(index);
+    seqlock_store(record->sequence, &record->totals, m_record.data(), m_record.size());
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "seqlock.h"
+#include "spsc_ring.h"
+#include "shared_memory.h"
+#include "accounts.h"
+#include "transaction.h"
+#include "universe.h"
+
+namespace network
+{
+
+// partitions settled together, and fills in flight per partition
+constexpr size_t SETTLE_PARTITIONS = 8;
+constexpr size_t SETTLE_QUEUE = 4096;
+
+// how often the account service looks for fills
+constexpr int SETTLE_POLL_MS = 1;
+
+// the name of the shared memory of the account service
+constexpr const char *SETTLE_NAME = "tdexchange-accounts";
+
+constexpr uint64_t SETTLE_MAGIC = 0x7464787365746c31ULL;
+constexpr uint32_t SETTLE_VERSION = 2;
+
+// a trade of a partition, settled for both users
+struct settle_fill
+{
+    // numbered from 1 without gaps by each partition
+    unsigned long long sequence;
+    long long time;
+    unsigned long long ticker;
+    int buyer;
+    int seller;
+    int price;
+    int volume;
+};
+
+// the account of a user over every partition, at the index of the user in the accounts
+struct settled_account
+{
+    int user;
+    long long cash;
+    long long wealth;
+    // by ticker slot, the place of the ticker in the universe
+    std::vector<int> holdings;
+};
+
+// the cash and wealth of a settled account as shared, its holdings follow
+struct settled_totals
+{
+    int user;
+    long long cash;
+    long long wealth;
+};
+
+// the account of a user in the shared memory, written behind the sequence like a seqlock with its holdings
+struct settled_record
+{
+    std::atomic<unsigned> sequence;
+    settled_totals totals;
+    // followed by the holding of every ticker slot
+};
+static_assert(sizeof(settled_record) == offsetof(settled_record, totals) + sizeof(settled_totals),
+    "the holdings follow the totals, so they are copied in one go");
+
+/**
+ * @brief The layout of the memory shared by the account service with the partitions
+ *
+ * Each partition is the only writer of its fills and watermark, the service the only writer of the accounts.
+ * A partition raises its watermark once every fill before it has been pushed, so the service applies fills
+ * in time order over all partitions, those of the same time by partition then sequence, whatever order they
+ * arrive in. The segment is sized by the universe settled: the header is followed by the ticker id of each
+ * slot, then the record of each user with a holding per slot.
+*/
+struct settlement_segment
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t partitions;
+
+    // users and ticker slots the records after the header have room for
+    uint32_t users;
+    uint32_t tickers;
+
+    spsc_ring<settle_fill, SETTLE_QUEUE> fills[SETTLE_PARTITIONS];
+    std::atomic<long long> watermarks[SETTLE_PARTITIONS];
+
+    // the fills applied
+    std::atomic<unsigned long long> settled;
+
+    // the size of a segment settling a number of users and tickers
+    static auto size(size_t users, size_t tickers) -> size_t;
+
+    // the ticker id of every slot, and the record of a user index
+    auto slots() -> ids::ticker_id *;
+    auto record(size_t index) -> settled_record *;
+    auto record(size_t index) const -> const settled_record *;
+
+    // the bytes written behind the sequence of a record, its totals and holdings
+    auto record_bytes() const -> size_t;
+};
+
+/**
+ * @brief The partition side of settlement, pushing the trades of its exchange to the account service
+*/
+class settlement_feed
+{
+protected:
+    std::unique_ptr<shared_memory> m_memory;
+    settlement_segment *m_segment;
+    size_t m_partition;
+
+    // fills not yet taken by a full queue, and the sequence of the last one
+    std::deque<settle_fill> m_backlog;
+    unsigned long long m_sequence;
+
+    // the holdings slot of each ticker
+    std::unordered_map<ids::ticker_id, size_t> m_slots;
+
+public:
+    /**
+     * @brief Opens the memory of a running account service, sized by the service, raising exceptions when it cannot
+     * @param partition The index of this partition
+    */
+    explicit settlement_feed(size_t partition);
+
+    settlement_feed(const settlement_feed &) = delete;
+    auto operator=(const settlement_feed &) -> settlement_feed & = delete;
+
+    /**
+     * @brief Pushes the trades of a tick, only called by the exchange loop
+     * @param transactions The trades, chronologically
+     * @param clock The time no later trade is recorded before
+     * @return
+    */
+    auto settle(const std::vector<market::transaction> &transactions, long long clock) -> void;
+
+    // the settled account at a user index, or nothing before the service has written it
+    auto get_account(size_t index) const -> std::optional<settled_account>;
+
+    // the place of a ticker in the holdings of a settled account, or nothing for a ticker not settled
+    auto get_slot(ids::ticker_id ticker) const -> std::optional<size_t>;
+};
+
+/**
+ * @brief Settles the trades of every partition in one set of accounts, in the memory it shares with them
+*/
+class account_service
+{
+protected:
+    std::unique_ptr<shared_memory> m_memory;
+    settlement_segment *m_segment;
+    size_t m_partitions;
+
+    // cash and positions of every user, and the last price of every ticker, for their wealth
+    market::accounts m_accounts;
+    std::map<ids::ticker_id, int> m_prices;
+
+    // the ticker of each holdings slot, in universe order
+    std::vector<ids::ticker_id> m_tickers;
+
+    // fills taken from each partition, not yet below every watermark
+    std::vector<std::deque<settle_fill>> m_pending;
+    std::vector<unsigned long long> m_sequences;
+    unsigned long long m_settled;
+
+    // a record being published, before it is copied behind its sequence
+    std::vector<unsigned char> m_record;
+
+public:
+    /**
+     * @brief Creates the shared memory, sized for the users and tickers of the universe, raising exceptions when it cannot
+     * @param partitions The number of partitions settled
+     * @param config The universe every partition was started with
+    */
+    account_service(size_t partitions, const market::universe &config);
+    ~account_service();
+
+    account_service(const account_service &) = delete;
+    auto operator=(const account_service &) -> account_service & = delete;
+
+    /**
+     * @brief Applies every fill below the watermarks of all partitions, publishing the accounts changed
+     * @return The fills applied
+    */
+    auto poll() -> size_t;
+
+    // polls forever, sleeping when there was nothing to apply unless spinning
+    auto run(bool spin = false) -> void;
+
+    auto get_accounts() const -> const market::accounts &;
+
+protected:
+    auto publish(size_t index) -> void;
+};
+
+};
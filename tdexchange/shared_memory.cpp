@@ -0,0 +1,110 @@
+#include "shared_memory.h"
+
+#include <fmt/core.h>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+network::shared_memory::shared_memory(const std::string &name, size_t size, bool create)
+    : m_name(name), m_data(nullptr), m_size(size), m_owner(create), m_mapping(nullptr)
+{
+    // named mappings live as long as a handle to them is open, there is nothing left over to replace
+    std::string path = fmt::format("Local\\{}", name);
+    if (create)
+    {
+        unsigned long long bytes = size;
+        m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+            static_cast<DWORD>(bytes >> 32), static_cast<DWORD>(bytes), path.c_str());
+    }
+    else
+    {
+        m_mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path.c_str());
+    }
+    if (m_mapping == nullptr)
+        throw std::runtime_error(fmt::format("cannot {} shared memory {}", create ? "create" : "open", name));
+
+    m_data = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (m_data == nullptr)
+    {
+        CloseHandle(m_mapping);
+        throw std::runtime_error(fmt::format("cannot map shared memory {}", name));
+    }
+}
+
+network::shared_memory::~shared_memory()
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mapping != nullptr)
+        CloseHandle(m_mapping);
+}
+
+#else
+
+network::shared_memory::shared_memory(const std::string &name, size_t size, bool create)
+    : m_name(name), m_data(nullptr), m_size(size), m_owner(create)
+{
+    std::string path = fmt::format("/{}", name);
+    if (create)
+    {
+        // a region left over by a crashed run may have another size
+        ::shm_unlink(path.c_str());
+    }
+
+    int fd = ::shm_open(path.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR, 0600);
+    if (fd == -1)
+        throw std::runtime_error(fmt::format("cannot {} shared memory {}", create ? "create" : "open", name));
+
+    if (create && ::ftruncate(fd, static_cast<off_t>(size)) == -1)
+    {
+        ::close(fd);
+        ::shm_unlink(path.c_str());
+        throw std::runtime_error(fmt::format("cannot size shared memory {} to {} bytes", name, size));
+    }
+
+    void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        if (create)
+            ::shm_unlink(path.c_str());
+        throw std::runtime_error(fmt::format("cannot map shared memory {}", name));
+    }
+    m_data = data;
+}
+
+network::shared_memory::~shared_memory()
+{
+    if (m_data != nullptr)
+        ::munmap(m_data, m_size);
+    if (m_owner)
+        ::shm_unlink(fmt::format("/{}", m_name).c_str());
+}
+
+#endif
+
+auto network::shared_memory::data() const -> void *
+{
+    return m_data;
+}
+
+auto network::shared_memory::size() const -> size_t
+{
+    return m_size;
+}
+
+auto network::shared_memory::get_name() const -> const std::string &
+{
+    return m_name;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace network
+{
+
+/**
+ * @brief A named region of memory shared between processes, under /dev/shm on linux
+ *
+ * The creator owns the name and removes it once destroyed, processes that opened it keep their mapping.
+*/
+class shared_memory
+{
+protected:
+    std::string m_name;
+    void *m_data;
+    size_t m_size;
+    bool m_owner;
+
+#ifdef _WIN32
+    void *m_mapping;
+#endif
+
+public:
+    /**
+     * @brief Creates or opens a region and maps it read-write, raising exceptions when it cannot
+     * @param name The name of the region, without a leading slash
+     * @param size The size of the region, a created region is zero filled
+     * @param create Whether to create the region, replacing any left over by an earlier run, or open an existing one
+    */
+    shared_memory(const std::string &name, size_t size, bool create);
+    ~shared_memory();
+
+    shared_memory(const shared_memory &) = delete;
+    auto operator=(const shared_memory &) -> shared_memory & = delete;
+
+    auto data() const -> void *;
+    auto size() const -> size_t;
+    auto get_name() const -> const std::string &;
+};
+
+};
@@ -0,0 +1,87 @@
+#include "shm_session.h"
+
+#include <cstring>
+#include <new>
+
+network::shm_session::shm_session(const std::string &name)
+    : m_memory(std::make_unique<shared_memory>(name, sizeof(shm_segment), true)), m_segment(nullptr), m_user()
+{
+    m_segment = new (m_memory->data()) shm_segment();
+    m_segment->version = SHM_VERSION;
+
+    // the magic is written last, a client seeing it sees the whole layout initialised
+    std::atomic_thread_fence(std::memory_order_release);
+    m_segment->magic = SHM_MAGIC;
+}
+
+network::shm_session::~shm_session()
+{
+    // clients still mapping the memory see the session is gone
+    m_segment->magic = 0;
+    m_segment->~shm_segment();
+}
+
+auto network::shm_session::auth_request() const -> std::optional<std::pair<std::string, std::string>>
+{
+    if (m_segment->state.load(std::memory_order_acquire) != static_cast<uint32_t>(shm_state::REQUESTED))
+        return std::nullopt;
+
+    return std::make_pair(read_name(m_segment->name), read_name(m_segment->passphase));
+}
+
+auto network::shm_session::authorize(std::optional<int> user) -> void
+{
+    std::memset(m_segment->passphase, 0, sizeof(m_segment->passphase));
+
+    m_user = user;
+    m_segment->state.store(static_cast<uint32_t>(user ? shm_state::AUTHED : shm_state::REJECTED), std::memory_order_release);
+}
+
+auto network::shm_session::revoke() -> void
+{
+    m_user.reset();
+    m_segment->state.store(static_cast<uint32_t>(shm_state::REJECTED), std::memory_order_release);
+}
+
+auto network::shm_session::peek_request() const -> const shm_request *
+{
+    if (!m_user)
+        return nullptr;
+
+    return m_segment->requests.front();
+}
+
+auto network::shm_session::pop_request() -> void
+{
+    m_segment->requests.try_pop();
+}
+
+auto network::shm_session::push_reply(const shm_reply &reply) -> bool
+{
+    return m_segment->replies.try_push(reply);
+}
+
+auto network::shm_session::publish_depth(size_t index, const shm_depth &depth) -> void
+{
+    m_segment->depth[index].store(depth);
+}
+
+auto network::shm_session::set_tickers(int tickers) -> void
+{
+    m_segment->tickers.store(tickers, std::memory_order_release);
+}
+
+auto network::shm_session::publish_position(const shm_position &position) -> void
+{
+    m_segment->position.store(position);
+}
+
+auto network::shm_session::get_user() const -> std::optional<int>
+{
+    return m_user;
+}
+
+auto network::shm_session::get_name() const -> const std::string &
+{
+    return m_memory->get_name();
+}
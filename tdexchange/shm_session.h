@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <cstdint>
+
+#include "seqlock.h"
+#include "spsc_ring.h"
+#include "shared_memory.h"
+
+namespace network
+{
+
+// tickers published to a session, levels published per side, and requests or replies in flight
+constexpr size_t SHM_TICKERS = 16;
+constexpr size_t SHM_LEVELS = 32;
+constexpr size_t SHM_QUEUE = 1024;
+
+// fixed size strings, always null terminated
+constexpr size_t SHM_NAME = 32;
+constexpr size_t SHM_CREDENTIAL = 64;
+
+// marks an initialised segment, a client checks it and the version before using the layout
+constexpr uint64_t SHM_MAGIC = 0x7464786368736d31ULL;
+constexpr uint32_t SHM_VERSION = 1;
+
+// where the authentication of a session stands, written by the client to request and by the exchange to answer
+enum class shm_state : uint32_t
+{
+    EMPTY = 0,
+    REQUESTED = 1,
+    AUTHED = 2,
+    REJECTED = 3
+};
+static const char *shm_state_repr[] = { "empty", "requested", "authed", "rejected" };
+
+struct shm_level
+{
+    int price;
+    int volume;
+};
+
+// the book of one ticker, best levels first
+struct shm_depth
+{
+    char ticker[SHM_NAME];
+    int tick;
+    int last_price;
+    // market_phase
+    int phase;
+
+    int bid_levels;
+    int ask_levels;
+    shm_level bids[SHM_LEVELS];
+    shm_level asks[SHM_LEVELS];
+};
+
+struct shm_holding
+{
+    char ticker[SHM_NAME];
+    int volume;
+};
+
+// the account of the authenticated user
+struct shm_position
+{
+    int tick;
+    long long cash;
+    long long wealth;
+
+    int holding_count;
+    shm_holding holdings[SHM_TICKERS];
+};
+
+enum class shm_request_kind : int
+{
+    ORDER = 0,
+    CANCEL = 1,
+    AMEND = 2,
+    MASS_CANCEL = 3
+};
+static const char *shm_request_kind_repr[] = { "order", "cancel", "amend", "mass_cancel" };
+
+// a request from the client, the fields a kind does not use are ignored
+struct shm_request
+{
+    shm_request_kind kind;
+    char ticker[SHM_NAME];
+    // order_type and self_trade
+    int type;
+    int stp;
+    int bid;
+    int price;
+    int volume;
+    int trigger;
+    int display;
+    // the order cancelled or amended
+    long long order;
+    // echoed in the reply
+    long long ref;
+};
+
+// the ack of a request, as sent to websocket connections
+struct shm_reply
+{
+    shm_request_kind kind;
+    int ok;
+    long long order;
+    // order_status of orders
+    int status;
+    int filled;
+    long long ref;
+};
+
+/**
+ * @brief The layout of the memory shared with one co-located client
+ *
+ * The exchange is the only writer of the snapshots and the replies, the client the only writer of the
+ * credentials and the requests. The client authenticates by writing its name and passphase, then setting
+ * the state to REQUESTED, the exchange answers by setting it to AUTHED or REJECTED on its next tick.
+*/
+struct shm_segment
+{
+    uint64_t magic;
+    uint32_t version;
+
+    std::atomic<uint32_t> state;
+    char name[SHM_CREDENTIAL];
+    char passphase[SHM_CREDENTIAL];
+
+    // tickers in the depth array
+    std::atomic<int> tickers;
+    seqlock<shm_depth> depth[SHM_TICKERS];
+    seqlock<shm_position> position;
+
+    // client to exchange, and exchange to client
+    spsc_ring<shm_request, SHM_QUEUE> requests;
+    spsc_ring<shm_reply, SHM_QUEUE> replies;
+};
+
+/**
+ * @brief The exchange side of a shared memory session with a co-located client
+*/
+class shm_session
+{
+protected:
+    std::unique_ptr<shared_memory> m_memory;
+    shm_segment *m_segment;
+
+    // the exchange user id once authenticated
+    std::optional<int> m_user;
+
+public:
+    /**
+     * @brief Creates the shared memory of a session, raising exceptions when it cannot
+     * @param name The name of the shared memory
+    */
+    explicit shm_session(const std::string &name);
+    ~shm_session();
+
+    shm_session(const shm_session &) = delete;
+    auto operator=(const shm_session &) -> shm_session & = delete;
+
+    // returns the credentials of a pending authentication
+    auto auth_request() const->std::optional<std::pair<std::string, std::string>>;
+
+    /**
+     * @brief Answers the authentication, clearing the passphase from the shared memory
+     * @param user The exchange user id, or nothing when rejected
+     * @return
+    */
+    auto authorize(std::optional<int> user) -> void;
+
+    // revokes the session, when its user authenticates elsewhere
+    auto revoke() -> void;
+
+    // returns the next request without removing it, only for an authenticated session
+    auto peek_request() const -> const shm_request *;
+    auto pop_request() -> void;
+
+    // returns false if the client is not draining its replies and this one was dropped
+    auto push_reply(const shm_reply &reply) -> bool;
+
+    auto publish_depth(size_t index, const shm_depth &depth) -> void;
+    auto set_tickers(int tickers) -> void;
+    auto publish_position(const shm_position &position) -> void;
+
+    auto get_user() const -> std::optional<int>;
+    auto get_name() const -> const std::string &;
+};
+
+// copies a string into a fixed size field, truncated to fit
+template<size_t N>
+auto copy_name(char (&field)[N], const std::string &value) -> void
+{
+    size_t size = std::min(value.size(), N - 1);
+    value.copy(field, size);
+    field[size] = '\0';
+}
+
+// reads a fixed size field the other side may not have terminated
+template<size_t N>
+auto read_name(const char (&field)[N]) -> std::string
+{
+    size_t size = 0;
+    while (size < N && field[size] != '\0')
+        size++;
+    return std::string(field, size);
+}
+
+};
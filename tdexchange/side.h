@@ -1,5 +1,8 @@
 #pragma once
 
+#include <functional>
+#include <type_traits>
+
 namespace market
 {
 
@@ -10,4 +13,50 @@ enum class side
 };
 static const char *side_repr[] = { "BID", "ASK" };  // macro string
 
-}
\ No newline at end of file
+// returns the other side
+constexpr auto opposite(side wish) -> side
+{
+    return wish == side::BID ? side::ASK : side::BID;
+}
+
+/**
+ * @brief What differs between the two sides of an order book, so each algorithm is written once over a side
+ *
+ * Levels of a side are ordered best price first by its comparator, the highest bid and the lowest ask.
+*/
+template<side S>
+struct side_traits
+{
+    static constexpr side wish = S;
+    static constexpr side opposite = market::opposite(S);
+
+    // orders prices best first
+    using compare = std::conditional_t<S == side::BID, std::greater<int>, std::less<int>>;
+
+    // returns whether a price is strictly better than another for an order on this side
+    static constexpr auto better(int price, int other) -> bool
+    {
+        return compare{}(price, other);
+    }
+
+    // returns whether a price is at least as good as a limit, so an order resting at it trades with an order at the limit
+    static constexpr auto reaches(int price, int limit) -> bool
+    {
+        return !better(limit, price);
+    }
+
+    // picks the bid, then the ask, of an order on this side and one on the opposite side
+    template<typename T>
+    static constexpr auto bid(const T &own, const T &other) -> const T &
+    {
+        return S == side::BID ? own : other;
+    }
+
+    template<typename T>
+    static constexpr auto ask(const T &own, const T &other) -> const T &
+    {
+        return S == side::BID ? other : own;
+    }
+};
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+namespace network
+{
+
+// keeps the producer and consumer counters on separate cache lines
+constexpr size_t CACHE_LINE = 64;
+
+/**
+ * @brief A bounded lock-free queue between exactly one producer thread and one consumer thread
+ *
+ * Holds no pointers, so a ring of trivially copyable values may live in memory shared between processes.
+ * @tparam T The queued values
+ * @tparam N The capacity, a power of two
+*/
+template<typename T, size_t N>
+class spsc_ring
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "the capacity of a ring is a power of two");
+    static_assert(std::atomic<size_t>::is_always_lock_free, "ring counters must be lock-free to be shared");
+
+protected:
+    // next slot read, only written by the consumer
+    alignas(CACHE_LINE) std::atomic<size_t> m_head;
+    // next slot written, only written by the producer
+    alignas(CACHE_LINE) std::atomic<size_t> m_tail;
+
+    alignas(CACHE_LINE) T m_slots[N];
+
+public:
+    spsc_ring()
+        : m_head(0), m_tail(0), m_slots()
+    {
+    }
+
+    spsc_ring(const spsc_ring &) = delete;
+    auto operator=(const spsc_ring &) -> spsc_ring & = delete;
+
+    /**
+     * @brief Appends a value, only called by the producer
+     * @param value
+     * @return False if the ring is full, leaving the value untouched
+    */
+    auto try_push(T &&value) -> bool
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == N)
+            return false;
+
+        m_slots[tail & (N - 1)] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    auto try_push(const T &value) -> bool
+    {
+        T copy = value;
+        return try_push(std::move(copy));
+    }
+
+    // removes the oldest value, only called by the consumer, returns nothing when the ring is empty
+    auto try_pop() -> std::optional<T>
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return std::nullopt;
+
+        std::optional<T> value = std::move(m_slots[head & (N - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    // returns the oldest value without removing it, only called by the consumer
+    auto front() const -> const T *
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return nullptr;
+
+        return &m_slots[head & (N - 1)];
+    }
+
+    // values queued, exact only from the producer or consumer thread
+    auto size() const -> size_t
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    auto empty() const -> bool
+    {
+        return size() == 0;
+    }
+
+    static constexpr auto capacity() -> size_t
+    {
+        return N;
+    }
+};
+
+};
@@ -0,0 +1,76 @@
+#include "throttle.h"
+
+#include <algorithm>
+
+network::token_bucket::token_bucket(double rate, double burst)
+    : m_rate(rate), m_burst(burst), m_tokens(burst), m_last(throttle_clock::now())
+{
+}
+
+auto network::token_bucket::take(double cost, throttle_clock::time_point now) -> bool
+{
+    refill(now);
+    if (m_tokens < cost)
+        return false;
+
+    m_tokens -= cost;
+    return true;
+}
+
+auto network::token_bucket::get_tokens() const -> double
+{
+    return m_tokens;
+}
+
+auto network::token_bucket::refill(throttle_clock::time_point now) -> void
+{
+    if (now <= m_last)
+        return;
+
+    std::chrono::duration<double> elapsed = now - m_last;
+    m_tokens = std::min(m_burst, m_tokens + elapsed.count() * m_rate);
+    m_last = now;
+}
+
+network::throttle::throttle(const throttle_limits &limits)
+    : m_messages(limits.messages_per_second, limits.message_burst),
+    m_bytes(limits.bytes_per_second, limits.byte_burst),
+    m_violations(limits.violations_per_second, limits.violation_burst),
+    m_metrics()
+{
+}
+
+auto network::throttle::admit(size_t bytes, throttle_clock::time_point now, token_bucket *user) -> bool
+{
+    // a rejected message still counts against the message rate, and one larger than the byte burst is never admitted
+    if (!m_messages.take(1, now))
+        return false;
+
+    if (!m_bytes.take(static_cast<double>(bytes), now))
+        return false;
+
+    if (user != nullptr && !user->take(1, now))
+        return false;
+
+    m_metrics.accepted_messages += 1;
+    m_metrics.accepted_bytes += bytes;
+    return true;
+}
+
+auto network::throttle::reject(size_t bytes, throttle_clock::time_point now) -> bool
+{
+    m_metrics.rejected_messages += 1;
+    m_metrics.rejected_bytes += bytes;
+
+    return m_violations.take(1, now);
+}
+
+auto network::throttle::get_metrics() const -> const throttle_metrics &
+{
+    return m_metrics;
+}
+
+auto network::throttle::get_message_tokens() const -> double
+{
+    return m_messages.get_tokens();
+}
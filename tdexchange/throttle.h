@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace network
+{
+
+using throttle_clock = std::chrono::steady_clock;
+
+/**
+ * @brief Limits on how fast a client may send messages, checked before a message is parsed
+*/
+struct throttle_limits
+{
+    // messages and bytes per second for each connection, with the burst allowed above that rate
+    double messages_per_second = 50;
+    double message_burst = 100;
+    double bytes_per_second = 64 * 1024;
+    double byte_burst = 256 * 1024;
+
+    // messages per second for each user, over all of their connections
+    double user_messages_per_second = 100;
+    double user_message_burst = 200;
+
+    // rejected messages tolerated per second and in a burst, before the connection is disconnected
+    double violations_per_second = 10;
+    double violation_burst = 50;
+
+    // how long a disconnected user cannot authenticate again
+    std::chrono::seconds penalty = std::chrono::seconds(10);
+};
+
+// counters kept for each connection
+struct throttle_metrics
+{
+    unsigned long long accepted_messages = 0;
+    unsigned long long accepted_bytes = 0;
+    unsigned long long rejected_messages = 0;
+    unsigned long long rejected_bytes = 0;
+};
+
+/**
+ * @brief A token bucket, refilled continuously at a rate up to its burst
+*/
+class token_bucket
+{
+protected:
+    double m_rate;
+    double m_burst;
+    double m_tokens;
+    throttle_clock::time_point m_last;
+
+public:
+    token_bucket(double rate, double burst);
+
+    /**
+     * @brief Takes tokens if there are enough, a bucket starts full
+     * @param cost Tokens to take
+     * @param now The current time
+     * @return Whether the tokens were taken
+    */
+    auto take(double cost, throttle_clock::time_point now) -> bool;
+
+    auto get_tokens() const -> double;
+
+protected:
+    auto refill(throttle_clock::time_point now) -> void;
+};
+
+/**
+ * @brief The inbound throttle of a connection, by message count and size
+*/
+class throttle
+{
+protected:
+    token_bucket m_messages;
+    token_bucket m_bytes;
+    token_bucket m_violations;
+    throttle_metrics m_metrics;
+
+public:
+    explicit throttle(const throttle_limits &limits);
+
+    /**
+     * @brief Admits a message of a given size if the connection is within its rate
+     * @param bytes The size of the message
+     * @param now The current time
+     * @param user The bucket of the connection's user, if authenticated
+     * @return Whether the message is admitted
+    */
+    auto admit(size_t bytes, throttle_clock::time_point now, token_bucket *user = nullptr) -> bool;
+
+    /**
+     * @brief Records a rejected message
+     * @param bytes The size of the message
+     * @param now The current time
+     * @return Whether the connection is still within its violation allowance, otherwise it should be disconnected
+    */
+    auto reject(size_t bytes, throttle_clock::time_point now) -> bool;
+
+    auto get_metrics() const -> const throttle_metrics &;
+    auto get_message_tokens() const -> double;
+};
+
+}
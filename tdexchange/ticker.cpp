@@ -5,177 +5,785 @@
 #include <cassert>
 #include <string>
 #include <set>
+#include <algorithm>
 
 market::ticker::ticker()
+    : m_bid_depth(side::BID), m_ask_depth(side::ASK)
 {
     throw std::runtime_error("not implemented");
 }
 
-market::ticker::ticker(string name, ids::ticker_id id)
-    : m_alias(name), m_id(id), m_asks(), m_bids(), m_valuation(0)
+market::ticker::ticker(string name, ids::ticker_id id, allocation policy, int tick_size, pmr::memory_resource *resource)
+    : m_alias(name), m_id(id), m_asks(resource), m_bids(resource), m_bid_depth(side::BID), m_ask_depth(side::ASK), m_valuation(0), m_phase(market_phase::CONTINUOUS), m_allocation(policy),
+    m_tick_size(tick_size), m_buy_stops(resource), m_sell_stops(resource), m_stop_index(resource), m_triggered(resource), m_events(), m_sequence(0)
 {
+    assert(tick_size > 0);
 }
 
-auto market::ticker::match(const order &aggressor, id_system<ids::transaction_id> &id) const->vector<transaction>
+auto market::ticker::reserve(size_t levels, size_t orders) -> void
+{
+    m_bid_depth.reserve(levels);
+    m_ask_depth.reserve(levels);
+    m_stop_index.reserve(orders);
+}
+
+// share of the incoming volume a size-time level gives in time priority, the rest is pro-rata
+static const int SIZE_TIME_FIFO_PERCENT = 40;
+
+auto market::ticker::match(const order &aggressor, id_system<ids::transaction_id> &id) -> match_result
 {
     logger::log(fmt::format("matching ticker {}", m_alias));
 
-    vector<transaction> transactions;
+    // the policy is picked once per order, each matching loop is compiled for its policy
+    switch (m_allocation)
+    {
+    case allocation::PRO_RATA:
+        return match<allocation::PRO_RATA>(aggressor, id);
+    case allocation::PRO_RATA_TOP:
+        return match<allocation::PRO_RATA_TOP>(aggressor, id);
+    case allocation::SIZE_TIME:
+        return match<allocation::SIZE_TIME>(aggressor, id);
+    default:
+        return match<allocation::FIFO>(aggressor, id);
+    }
+}
+
+template<market::allocation policy>
+auto market::ticker::match(const order &aggressor, id_system<ids::transaction_id> &id) -> match_result
+{
+    // the side is picked once per order, each matching loop is compiled for its side
+    match_result result = aggressor.wish == side::BID
+        ? match<policy, side::BID>(aggressor, id)
+        : match<policy, side::ASK>(aggressor, id);
 
-    // if the aggressor is bidding
-    if (aggressor.wish == side::BID)
+    // only the stops at the boundary need checking against the new last price
+    if (!result.transactions.empty())
     {
-        // no transactions when no relevent asks
-        if (m_asks.empty())
-            return {};
+        trigger_stops();
+    }
 
+    return result;
+}
 
-        // find the bid order
-        const vector<order> &bids = m_bids.at(aggressor.price);
-        assert(bids.size() >= 1);
+template<market::allocation policy, market::side S>
+auto market::ticker::match(const order &aggressor, id_system<ids::transaction_id> &id) -> match_result
+{
+    using aggressing = side_traits<S>;
+    using resting = side_traits<aggressing::opposite>;
 
-        // if there are multiple bids, we cannot possibility make any transactions
-        if (bids.size() > 1)
-            return {};
+    match_result result;
+    vector<transaction> &transactions = result.transactions;
+    book_side<resting::wish> &book = levels<resting::wish>();
 
-        const order &bid = bids[0];
+    // fill up from the best opposite level
+    int vol = aggressor.volume;
+    while (vol > 0 && !book.empty())
+    {
+        auto best = book.begin();
+        level &orders = best->second;
 
-        // fill up from the best ask
-        int vol = aggressor.volume;
-        for (const auto &ask : m_asks)
+        // filled price will always be the resting price
+        int filled_price = best->first;
+
+        // only transact while the resting price is within the aggressor's limit
+        if (!resting::reaches(filled_price, aggressor.price))
         {
-            int ask_price = ask.first;
-            const vector<order> &orders = ask.second;
+            // no matches any more
+            break;
+        }
 
-            // only transact when bid price is higher or equal than ask
-            if (ask_price > aggressor.price)
-            {
-                // no matches any more
-                break;
-            }
+        size_t traded = transactions.size();
+        vol = allocate<policy, resting::wish>(orders, vol, aggressor, result, [&](const order &ord, int filled_volume)
+        {
+            const order &bid = aggressing::bid(aggressor, ord);
+            const order &ask = aggressing::ask(aggressor, ord);
+            transactions.push_back(
+                { id.get("transaction"), S, filled_volume, filled_price, bid.id, ask.id, bid.user_id, ask.user_id, m_id }
+            );
+        });
 
-            // match orders, prio the first orders
-            // filled price will always be the ask price
-            int filled_price = ask_price;
-            for (const order &ord : orders)
-            {
-                if (vol > 0)
-                {
-                    int filled_volume = std::min(vol, ord.volume);
-                    transactions.push_back(
-                        { id.get("transaction"), side::BID, filled_volume, filled_price, bid.id, ord.id, bid.user_id, ord.user_id, m_id }
-                    );
-                    vol -= filled_volume;
+        assert(vol >= 0);
 
-                    assert(vol >= 0);
-                }
+        // a level only cleared by self-trade prevention did not trade
+        if (transactions.size() > traded)
+        {
+            m_valuation = filled_price;
+        }
+        if (orders.empty())
+        {
+            book.erase(best);
+        }
+    }
 
-                // stop after we fill everything
-                if (vol == 0)
-                {
-                    break;
-                }
-            }
+    return result;
+}
+
+template<market::allocation policy, market::side S, typename F>
+auto market::ticker::allocate(level &orders, int volume, const order &aggressor, match_result &result, F &&trade) -> int
+{
+    // the share given in time priority before anything is pro-rata
+    int first = volume;
+    if constexpr (policy == allocation::PRO_RATA)
+    {
+        first = 0;
+    }
+    else if constexpr (policy == allocation::PRO_RATA_TOP)
+    {
+        // a top order of the same user gets no top share, nor does the order behind it,
+        // it is prevented with the user's other orders and the rest is pro-rata over the others
+        bool own_top = aggressor.stp != self_trade::NONE && orders.front().user_id == aggressor.user_id;
+        first = own_top ? 0 : std::min(volume, orders.front().volume);
+    }
+    else if constexpr (policy == allocation::SIZE_TIME)
+    {
+        first = static_cast<int>(static_cast<long long>(volume) * SIZE_TIME_FIFO_PERCENT / 100);
+    }
+
+    int prevented = result.prevented;
+    int left = volume - first + fill_in_time<S>(orders, first, aggressor, result, trade);
+
+    // cancelling the aggressor cancels what was held back for the pro-rata share too
+    if (result.prevented > prevented && (aggressor.stp == self_trade::CANCEL_NEWEST || aggressor.stp == self_trade::CANCEL_BOTH))
+    {
+        result.prevented += left;
+        return 0;
+    }
+
+    if constexpr (policy != allocation::FIFO)
+    {
+        if (left > 0 && !orders.empty())
+        {
+            left = fill_pro_rata<S>(orders, left, aggressor, result, trade);
+        }
+    }
+
+    return left;
+}
+
+template<market::side S, typename F>
+auto market::ticker::fill_in_time(level &orders, int volume, const order &aggressor, match_result &result, F &&trade) -> int
+{
+    // without prevention no resting order can match this user id
+    ids::user_id self = aggressor.stp == self_trade::NONE ? -1 : aggressor.user_id;
+
+    // match orders, prio the first orders
+    while (volume > 0 && !orders.empty())
+    {
+        order ord = orders.front();
+        if (ord.user_id == self)
+        {
+            prevent_self_trade<S>(orders, ord, volume, aggressor.stp, result);
+            continue;
+        }
 
-            // stop checking higher asks if we are done
-            if (vol == 0)
+        int filled_volume = std::min(volume, ord.volume);
+        trade(ord, filled_volume);
+        volume -= filled_volume;
+
+        // reduce the volume left, removing said order if it is completely filled
+        fill_resting<S>(orders, ord, filled_volume);
+    }
+
+    return volume;
+}
+
+template<market::side S, typename F>
+auto market::ticker::fill_pro_rata(level &orders, int volume, const order &aggressor, match_result &result, F &&trade) -> int
+{
+    // every order of the level shares in the fill, so the user's own orders are dealt with first,
+    // which needs a pass over the level only with self-trade prevention
+    if (aggressor.stp != self_trade::NONE)
+    {
+        vector<order> own;
+        for (const order &ord : orders.orders())
+        {
+            if (ord.user_id == aggressor.user_id)
             {
-                break;
+                own.push_back(ord);
             }
+        }
+
+        for (const order &ord : own)
+        {
+            if (volume == 0)
+                return 0;
+
+            prevent_self_trade<S>(orders, ord, volume, aggressor.stp, result);
+        }
+    }
+
+    if (volume == 0 || orders.empty())
+    {
+        return volume;
+    }
+
+    // taking the whole level leaves nothing to share
+    int total = orders.get_volume();
+    if (volume >= total)
+    {
+        return fill_in_time<S>(orders, volume, aggressor, result, trade);
+    }
 
+    // every order gets its rounded down share of the shown volume, which never fills it completely,
+    // so no order leaves or replenishes while the shares are handed out
+    vector<pair<order, int>> shares;
+    shares.reserve(orders.get_count());
+    for (const order &ord : orders.orders())
+    {
+        int share = static_cast<int>(static_cast<long long>(volume) * ord.volume / total);
+        if (share > 0)
+        {
+            shares.emplace_back(ord, share);
         }
+    }
 
+    for (const auto &[ord, share] : shares)
+    {
+        trade(ord, share);
+        volume -= share;
+        fill_resting<S>(orders, ord, share);
     }
-    else if (aggressor.wish == side::ASK)
+
+    // the rounding remainder goes in time priority
+    return fill_in_time<S>(orders, volume, aggressor, result, trade);
+}
+
+template<market::side S>
+auto market::ticker::prevent_self_trade(level &orders, const order &resting, int &volume, self_trade mode, match_result &result) -> void
+{
+    logger::log(fmt::format("preventing self trade of user {} against order {} with {}",
+        resting.user_id, resting.id, self_trade_repr[static_cast<int>(mode)]));
+
+    // the newest order is the aggressor, the oldest the resting one
+    int cut = 0;
+    switch (mode)
     {
-        // else if the aggressor is asking
+    case self_trade::CANCEL_NEWEST:
+        result.prevented += volume;
+        volume = 0;
+        return;
+    case self_trade::CANCEL_OLDEST:
+        cut = resting.volume + resting.hidden;
+        break;
+    case self_trade::CANCEL_BOTH:
+        cut = resting.volume + resting.hidden;
+        result.prevented += volume;
+        volume = 0;
+        break;
+    case self_trade::DECREMENT:
+        cut = std::min(volume, resting.volume + resting.hidden);
+        result.prevented += cut;
+        volume -= cut;
+        break;
+    default:
+        assert(false);
+    }
 
-        if (m_bids.empty())
-            return {};
+    cut_resting<S>(orders, resting, cut, result);
+}
 
-        // find the ask order
-        const vector<order> &asks = m_asks.at(aggressor.price);
-        assert(asks.size() >= 1);
+template<market::side S>
+auto market::ticker::cut_resting(level &orders, const order &resting, int cut, match_result &result) -> void
+{
+    // take from the reserve first, like an amend
+    int left = resting.volume + resting.hidden - cut;
+    if (left == 0)
+    {
+        order removed = orders.remove(resting.id);
+        emit(book_action::REMOVE, removed, 0);
+    }
+    else
+    {
+        int hidden_cut = std::min(cut, resting.hidden);
+        orders.reduce_hidden(resting.id, hidden_cut);
+        if (cut > hidden_cut)
+        {
+            orders.reduce(resting.id, cut - hidden_cut);
+        }
+        emit(book_action::MODIFY, orders.at(resting.id), orders.at(resting.id).volume);
+    }
+    sync<S>(resting.price, orders);
 
-        if (asks.size() > 1)
-            return {};
+    result.reduced.emplace_back(resting, left);
+}
 
-        const order &ask = asks[0];
+auto market::ticker::clearing_price() const -> optional<auction_price>
+{
+    if (m_bids.empty() || m_asks.empty() || m_bids.begin()->first < m_asks.begin()->first)
+        return std::nullopt;
+
+    // only prices between the best ask and best bid can clear, everything else trades less
+    const kernels::aligned_vector<int> &ask_prices = m_ask_depth.get_prices();
+    const kernels::aligned_vector<int> &bid_prices = m_bid_depth.get_prices();
+    vector<int> prices(ask_prices.begin(), ask_prices.begin() + m_ask_depth.through(bid_prices.front()));
+    prices.insert(prices.end(), bid_prices.begin(), bid_prices.begin() + m_bid_depth.through(ask_prices.front()));
+    std::sort(prices.begin(), prices.end());
+    prices.erase(std::unique(prices.begin(), prices.end()), prices.end());
+
+    // cumulative supply from the best ask, and demand from the best bid
+    kernels::aligned_vector<long long> supply;
+    kernels::aligned_vector<long long> demand;
+    m_ask_depth.cumulative(supply);
+    m_bid_depth.cumulative(demand);
+
+    // the volume resting at a price or better on one side
+    auto through = [](const depth &levels, const kernels::aligned_vector<long long> &cumulative, int price) -> long long
+    {
+        size_t count = levels.through(price);
+        return count == 0 ? 0 : cumulative[count - 1];
+    };
 
-        // fill up from the best bid
-        int vol = aggressor.volume;
-        for (auto bid = m_bids.rbegin(); bid != m_bids.rend(); ++bid)
+    optional<auction_price> best;
+    for (size_t i = 0; i < prices.size(); ++i)
+    {
+        long long sold = through(m_ask_depth, supply, prices[i]);
+        long long bought = through(m_bid_depth, demand, prices[i]);
+        int volume = static_cast<int>(std::min(sold, bought));
+        int imbalance = static_cast<int>(bought - sold);
+        auction_price candidate{ prices[i], volume, imbalance };
+
+        if (!best
+            || candidate.volume > best->volume
+            || (candidate.volume == best->volume && std::abs(candidate.imbalance) < std::abs(best->imbalance))
+            || (candidate.volume == best->volume && std::abs(candidate.imbalance) == std::abs(best->imbalance)
+                && std::abs(candidate.price - m_valuation) < std::abs(best->price - m_valuation)))
         {
-            int bid_price = bid->first;
-            const vector<order> &orders = bid->second;
+            best = candidate;
+        }
+    }
 
-            // only transact when ask price is lower or equal than bid
-            if (bid_price < aggressor.price)
-            {
-                // no matches any more
-                break;
-            }
+    return best;
+}
+
+auto market::ticker::uncross(id_system<ids::transaction_id> &id) -> match_result
+{
+    optional<auction_price> clearing = clearing_price();
+    if (!clearing)
+        return {};
+
+    const auto [price, volume, imbalance] = clearing.value();
+    logger::log(fmt::format("uncrossing ticker {} at {} for {}, imbalance {}", m_alias, price, volume, imbalance));
+
+    // there is no aggressor in an auction, so the side left with excess volume is reported
+    side excess = imbalance >= 0 ? side::BID : side::ASK;
+
+    // walk both sides from the best price in priority order, every eligible pair trades at the one price
+    match_result result;
+    while (!m_bids.empty() && !m_asks.empty())
+    {
+        auto bid = m_bids.begin();
+        auto ask = m_asks.begin();
+        if (bid->first < price || ask->first > price)
+            break;
+
+        order bid_order = bid->second.front();
+        order ask_order = ask->second.front();
+
+        // the oldest order rests, the newest is prevented as an aggressor would be
+        bool bid_newest = bid_order.id > ask_order.id;
+        const order &newest = bid_newest ? bid_order : ask_order;
+        const order &oldest = bid_newest ? ask_order : bid_order;
+        self_trade mode = newest.stp != self_trade::NONE ? newest.stp : oldest.stp;
+        if (bid_order.user_id == ask_order.user_id && mode != self_trade::NONE)
+        {
 
-            // match orders, prio the first orders
-            // filled price will always be the bid price
-            int filled_price = bid_price;
-            for (const order &ord : orders)
+            int volume = newest.volume + newest.hidden;
+            int prevented = result.prevented;
+            if (bid_newest)
             {
-                if (vol > 0)
+                prevent_self_trade<side::ASK>(ask->second, oldest, volume, mode, result);
+                if (result.prevented > prevented)
                 {
-                    int filled_volume = std::min(vol, ord.volume);
-                    transactions.push_back(
-                        { id.get("transaction"), side::ASK, filled_volume, filled_price, ord.id, ask.id, ord.user_id, ask.user_id,  m_id }
-                    );
-                    vol -= filled_volume;
-
-                    assert(vol >= 0);
+                    cut_resting<side::BID>(bid->second, newest, result.prevented - prevented, result);
                 }
-
-                // stop after we fill everything
-                if (vol == 0)
+            }
+            else
+            {
+                prevent_self_trade<side::BID>(bid->second, oldest, volume, mode, result);
+                if (result.prevented > prevented)
                 {
-                    break;
+                    cut_resting<side::ASK>(ask->second, newest, result.prevented - prevented, result);
                 }
             }
 
-            // stop checking higher asks if we are done
-            if (vol == 0)
+            if (bid->second.empty())
+            {
+                m_bids.erase(bid);
+            }
+            if (ask->second.empty())
             {
-                break;
+                m_asks.erase(ask);
             }
+            continue;
+        }
+
+        int filled_volume = std::min(bid_order.volume, ask_order.volume);
+
+        result.transactions.push_back({
+            id.get("transaction"), excess, filled_volume, price,
+            bid_order.id, ask_order.id, bid_order.user_id, ask_order.user_id, m_id, true
+        });
+
+        fill_resting<side::BID>(bid->second, bid_order, filled_volume);
+        if (bid->second.empty())
+        {
+            m_bids.erase(bid);
+        }
+
+        fill_resting<side::ASK>(ask->second, ask_order, filled_volume);
+        if (ask->second.empty())
+        {
+            m_asks.erase(ask);
         }
     }
 
-    return transactions;
+    // crossing orders of one user may all have been prevented, leaving the last price where it was
+    if (!result.transactions.empty())
+    {
+        m_valuation = price;
+        trigger_stops();
+    }
+
+    return result;
 }
 
-auto market::ticker::has_order(const order &ord) -> bool
+auto market::ticker::get_allocation() const -> allocation
 {
-    if (ord.wish == side::ASK)
+    return m_allocation;
+}
+
+auto market::ticker::get_tick_size() const -> int
+{
+    return m_tick_size;
+}
+
+auto market::ticker::on_tick(int price) const -> bool
+{
+    return price % m_tick_size == 0;
+}
+
+auto market::ticker::get_phase() const -> market_phase
+{
+    return m_phase;
+}
+
+auto market::ticker::set_phase(market_phase phase) -> void
+{
+    m_phase = phase;
+}
+
+auto market::ticker::add_stop(const stop_order &stop) -> void
+{
+    assert(!m_stop_index.contains(stop.ord.id));
+
+    pmr::multimap<int, stop_order> &stops = stop.ord.wish == side::BID ? m_buy_stops : m_sell_stops;
+    m_stop_index[stop.ord.id] = stops.insert({ stop.trigger, stop });
+}
+
+auto market::ticker::cancel_stop(ids::user_id userid, ids::order_id orderid) -> bool
+{
+    if (m_stop_index.contains(orderid))
     {
-        if (!m_asks.contains(ord.price))
+        auto it = m_stop_index.at(orderid);
+        if (it->second.ord.user_id != userid)
             return false;
 
-        auto it = std::find_if(m_asks[ord.price].begin(), m_asks[ord.price].end(), [&](const order &val)
+        pmr::multimap<int, stop_order> &stops = it->second.ord.wish == side::BID ? m_buy_stops : m_sell_stops;
+        stops.erase(it);
+        m_stop_index.erase(orderid);
+        return true;
+    }
+
+    if (m_triggered.contains(orderid) && m_triggered.at(orderid).ord.user_id == userid)
+    {
+        m_triggered.erase(orderid);
+        return true;
+    }
+
+    return false;
+}
+
+auto market::ticker::cancel_user_stops(ids::user_id userid) -> int
+{
+    int removed = 0;
+    for (pmr::multimap<int, stop_order> *stops : { &m_buy_stops, &m_sell_stops })
+    {
+        for (auto it = stops->begin(); it != stops->end();)
         {
-            return val.id == ord.id;
-        });
+            if (it->second.ord.user_id == userid)
+            {
+                m_stop_index.erase(it->second.ord.id);
+                it = stops->erase(it);
+                removed += 1;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    removed += static_cast<int>(std::erase_if(m_triggered, [&](const auto &item)
+    {
+        return item.second.ord.user_id == userid;
+    }));
+
+    return removed;
+}
+
+auto market::ticker::has_triggered() const -> bool
+{
+    return !m_triggered.empty();
+}
+
+auto market::ticker::pop_triggered() -> stop_order
+{
+    assert(!m_triggered.empty());
+
+    auto node = m_triggered.extract(m_triggered.begin());
+    return node.mapped();
+}
+
+auto market::ticker::trigger_stops() -> void
+{
+    // buy stops trigger once the price rises to them, the lowest trigger first
+    while (!m_buy_stops.empty() && m_buy_stops.begin()->first <= m_valuation)
+    {
+        const stop_order &stop = m_buy_stops.begin()->second;
+        logger::log(fmt::format("triggered buy stop {} @ {}", stop.ord.id, stop.trigger));
+
+        m_stop_index.erase(stop.ord.id);
+        m_triggered.insert({ stop.ord.id, stop });
+        m_buy_stops.erase(m_buy_stops.begin());
+    }
+
+    // and sell stops once the price falls to them, the highest trigger first
+    while (!m_sell_stops.empty() && std::prev(m_sell_stops.end())->first >= m_valuation)
+    {
+        auto it = std::prev(m_sell_stops.end());
+        logger::log(fmt::format("triggered sell stop {} @ {}", it->second.ord.id, it->second.trigger));
+
+        m_stop_index.erase(it->second.ord.id);
+        m_triggered.insert({ it->second.ord.id, it->second });
+        m_sell_stops.erase(it);
+    }
+}
 
-        return it != m_asks[ord.price].end();
+template<market::side S>
+auto market::ticker::fill_resting(level &orders, const order &ord, int volume) -> void
+{
+    int left = orders.reduce(ord.id, volume);
+    emit(book_action::EXECUTE, ord, left, volume);
+    if (left == 0 && ord.hidden > 0)
+    {
+        replenish(orders, ord);
     }
+    sync<S>(ord.price, orders);
+}
+
+template<market::side S>
+auto market::ticker::sync(int price, const level &orders) -> void
+{
+    depth_of<S>().set(price, orders.get_volume(), orders.get_hidden());
+}
+
+auto market::ticker::sync(side wish, int price, const level &orders) -> void
+{
+    if (wish == side::BID)
+        sync<side::BID>(price, orders);
     else
+        sync<side::ASK>(price, orders);
+}
+
+auto market::ticker::replenish(level &orders, const order &ord) -> void
+{
+    // the next slice of an iceberg joins the back of its level, as if it were a new order
+    order slice = ord;
+    slice.volume = std::min(ord.display, ord.hidden);
+    slice.hidden = ord.hidden - slice.volume;
+
+    logger::log(fmt::format("replenished iceberg {} with {}, {} hidden", ord.id, slice.volume, slice.hidden));
+
+    orders.push(slice);
+    emit(book_action::ADD, slice, slice.volume);
+}
+
+auto market::ticker::crosses(const order &ord) const -> bool
+{
+    return ord.wish == side::BID ? crosses<side::BID>(ord) : crosses<side::ASK>(ord);
+}
+
+auto market::ticker::crossed() const -> bool
+{
+    return !m_bids.empty() && !m_asks.empty() && m_bids.begin()->first >= m_asks.begin()->first;
+}
+
+template<market::side S>
+auto market::ticker::crosses(const order &ord) const -> bool
+{
+    using resting = side_traits<side_traits<S>::opposite>;
+
+    const book_side<resting::wish> &book = levels<resting::wish>();
+    return !book.empty() && resting::reaches(book.begin()->first, ord.price);
+}
+
+template<market::side S, typename F>
+auto market::ticker::sweep(const order &ord, F &&visit) const -> void
+{
+    using resting = side_traits<side_traits<S>::opposite>;
+
+    for (const auto &[price, orders] : levels<resting::wish>())
     {
-        if (!m_bids.contains(ord.price))
-            return false;
+        if (!resting::reaches(price, ord.price) || !visit(price, orders))
+            return;
+    }
+}
 
-        auto it = std::find_if(m_bids[ord.price].begin(), m_bids[ord.price].end(), [&](const order &val)
+auto market::ticker::available(const order &ord) const -> int
+{
+    if (ord.stp == self_trade::NONE)
+    {
+        const depth &levels = ord.wish == side::BID ? m_ask_depth : m_bid_depth;
+        return static_cast<int>(std::min<long long>(levels.available(ord.price, ord.volume), ord.volume));
+    }
+
+    // only then are the levels walked order by order, to find the user's own
+    int volume = 0;
+    auto take = [&](int, const level &orders)
+    {
+        int own = 0;
+        for (const order &resting : orders.orders())
         {
-            return val.id == ord.id;
-        });
+            if (resting.user_id == ord.user_id)
+            {
+                own += resting.volume + resting.hidden;
+            }
+        }
+
+        // every other mode stops or shrinks the order on meeting its own
+        if (own > 0 && ord.stp != self_trade::CANCEL_OLDEST)
+            return false;
+
+        volume += orders.get_volume() + orders.get_hidden() - own;
+        return volume < ord.volume;
+    };
+
+    if (ord.wish == side::BID)
+        sweep<side::BID>(ord, take);
+    else
+        sweep<side::ASK>(ord, take);
+
+    return std::min(volume, ord.volume);
+}
 
-        return it != m_bids[ord.price].end();
+auto market::ticker::cost(const order &ord) const -> long long
+{
+    long long notional = 0;
+    int volume = ord.volume;
+    auto take = [&](int price, const level &orders)
+    {
+        int filled = std::min(volume, orders.get_volume() + orders.get_hidden());
+        notional += static_cast<long long>(price) * filled;
+        volume -= filled;
+        return volume > 0;
+    };
+
+    if (ord.wish == side::BID)
+        sweep<side::BID>(ord, take);
+    else
+        sweep<side::ASK>(ord, take);
+
+    return notional;
+}
+
+auto market::ticker::add_order(const order &aggressor) -> void
+{
+    // icebergs only show their first slice
+    order shown = aggressor;
+    if (shown.display > 0 && shown.volume > shown.display)
+    {
+        shown.hidden = shown.volume - shown.display;
+        shown.volume = shown.display;
     }
+
+    with_levels(shown.wish, [&](auto &levels)
+    {
+        level &orders = levels[shown.price];
+        orders.push(shown);
+        sync(shown.wish, shown.price, orders);
+    });
+
+    emit(book_action::ADD, shown, shown.volume);
+}
+
+auto market::ticker::amend_order(const order &ord, const order &amended) -> void
+{
+    assert(ord.id == amended.id && ord.wish == amended.wish);
+    assert(amended.price == ord.price && amended.volume > 0 && amended.volume <= ord.volume);
+
+    with_levels(ord.wish, [&](auto &levels)
+    {
+        auto it = levels.find(ord.price);
+        assert(it != levels.end() && it->second.contains(ord.id));
+
+        level &orders = it->second;
+        const order &resting = orders.at(ord.id);
+        assert(resting.volume + resting.hidden == ord.volume);
+
+        // size down keeps the queue priority, taking from the reserve first
+        int cut = ord.volume - amended.volume;
+        int hidden_cut = std::min(cut, resting.hidden);
+        orders.reduce_hidden(ord.id, hidden_cut);
+        if (cut > hidden_cut)
+        {
+            orders.reduce(ord.id, cut - hidden_cut);
+        }
+        sync(ord.wish, ord.price, orders);
+
+        emit(book_action::MODIFY, orders.at(ord.id), orders.at(ord.id).volume);
+    });
+}
+
+auto market::ticker::cancel_order(const order &ord) -> void
+{
+    with_levels(ord.wish, [&](auto &levels)
+    {
+        // find the order
+        auto it = levels.find(ord.price);
+        assert(it != levels.end() && it->second.contains(ord.id));
+
+        // and erase it
+        order removed = it->second.remove(ord.id);
+        sync(ord.wish, ord.price, it->second);
+        if (it->second.empty())
+        {
+            levels.erase(it);
+        }
+
+        emit(book_action::REMOVE, removed, 0);
+    });
+}
+
+auto market::ticker::has_order(const order &ord) -> bool
+{
+    return with_levels(ord.wish, [&](const auto &levels)
+    {
+        auto it = levels.find(ord.price);
+        return it != levels.end() && it->second.contains(ord.id);
+    });
+}
+
+auto market::ticker::get_queue_position(const order &ord) const -> queue_position
+{
+    return with_levels(ord.wish, [&](const auto &levels) -> queue_position
+    {
+        assert(levels.contains(ord.price));
+
+        const level &orders = levels.at(ord.price);
+        const auto [count, volume] = orders.ahead(ord.id);
+
+        return { ord.id, ord.wish, ord.price, orders.at(ord.id).volume, count, volume };
+    });
 }
 
 auto market::ticker::get_alias() const -> string
@@ -218,14 +826,12 @@ auto market::ticker::repr_orderbook() const -> string
 
         if (m_asks.contains(price))
         {
-            for (const order &ord : m_asks.at(price))
-                ask_vol += ord.volume;
+            ask_vol = m_asks.at(price).get_volume();
         }
 
         if (m_bids.contains(price))
         {
-            for (const order &ord : m_bids.at(price))
-                bid_vol += ord.volume;
+            bid_vol = m_bids.at(price).get_volume();
         }
 
 
@@ -235,29 +841,45 @@ auto market::ticker::repr_orderbook() const -> string
     return repr;
 }
 
-auto market::ticker::get_orderbook() const -> orderbook
+auto market::ticker::get_orderbook(size_t levels) const -> orderbook
 {
-    orderbook book;
+    return { m_bid_depth.best(levels), m_ask_depth.best(levels) };
+}
 
-    for (const auto &[price, orders] : m_bids)
-    {
-        int volume = 0;
-        for (const auto &ord : orders)
-        {
-            volume += ord.volume;
-        }
-        book.bids[price] = volume;
-    }
+auto market::ticker::get_depth(side wish) const -> const depth &
+{
+    return wish == side::BID ? m_bid_depth : m_ask_depth;
+}
 
-    for (const auto &[price, orders] : m_asks)
-    {
-        int volume = 0;
-        for (const auto &ord : orders)
-        {
-            volume += ord.volume;
-        }
-        book.asks[price] = volume;
-    }
+auto market::ticker::get_bids() const -> const book_side<side::BID> &
+{
+    return m_bids;
+}
+
+auto market::ticker::get_asks() const -> const book_side<side::ASK> &
+{
+    return m_asks;
+}
+
+auto market::ticker::get_sequence() const -> unsigned long long
+{
+    return m_sequence;
+}
+
+auto market::ticker::get_events() const -> const vector<book_event> &
+{
+    return m_events;
+}
 
-    return book;
+auto market::ticker::consume_events() -> vector<book_event>
+{
+    vector<book_event> events;
+    events.swap(m_events);
+    return events;
+}
+
+auto market::ticker::emit(book_action action, const order &ord, int volume, int executed) -> void
+{
+    m_sequence += 1;
+    m_events.push_back({ m_sequence, action, ord.id, m_id, ord.wish, ord.price, volume, executed });
 }
\ No newline at end of file
@@ -3,20 +3,94 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <optional>
+#include <memory_resource>
+#include <cstdint>
 #include "id.h"
 #include "order.h"
 #include "user.h"
 #include "transaction.h"
+#include "level.h"
+#include "book_event.h"
+#include "depth.h"
 
 namespace market
 {
 
 using namespace std;
 
+// the shown volume of each price level, best price first
 struct orderbook
 {
-    map<int, int> bids;
-    map<int, int> asks;
+    vector<depth_level> bids;
+    vector<depth_level> asks;
+};
+
+// how orders entering a ticker are matched
+enum class market_phase
+{
+    // matched on arrival
+    CONTINUOUS = 0,
+    // collected and crossed in one auction at the end of every tick
+    BATCH = 1,
+    // collected until an auction is called, for opening and closing auctions
+    CALL = 2
+};
+static const char *market_phase_repr[] = { "continuous", "batch", "call" };
+
+// how the volume trading at a price level is shared between its resting orders
+enum class allocation
+{
+    // in time priority
+    FIFO = 0,
+    // in proportion to the shown volume, the rounding remainder in time priority
+    PRO_RATA = 1,
+    // the first order in the queue fills first, then pro-rata, no order fills first when the first is prevented from self-trading
+    PRO_RATA_TOP = 2,
+    // a fixed share in time priority, then pro-rata
+    SIZE_TIME = 3
+};
+static const char *allocation_repr[] = { "fifo", "pro_rata", "pro_rata_top", "size_time" };
+
+// the result of crossing the order book at a single price
+struct auction_price
+{
+    int price;
+    int volume;
+
+    // bid volume minus ask volume willing to trade at the price
+    int imbalance;
+};
+
+// the outcome of matching an aggressor against the order book
+struct match_result
+{
+    // in fill order
+    vector<transaction> transactions;
+
+    // aggressor volume removed by self-trade prevention, which must not rest
+    int prevented = 0;
+
+    // resting orders of the aggressor's user reduced by self-trade prevention, with the volume left on them
+    vector<pair<order, int>> reduced;
+};
+
+// the price levels of one side of an order book, best price first, their queues allocated with the levels
+template<side S>
+using book_side = pmr::map<int, level, typename side_traits<S>::compare>;
+
+// the place of a resting order in its price level
+struct queue_position
+{
+    ids::order_id id;
+    side wish;
+    int price;
+    int volume;
+
+    // orders and volume that must trade before this order
+    int orders_ahead;
+    int volume_ahead;
 };
 
 /**
@@ -31,45 +105,164 @@ protected:
     // ticker id
     ids::ticker_id m_id;
 
-    // bids and asks, price are the keys, values are the list of orders at that price
-    // the vector is sorted so that orders at the front are processed first
-    map<int, vector<market::order>> m_bids;
-    map<int, vector<market::order>> m_asks;
+    // bids and asks, price are the keys, values are the queue of orders at that price, best price first
+    book_side<side::BID> m_bids;
+    book_side<side::ASK> m_asks;
+
+    // the level volumes of each side as flat arrays, for depth queries
+    depth m_bid_depth;
+    depth m_ask_depth;
 
     // valuation for the ticker
     int m_valuation;
 
+    // trading phase, the order book may be crossed outside of continuous trading
+    market_phase m_phase;
+
+    // allocation policy within a price level
+    allocation m_allocation;
+
+    // prices are multiples of the tick size
+    int m_tick_size;
+
+    // pending stops keyed by trigger price, buy stops trigger from the lowest and sell stops from the highest
+    pmr::multimap<int, stop_order> m_buy_stops;
+    pmr::multimap<int, stop_order> m_sell_stops;
+    pmr::unordered_map<ids::order_id, pmr::multimap<int, stop_order>::iterator> m_stop_index;
+
+    // stops triggered but not yet executed, by order id so they run in the order they were placed
+    pmr::map<ids::order_id, stop_order> m_triggered;
+
+    // market-by-order events since they were last consumed
+    vector<book_event> m_events;
+    unsigned long long m_sequence;
+
 public:
     ticker();
 
-    // setup a ticker
-    ticker(string name, ids::ticker_id id);
+    /**
+     * @brief Sets up a ticker
+     * @param name
+     * @param id
+     * @param policy How a level's volume is shared between its orders
+     * @param tick_size Prices are multiples of it
+     * @param resource Where the book and stops are allocated, the heap by default
+    */
+    ticker(string name, ids::ticker_id id, allocation policy = allocation::FIFO, int tick_size = 1,
+        pmr::memory_resource *resource = pmr::get_default_resource());
 
     /**
-     * @brief Computes the transactions made upon inserting a new order
+     * @brief Reserves room so trading below these never reallocates the depth or the stop index
+     * @param levels Price levels on each side
+     * @param orders Pending stop orders
+     * @return
+    */
+    auto reserve(size_t levels, size_t orders) -> void;
+
+    /**
+     * @brief Matches an incoming order against the opposite side of the order book
      *
+     * The aggressor is not in the order book, only the resting orders it fills are updated.
+     * Within a price level, the volume is shared by the ticker's allocation policy.
+     * Resting orders of the aggressor's user are handled by the aggressor's self-trade prevention instead of traded.
      * Assuming that before the aggressor's order, no transactions are possible
      *
      * @param aggressor The aggressor's order
      * @param id Id system
-     * @return A list of transactions
+     * @return The transactions and the volume removed by self-trade prevention
+    */
+    auto match(const order &aggressor, id_system<ids::transaction_id> &id)->match_result;
+
+    /**
+     * @brief Finds the uniform price that maximises the volume executed when crossing the book
+     *
+     * Ties are broken by the smallest imbalance, then by the closest price to the last price, then the lowest price.
+     *
+     * @return The clearing price, volume and imbalance, or nothing if the book is not crossed
     */
-    auto match(const order &aggressor, id_system<ids::transaction_id> &id) const->vector<transaction>;
+    auto clearing_price() const->optional<auction_price>;
 
     /**
-     * @brief Updates the order book using a transaction and the aggressor orders
+     * @brief Crosses the order book at the clearing price in one pass, in price then time priority on both sides
      *
-     * Updates both side of the order book (one under the transaction, and the other under the aggressor)
+     * Two orders of the same user meeting are handled by the self-trade prevention of the newest, or the
+     * oldest's when the newest has none, the newest taking the place of the aggressor.
      *
-     * @param aggressor The aggressor order
-     * @param trans The transaction resulting from that order, compute by this.match
+     * @param id Id system
+     * @return The transactions, all at the clearing price, and the orders reduced by self-trade prevention
+    */
+    auto uncross(id_system<ids::transaction_id> &id)->match_result;
+
+    auto get_allocation() const -> allocation;
+
+    auto get_tick_size() const -> int;
+    // whether a price is a multiple of the tick size
+    auto on_tick(int price) const -> bool;
+
+    auto get_phase() const -> market_phase;
+    auto set_phase(market_phase phase) -> void;
+
+    /**
+     * @brief Holds a stop order until the last traded price reaches its trigger
+     * @param stop The stop order
      * @return
     */
-    auto process_transaction(const order &aggressor, const transaction &trans) -> void;
+    auto add_stop(const stop_order &stop) -> void;
+
+    /**
+     * @brief Removes a pending or triggered stop order
+     * @param userid The user that must own the stop
+     * @param orderid
+     * @return Whether the stop was found
+    */
+    auto cancel_stop(ids::user_id userid, ids::order_id orderid) -> bool;
+
+    // removes all pending and triggered stops of a user, returning how many were removed
+    auto cancel_user_stops(ids::user_id userid) -> int;
+
+    // returns whether there are triggered stops waiting to be executed
+    auto has_triggered() const -> bool;
+
+    // removes the earliest placed triggered stop, to be executed
+    auto pop_triggered() -> stop_order;
+
+    /**
+     * @brief Returns whether an order would trade immediately against the opposite side
+     * @param ord The order
+     * @return
+    */
+    auto crosses(const order &ord) const -> bool;
+
+    // returns whether the best bid reaches the best ask, which only happens outside of continuous trading
+    auto crossed() const -> bool;
+
+    /**
+     * @brief Returns the opposite volume an order could fill against at its price or better, without changing the book
+     *
+     * Includes the reserve of iceberg orders. Stops counting once the order's volume is reached. With self-trade
+     * prevention the user's own orders are left out, and unless they are cancelled out of the order's way,
+     * nothing from the first level holding one is counted, so a fill or kill never fills in part
+     *
+     * @param ord The order
+     * @return The available volume, capped to the order volume
+    */
+    auto available(const order &ord) const -> int;
+
+    /**
+     * @brief Returns the notional an order would trade filling against the opposite side at its price or better, without changing the book
+     *
+     * Walks the levels best price first, including the reserve of iceberg orders, until the order's volume is reached
+     *
+     * @param ord The order
+     * @return The sum of price times volume over what the order could fill
+    */
+    auto cost(const order &ord) const -> long long;
 
     /**
      * @brief Adds an order to the order book
      *
+     * An iceberg order shows its display volume and holds the rest of its volume in reserve
+     *
      * @param aggresor
      * @return
     */
@@ -83,9 +276,27 @@ public:
      */
     auto cancel_order(const order &ord) -> void;
 
+    /**
+     * @brief Reduces the volume of a resting order in place, keeping its queue priority
+     *
+     * The reserve of an iceberg order is reduced before its shown volume
+     *
+     * @param ord The resting order, with its total volume left
+     * @param amended The order with the same price and its new total volume
+     * @return
+    */
+    auto amend_order(const order &ord, const order &amended) -> void;
+
     // returns whether the order book contains the order
     auto has_order(const order &ord) -> bool;
 
+    /**
+     * @brief Returns the place of a resting order in the queue of its price level
+     * @param ord The order containing the order id, side and price
+     * @return The queue position
+    */
+    auto get_queue_position(const order &ord) const->queue_position;
+
     /**
      * @brief Returns the string alias for the ticker
      * @return The string alias
@@ -109,7 +320,138 @@ public:
     auto repr_orderbook() const->string;
 
     /// GETTERS ///
-    auto get_orderbook() const->orderbook;
+
+    /**
+     * @brief Returns the shown volume of the best price levels of both sides
+     * @param levels The most levels of each side, all of them by default
+     * @return
+    */
+    auto get_orderbook(size_t levels = SIZE_MAX) const->orderbook;
+    auto get_depth(side wish) const -> const depth &;
+    auto get_bids() const -> const book_side<side::BID> &;
+    auto get_asks() const -> const book_side<side::ASK> &;
+
+    // sequence number of the last market-by-order event
+    auto get_sequence() const -> unsigned long long;
+    auto get_events() const -> const vector<book_event> &;
+    auto consume_events() -> vector<book_event>;
+
+protected:
+    // the matching loop compiled for one allocation policy
+    template<allocation policy>
+    auto match(const order &aggressor, id_system<ids::transaction_id> &id)->match_result;
+
+    // and for one aggressor side
+    template<allocation policy, side S>
+    auto match(const order &aggressor, id_system<ids::transaction_id> &id)->match_result;
+
+    // returns whether an order on a side would trade immediately
+    template<side S>
+    auto crosses(const order &ord) const -> bool;
+
+    // calls a function with each opposite level an order on a side reaches, best price first, until it returns false
+    template<side S, typename F>
+    auto sweep(const order &ord, F &&visit) const -> void;
+
+    // returns the levels of a side
+    template<side S>
+    auto levels() -> book_side<S> &
+    {
+        if constexpr (S == side::BID)
+            return m_bids;
+        else
+            return m_asks;
+    }
+
+    template<side S>
+    auto levels() const -> const book_side<S> &
+    {
+        if constexpr (S == side::BID)
+            return m_bids;
+        else
+            return m_asks;
+    }
+
+    // returns the depth of a side
+    template<side S>
+    auto depth_of() -> depth &
+    {
+        if constexpr (S == side::BID)
+            return m_bid_depth;
+        else
+            return m_ask_depth;
+    }
+
+    // calls a function taking the levels of a side, which is compiled once for each side
+    template<typename F>
+    auto with_levels(side wish, F &&visit)
+    {
+        return wish == side::BID ? visit(m_bids) : visit(m_asks);
+    }
+
+    template<typename F>
+    auto with_levels(side wish, F &&visit) const
+    {
+        return wish == side::BID ? visit(m_bids) : visit(m_asks);
+    }
+
+    /**
+     * @brief Fills up to a volume from a price level, sharing it between the resting orders by the policy
+     * @tparam S The side of the resting orders
+     * @param orders The price level
+     * @param volume The volume to fill
+     * @param aggressor The aggressor, for self-trade prevention
+     * @param result Where self-trade prevention is recorded
+     * @param trade Called with each resting order and the volume it trades, before the order is filled
+     * @return The volume left unfilled, 0 once self-trade prevention cancelled the aggressor
+    */
+    template<allocation policy, side S, typename F>
+    auto allocate(level &orders, int volume, const order &aggressor, match_result &result, F &&trade) -> int;
+
+    // fills a price level in time priority, returning the volume left unfilled
+    template<side S, typename F>
+    auto fill_in_time(level &orders, int volume, const order &aggressor, match_result &result, F &&trade) -> int;
+
+    // fills less than a price level's shown volume in proportion to each order's, returning the volume left unfilled
+    template<side S, typename F>
+    auto fill_pro_rata(level &orders, int volume, const order &aggressor, match_result &result, F &&trade) -> int;
+
+    /**
+     * @brief Applies the aggressor's self-trade prevention to a resting order of the same user
+     * @tparam S The side of the resting order
+     * @param orders The price level of the resting order
+     * @param resting The resting order
+     * @param volume The aggressor volume left, reduced by what is prevented
+     * @param mode The aggressor's self-trade prevention
+     * @param result Where the prevented volume and reduced resting order are recorded
+     * @return
+    */
+    template<side S>
+    auto prevent_self_trade(level &orders, const order &resting, int &volume, self_trade mode, match_result &result) -> void;
+
+    // takes volume from a resting order on a side, its reserve first, removing it once empty and recording it as reduced
+    template<side S>
+    auto cut_resting(level &orders, const order &resting, int cut, match_result &result) -> void;
+
+    // copies the volume of a price level, which may be empty, to the depth of its side
+    template<side S>
+    auto sync(int price, const level &orders) -> void;
+
+    // and for a side only known at runtime, outside of the matching loop
+    auto sync(side wish, int price, const level &orders) -> void;
+
+    // fills a resting order on a side, removing it once filled and replenishing icebergs
+    template<side S>
+    auto fill_resting(level &orders, const order &ord, int volume) -> void;
+
+    // re-queues the next slice of an iceberg whose shown volume was filled
+    auto replenish(level &orders, const order &ord) -> void;
+
+    // moves the stops whose trigger the last price has reached to the triggered queue
+    auto trigger_stops() -> void;
+
+    // record a market-by-order event
+    auto emit(book_action action, const order &ord, int volume, int executed = 0) -> void;
 
 };
 
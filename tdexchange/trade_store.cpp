@@ -0,0 +1,332 @@
+#include "trade_store.h"
+#include "logger.h"
+
+#include <fmt/core.h>
+#include <cassert>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// spill files of each process are kept apart, so a backup can run next to its primary
+static auto process_directory() -> std::string
+{
+#ifdef _WIN32
+    int pid = _getpid();
+#else
+    int pid = static_cast<int>(::getpid());
+#endif
+    return (std::filesystem::temp_directory_path() / fmt::format("tdexchange-trades-{}", pid)).string();
+}
+
+// varints of zigzagged deltas, so small steps either way take a byte or two
+static auto put_varint(std::vector<unsigned char> &out, long long delta) -> void
+{
+    unsigned long long value = (static_cast<unsigned long long>(delta) << 1) ^ static_cast<unsigned long long>(delta >> 63);
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+static auto get_varint(const unsigned char *&in) -> long long
+{
+    unsigned long long value = 0;
+    int shift = 0;
+    while (*in & 0x80)
+    {
+        value |= static_cast<unsigned long long>(*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= static_cast<unsigned long long>(*in++) << shift;
+
+    return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+}
+
+// rebuilds a trade from its column values
+static auto to_transaction(ids::ticker_id ticker_id, const std::array<long long, market::TRADE_COLUMNS> &row) -> market::transaction
+{
+    using market::trade_column;
+    auto at = [&](trade_column column)
+    {
+        return row[static_cast<size_t>(column)];
+    };
+
+    long long flags = at(trade_column::FLAGS);
+    market::transaction trans{
+        static_cast<ids::transaction_id>(at(trade_column::ID)),
+        (flags & 1) ? market::side::ASK : market::side::BID,
+        static_cast<int>(at(trade_column::VOLUME)),
+        static_cast<int>(at(trade_column::PRICE)),
+        static_cast<ids::order_id>(at(trade_column::BID_ID)),
+        static_cast<ids::order_id>(at(trade_column::ASK_ID)),
+        static_cast<ids::user_id>(at(trade_column::BIDDER)),
+        static_cast<ids::user_id>(at(trade_column::ASKER)),
+        ticker_id,
+        (flags & 2) != 0
+    };
+    trans.time = at(trade_column::TIME);
+    return trans;
+}
+
+auto market::trade_chunk::data() const -> const unsigned char *
+{
+    return spilled ? spilled->data() : bytes.data();
+}
+
+market::trade_store::trade_store(string directory, size_t resident_limit)
+    : m_directory(directory.empty() ? process_directory() : directory), m_resident_limit(resident_limit), m_partitions(), m_resident(),
+    m_spilled(0), m_size(0), m_user_chunks()
+{
+}
+
+market::trade_store::~trade_store()
+{
+    // spill files only back this run's memory
+    for (auto &[ticker_id, partition] : m_partitions)
+    {
+        for (size_t chunk = 0; chunk < partition.chunks.size(); ++chunk)
+        {
+            if (partition.chunks[chunk].spilled)
+            {
+                partition.chunks[chunk].spilled.reset();
+                std::error_code error;
+                std::filesystem::remove(path(ticker_id, chunk), error);
+            }
+        }
+    }
+
+    // only removed once empty
+    std::error_code error;
+    std::filesystem::remove(m_directory, error);
+}
+
+auto market::trade_store::append(const transaction &trans) -> void
+{
+    trade_partition &partition = m_partitions[trans.ticker_id];
+    array<vector<long long>, TRADE_COLUMNS> &open = partition.open;
+    assert(open[0].empty() || open[static_cast<size_t>(trade_column::TIME)].back() <= trans.time);
+
+    const long long row[TRADE_COLUMNS] = {
+        trans.time,
+        static_cast<long long>(trans.id),
+        trans.price,
+        trans.volume,
+        static_cast<long long>(trans.bid_id),
+        static_cast<long long>(trans.ask_id),
+        trans.bidder_id,
+        trans.asker_id,
+        (trans.aggressor == side::ASK ? 1 : 0) | (trans.auction ? 2 : 0)
+    };
+    for (size_t column = 0; column < TRADE_COLUMNS; ++column)
+    {
+        open[column].push_back(row[column]);
+    }
+    m_size += 1;
+
+    // the open chunk is the one past the full chunks
+    size_t chunk = partition.chunks.size();
+    for (ids::user_id user : { trans.bidder_id, trans.asker_id })
+    {
+        vector<size_t> &chunks = m_user_chunks[user][trans.ticker_id];
+        if (chunks.empty() || chunks.back() != chunk)
+        {
+            chunks.push_back(chunk);
+        }
+    }
+
+    if (open[0].size() == TRADE_CHUNK)
+    {
+        seal(trans.ticker_id, partition);
+    }
+}
+
+auto market::trade_store::range(ids::ticker_id ticker_id, long long from, long long to) const -> vector<transaction>
+{
+    vector<transaction> trades;
+    if (!m_partitions.contains(ticker_id) || from >= to)
+        return trades;
+
+    const trade_partition &partition = m_partitions.at(ticker_id);
+
+    // chunks are in time order, so the first that ends after the range starts is found by bisection
+    auto first = std::partition_point(partition.chunks.begin(), partition.chunks.end(), [&](const trade_chunk &chunk)
+    {
+        return chunk.last < from;
+    });
+    for (size_t chunk = first - partition.chunks.begin(); chunk < partition.chunks.size(); ++chunk)
+    {
+        if (partition.chunks[chunk].first >= to)
+            return trades;
+
+        collect(ticker_id, partition, chunk, from, to, -1, trades);
+    }
+    collect(ticker_id, partition, partition.chunks.size(), from, to, -1, trades);
+
+    return trades;
+}
+
+auto market::trade_store::user_trades(ids::user_id user_id, long long from, long long to) const -> vector<transaction>
+{
+    vector<transaction> trades;
+    if (!m_user_chunks.contains(user_id) || from >= to)
+        return trades;
+
+    for (const auto &[ticker_id, chunks] : m_user_chunks.at(user_id))
+    {
+        for (size_t chunk : chunks)
+        {
+            collect(ticker_id, m_partitions.at(ticker_id), chunk, from, to, user_id, trades);
+        }
+    }
+
+    return trades;
+}
+
+auto market::trade_store::size() const -> size_t
+{
+    return m_size;
+}
+
+auto market::trade_store::get_resident_chunks() const -> size_t
+{
+    return m_resident.size();
+}
+
+auto market::trade_store::get_spilled_chunks() const -> size_t
+{
+    return m_spilled;
+}
+
+auto market::trade_store::seal(ids::ticker_id ticker_id, trade_partition &partition) -> void
+{
+    array<vector<long long>, TRADE_COLUMNS> &open = partition.open;
+    const vector<long long> &times = open[static_cast<size_t>(trade_column::TIME)];
+
+    trade_chunk chunk{ times.front(), times.back(), times.size(), {}, {}, nullptr };
+    for (size_t column = 0; column < TRADE_COLUMNS; ++column)
+    {
+        chunk.offsets[column] = chunk.bytes.size();
+
+        long long previous = 0;
+        for (long long value : open[column])
+        {
+            put_varint(chunk.bytes, value - previous);
+            previous = value;
+        }
+
+        open[column].clear();
+    }
+    chunk.bytes.shrink_to_fit();
+
+    logger::log(fmt::format("sealed trade chunk {} of ticker {}, {} trades in {} bytes",
+        partition.chunks.size(), ticker_id, chunk.count, chunk.bytes.size()));
+
+    partition.chunks.push_back(std::move(chunk));
+    m_resident.emplace_back(ticker_id, partition.chunks.size() - 1);
+    spill();
+}
+
+auto market::trade_store::spill() -> void
+{
+    while (m_resident.size() > m_resident_limit)
+    {
+        const auto [ticker_id, index] = m_resident.front();
+        m_resident.pop_front();
+        trade_chunk &chunk = m_partitions.at(ticker_id).chunks[index];
+
+        string file = path(ticker_id, index);
+        try
+        {
+            std::filesystem::create_directories(m_directory);
+            {
+                std::ofstream out(file, std::ios::binary | std::ios::trunc);
+                out.write(reinterpret_cast<const char *>(chunk.bytes.data()), static_cast<std::streamsize>(chunk.bytes.size()));
+                if (!out)
+                    throw std::runtime_error(fmt::format("cannot write {}", file));
+            }
+
+            chunk.spilled = std::make_unique<mapped_file>(file);
+            vector<unsigned char>().swap(chunk.bytes);
+            m_spilled += 1;
+        }
+        catch (const std::exception &e)
+        {
+            // the chunk stays in memory, the store only loses its bound
+            logger::log(fmt::format("could not spill trade chunk {} of ticker {}: {}", index, ticker_id, e.what()), logger::mode::ERR);
+        }
+    }
+}
+
+auto market::trade_store::path(ids::ticker_id ticker_id, size_t chunk) const -> string
+{
+    return (std::filesystem::path(m_directory) / fmt::format("{}_{}.trades", ticker_id, chunk)).string();
+}
+
+auto market::trade_store::collect(ids::ticker_id ticker_id, const trade_partition &partition, size_t chunk,
+    long long from, long long to, ids::user_id user, vector<transaction> &out) const -> void
+{
+    auto wanted = [&](const array<long long, TRADE_COLUMNS> &row)
+    {
+        return user == -1
+            || row[static_cast<size_t>(trade_column::BIDDER)] == user
+            || row[static_cast<size_t>(trade_column::ASKER)] == user;
+    };
+
+    array<long long, TRADE_COLUMNS> row;
+
+    // the open chunk is not encoded, and its times are searched directly
+    if (chunk == partition.chunks.size())
+    {
+        const vector<long long> &times = partition.open[static_cast<size_t>(trade_column::TIME)];
+        size_t begin = std::lower_bound(times.begin(), times.end(), from) - times.begin();
+        size_t end = std::lower_bound(times.begin(), times.end(), to) - times.begin();
+        for (size_t i = begin; i < end; ++i)
+        {
+            for (size_t column = 0; column < TRADE_COLUMNS; ++column)
+            {
+                row[column] = partition.open[column][i];
+            }
+            if (wanted(row))
+            {
+                out.push_back(to_transaction(ticker_id, row));
+            }
+        }
+        return;
+    }
+
+    const trade_chunk &sealed = partition.chunks[chunk];
+    if (sealed.last < from || sealed.first >= to)
+        return;
+
+    // every column is decoded in step, a row at a time
+    const unsigned char *cursors[TRADE_COLUMNS];
+    for (size_t column = 0; column < TRADE_COLUMNS; ++column)
+    {
+        cursors[column] = sealed.data() + sealed.offsets[column];
+        row[column] = 0;
+    }
+
+    for (size_t i = 0; i < sealed.count; ++i)
+    {
+        for (size_t column = 0; column < TRADE_COLUMNS; ++column)
+        {
+            row[column] += get_varint(cursors[column]);
+        }
+
+        long long time = row[static_cast<size_t>(trade_column::TIME)];
+        if (time >= to)
+            return;
+        if (time >= from && wanted(row))
+        {
+            out.push_back(to_transaction(ticker_id, row));
+        }
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <deque>
+#include <map>
+#include <memory>
+#include <limits>
+#include <unordered_map>
+
+#include "id.h"
+#include "transaction.h"
+#include "mapped_file.h"
+
+namespace market
+{
+
+using namespace std;
+
+// trades per chunk, a chunk is compressed once full
+constexpr size_t TRADE_CHUNK = 16384;
+
+// the fields of a trade, stored as one column each
+enum class trade_column
+{
+    TIME = 0,
+    ID = 1,
+    PRICE = 2,
+    VOLUME = 3,
+    BID_ID = 4,
+    ASK_ID = 5,
+    BIDDER = 6,
+    ASKER = 7,
+    // the aggressor side and whether it was an auction
+    FLAGS = 8
+};
+constexpr size_t TRADE_COLUMNS = 9;
+
+/**
+ * @brief A full chunk of trades of one ticker, its columns delta and varint encoded one after another
+*/
+struct trade_chunk
+{
+    // times of the first and last trade
+    long long first;
+    long long last;
+    size_t count;
+
+    // where each column starts in the encoded bytes
+    array<size_t, TRADE_COLUMNS> offsets;
+
+    // the encoded bytes, in memory until the chunk is spilled, then mapped from its file
+    vector<unsigned char> bytes;
+    unique_ptr<mapped_file> spilled;
+
+    auto data() const -> const unsigned char *;
+};
+
+// the trades of one ticker, in time order
+struct trade_partition
+{
+    vector<trade_chunk> chunks;
+
+    // trades of the chunk being filled, by column
+    array<vector<long long>, TRADE_COLUMNS> open;
+};
+
+/**
+ * @brief An append-only store of every trade, partitioned by ticker and time into columnar chunks
+ *
+ * Trades of a ticker are appended in time order. Every TRADE_CHUNK trades the chunk is compressed, and once more
+ * than a number of chunks are held in memory the oldest are written to files and mapped back, so memory stays
+ * bounded however long the exchange runs. Chunks know their time range so time queries only decode the chunks
+ * they overlap, and every user keeps the chunks they traded in.
+*/
+class trade_store
+{
+protected:
+    // spill files are written here
+    string m_directory;
+
+    // most compressed chunks kept in memory
+    size_t m_resident_limit;
+
+    map<ids::ticker_id, trade_partition> m_partitions;
+
+    // chunks in memory, oldest first
+    deque<pair<ids::ticker_id, size_t>> m_resident;
+    size_t m_spilled;
+    size_t m_size;
+
+    // the chunks each user traded in by ticker, a chunk index past the full chunks is the open chunk
+    unordered_map<ids::user_id, map<ids::ticker_id, vector<size_t>>> m_user_chunks;
+
+public:
+    /**
+     * @brief Creates an empty store
+     * @param directory Where old chunks are spilled to, created when first needed, a directory of this process
+     * under the temporary directory when empty
+     * @param resident_limit The most compressed chunks kept in memory
+    */
+    trade_store(string directory = "", size_t resident_limit = 64);
+    ~trade_store();
+
+    trade_store(const trade_store &) = delete;
+    auto operator=(const trade_store &) -> trade_store & = delete;
+
+    /**
+     * @brief Appends a trade to its ticker
+     * @param trans The trade, not earlier than the last trade of its ticker
+     * @return
+    */
+    auto append(const transaction &trans) -> void;
+
+    /**
+     * @brief Returns the trades of a ticker within a time range
+     * @param ticker_id
+     * @param from The earliest time included
+     * @param to The first time excluded
+     * @return The trades in time order
+    */
+    auto range(ids::ticker_id ticker_id, long long from = numeric_limits<long long>::min(), long long to = numeric_limits<long long>::max()) const->vector<transaction>;
+
+    /**
+     * @brief Returns the trades a user was either side of within a time range
+     * @param user_id
+     * @param from The earliest time included
+     * @param to The first time excluded
+     * @return The trades, in time order per ticker and by ticker id
+    */
+    auto user_trades(ids::user_id user_id, long long from = numeric_limits<long long>::min(), long long to = numeric_limits<long long>::max()) const->vector<transaction>;
+
+    // number of trades stored
+    auto size() const -> size_t;
+
+    // number of chunks compressed in memory and spilled to files
+    auto get_resident_chunks() const -> size_t;
+    auto get_spilled_chunks() const -> size_t;
+
+protected:
+    // compresses the open chunk of a ticker
+    auto seal(ids::ticker_id ticker_id, trade_partition &partition) -> void;
+
+    // writes the oldest chunks in memory to files until within the limit
+    auto spill() -> void;
+
+    // returns the spill file of a chunk
+    auto path(ids::ticker_id ticker_id, size_t chunk) const -> string;
+
+    /**
+     * @brief Collects the trades of a chunk within a time range
+     * @param ticker_id
+     * @param partition
+     * @param chunk The chunk index, past the full chunks for the open chunk
+     * @param from
+     * @param to
+     * @param user Only trades this user was either side of, or every trade when -1
+     * @param out
+     * @return
+    */
+    auto collect(ids::ticker_id ticker_id, const trade_partition &partition, size_t chunk,
+        long long from, long long to, ids::user_id user, vector<transaction> &out) const -> void;
+};
+
+};
@@ -5,8 +5,9 @@
 auto market::transaction::repr() const -> string
 {
     return fmt::format(
-        "Transaction {}, {} aggressor between {} and {} on {} of {} @ {}, orders {} and {}",
+        "Transaction {}{}, {} aggressor between {} and {} on {} of {} @ {}, orders {} and {}",
         id,
+        auction ? " (auction)" : "",
         market::side_repr[static_cast<int>(aggressor)],
         bidder_id, asker_id,
         ticker_id,
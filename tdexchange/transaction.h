@@ -34,6 +34,12 @@ struct transaction
     // id of the ticker it operated on
     ids::ticker_id ticker_id;
 
+    // whether it was crossed in an auction, where the aggressor is the side with excess volume
+    bool auction = false;
+
+    // nanoseconds since the epoch, stamped when the exchange records it
+    long long time = 0;
+
     /// DISPLAY ///
     auto repr() const->string;
 };
@@ -0,0 +1,64 @@
+#include "universe.h"
+
+#include <fmt/core.h>
+#include <random>
+
+auto market::default_universe() -> universe
+{
+    universe config;
+    config.tickers = {
+        { 1, "PHILIPS_A" },
+        { 2, "PHILIPS_B" }
+    };
+
+    // fake users, using the name as a passphase (unsafe)
+
+    // bots
+    for (int i = 0; i < 20; ++i)
+    {
+        string name = fmt::format("bot-{:02}", i);
+        config.users.push_back({ i, name, name });
+    }
+
+    // trading accounts
+    for (char c = 'a'; c <= 'p'; ++c)
+    {
+        string name = fmt::format("trading-{}", c);
+        config.users.push_back({ static_cast<int>(c), name, name });
+    }
+
+    // admin
+    config.users.push_back({ 1000, "terry", "terry", true });
+
+    return config;
+}
+
+auto market::synthetic_universe(size_t tickers, size_t users, unsigned seed) -> universe
+{
+    std::mt19937 rng(seed);
+    const int tick_sizes[] = { 1, 1, 1, 5, 10 };
+
+    universe config;
+    config.tickers.reserve(tickers);
+    for (size_t i = 1; i <= tickers; ++i)
+    {
+        // mostly time priority, like most real books
+        allocation policy = rng() % 8 == 0 ? static_cast<allocation>(1 + rng() % 3) : allocation::FIFO;
+        config.tickers.push_back({ i, fmt::format("SYN{:04}", i), tick_sizes[rng() % std::size(tick_sizes)], policy });
+    }
+
+    config.users.reserve(users + 1);
+    for (size_t i = 0; i < users; ++i)
+    {
+        string name = fmt::format("user-{:05}", i);
+        config.users.push_back({ static_cast<int>(i), name, name });
+    }
+    config.users.push_back({ static_cast<int>(users), "terry", "terry", true });
+
+    // room for every user to rest a few orders in a few tickers
+    config.reserve.orders = std::max<size_t>(4096, users * 16);
+    config.reserve.levels = 256;
+    config.reserve.transactions = config.reserve.orders;
+
+    return config;
+}
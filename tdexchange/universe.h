@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "id.h"
+#include "ticker.h"
+#include "memory_arena.h"
+
+namespace market
+{
+
+using namespace std;
+
+struct ticker_spec
+{
+    ids::ticker_id id;
+    string alias;
+    // prices are multiples of the tick size
+    int tick_size = 1;
+    allocation policy = allocation::FIFO;
+};
+
+struct user_spec
+{
+    ids::user_id id;
+    string name;
+    string passphase;
+    bool admin = false;
+};
+
+// what an exchange reserves when it starts, so trading below these never reallocates
+struct capacity
+{
+    // open orders over every ticker, and price levels on each side of a ticker
+    size_t orders = 4096;
+    size_t levels = 256;
+    // transactions recorded between two ticks
+    size_t transactions = 4096;
+    // the pages the books and journal are allocated on
+    page_backing pages = page_backing::DEFAULT;
+};
+
+/**
+ * @brief The tickers and users an exchange starts with, and how much it reserves for them
+*/
+struct universe
+{
+    vector<ticker_spec> tickers;
+    vector<user_spec> users;
+    capacity reserve;
+};
+
+// the universe of the exchange game, two tickers, 20 bots, 16 trading accounts and an admin
+auto default_universe() -> universe;
+
+/**
+ * @brief Generates a universe for performance tests, the same for the same arguments
+ * @param tickers Tickers, named SYN0001 and up, with assorted tick sizes and allocation policies
+ * @param users Users, named user-00000 and up, using their name as a passphase, and the admin terry
+ * @param seed
+ * @return
+*/
+auto synthetic_universe(size_t tickers, size_t users, unsigned seed = 0) -> universe;
+
+};
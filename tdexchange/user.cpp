@@ -1,166 +1,92 @@
 #include "user.h"
 
 #include <cassert>
-#include <stdexcept>
-#include <fmt/core.h>
-#include "logger.h"
 
-market::user::user()
+market::user::user(const accounts &store, size_t index)
+    : m_accounts(&store), m_index(index)
 {
-    throw std::runtime_error("not implemented");
+    assert(index < store.size());
 }
 
-market::user::user(string name, ids::user_id id, string passphase)
-    : m_alias(name), m_id(id), m_passphase(passphase), m_holdings(), m_cash(0), m_is_admin(false)
+auto market::user::view_order(ids::order_id order_id) const -> const order &
 {
+    assert(has_order(order_id));
+
+    return m_accounts->view_order(order_id);
 }
 
-market::user::user(string name, ids::user_id id)
-    : m_alias(name), m_id(id), m_passphase(name), m_holdings(), m_cash(0), m_is_admin(false)
+auto market::user::get_orders() const -> vector<ids::order_id>
 {
+    return m_accounts->get_orders(m_index);
 }
 
-market::user::user(string name, ids::user_id id, bool is_admin)
-    : m_alias(name), m_id(id), m_passphase(name), m_holdings(), m_cash(0), m_is_admin(is_admin)
+auto market::user::has_order(ids::order_id order_id) const -> bool
 {
+    // order ids are unique over every user
+    return m_accounts->has_order(order_id) && m_accounts->view_order(order_id).user_id == get_id();
 }
 
-auto market::user::add_order(const order &ord) -> void
+auto market::user::get_assets(const map<ids::ticker_id, int> &valuations) const -> long long
 {
-    assert(!m_orders.contains(ord.id));
-    assert(m_id == ord.user_id);
-
-    logger::log(fmt::format("user {} added order {}", m_id, ord.id));
-
-    m_orders[ord.id] = ord;
+    return m_accounts->get_assets(m_index, valuations);
 }
 
-auto market::user::remove_order(const order &ord) -> void
+auto market::user::get_holding(ids::ticker_id ticker_id) const -> int
 {
-    assert(m_orders.contains(ord.id));
-
-    logger::log(fmt::format("user {} removed order {}", m_id, ord.id));
-
-    m_orders.erase(ord.id);
+    return m_accounts->get_position(m_index, ticker_id);
 }
 
-auto market::user::fill_order(const order &ord, int price, int volume, side type) -> void
+auto market::user::get_cash() const -> long long
 {
-    assert(m_orders.contains(ord.id));
-
-    logger::log(fmt::format("user {} filled a {} order {} of {} @ {}",
-        m_id, side_repr[static_cast<int>(type)], ord.id, volume, price));
-
-
-    if (type == side::BID)
-    {
-        // we've brought assets
-        m_cash -= price * volume;
-        m_holdings[ord.ticker_id] += volume;
-    }
-    else
-    {
-        // we've sold assets
-        m_cash += price * volume;
-        m_holdings[ord.ticker_id] -= volume;
-    }
-
-    // update order
-    m_orders[ord.id].volume -= volume;
-    assert(m_orders[ord.id].volume >= 0);
-    if (m_orders[ord.id].volume == 0)
-    {
-        m_orders.erase(ord.id);
-    }
+    return m_accounts->get_cash(m_index);
 }
 
-auto market::user::view_order(ids::order_id order_id) const -> const order &
+auto market::user::get_admin() const -> bool
 {
-    assert(m_orders.contains(order_id));
-
-    return m_orders.at(order_id);
+    return m_accounts->get_credentials(m_index).is_admin;
 }
 
-auto market::user::get_orders() const -> vector<ids::order_id>
+auto market::user::get_alias() const -> const string &
 {
-    vector<ids::order_id> orderids;
-    for (const auto &ord : m_orders)
-    {
-        orderids.push_back(ord.first);
-    }
-
-    return orderids;
+    return m_accounts->get_credentials(m_index).alias;
 }
 
-auto market::user::has_order(const order &ord) -> bool
+auto market::user::get_id() const -> ids::user_id
 {
-    return m_orders.contains(ord.id);
+    return m_accounts->get_id(m_index);
 }
 
-auto market::user::get_assets(const map<ids::ticker_id, int> &valuations) const -> int
+auto market::user::get_index() const -> size_t
 {
-    int total = m_cash;
-    for (const auto &key : m_holdings)
-    {
-        assert(valuations.contains(key.first));
-
-        total += key.second * valuations.at(key.first);
-    }
-
-    return total;
+    return m_index;
 }
 
-auto market::user::get_holdings() const -> const map<ids::ticker_id, int>
+auto market::user::get_open(ids::ticker_id ticker_id) const -> open_volume
 {
-    return m_holdings;
+    return m_accounts->get_open(m_index, ticker_id);
 }
 
-auto market::user::get_cash() const -> int
+auto market::user::get_open_orders() const -> int
 {
-    return m_cash;
+    return m_accounts->get_open_orders(m_index);
 }
 
-auto market::user::get_admin() const -> bool
+auto market::user::get_open_volume() const -> long long
 {
-    return m_is_admin;
+    return m_accounts->get_open_volume(m_index);
 }
 
-auto market::user::get_alias() const -> const string &
+auto market::user::get_bid_notional() const -> long long
 {
-    return m_alias;
+    return m_accounts->get_bid_notional(m_index);
 }
 
-auto market::user::match(const std::string &name, const std::string &passphase) const -> bool
+auto market::user::get_gross() const -> long long
 {
-    return m_alias == name && m_passphase == passphase;
+    return m_accounts->get_gross(m_index);
 }
 
 auto market::user::repr() const -> string
 {
-    string repr;
-
-    repr += fmt::format("name {}, id {}, passphase {}\n", m_alias, m_id, m_passphase);
-    repr += fmt::format("cash {}\n", m_cash);
-    repr += fmt::format("holdings:\n");
-
-    for (const auto &key : m_holdings)
-    {
-        repr += fmt::format("    {}: {}\n", key.first, key.second);
-    }
-    if (m_holdings.size() == 0)
-    {
-        repr += "none\n";
-    }
-
-    repr += "orders:\n";
-    for (const auto &ord : m_orders)
-    {
-        repr += ord.second.repr() + "\n";
-    }
-    if (m_orders.size() == 0)
-    {
-        repr += "none\n";
-    }
-
-    return repr;
-}
\ No newline at end of file
+    return m_accounts->repr(m_index);
+}
@@ -6,55 +6,21 @@
 
 #include "id.h"
 #include "order.h"
+#include "accounts.h"
 
 namespace market {
 
 using namespace std;
-// represents a user in the system
+// represents a user in the system, a read only view of its account
 class user
 {
 protected:
-    // user name
-    string m_alias;
-
-    // login details
-    ids::user_id m_id;
-    string m_passphase;
-
-    bool m_is_admin;
-
-    /// FINANCIALS ///
-
-    // cash money held
-    int m_cash;
-
-    // holdings mapping tickers to amounts
-    map<ids::ticker_id, int> m_holdings;
-    // mapping order ids to the order instances
-    map<ids::order_id, order> m_orders;
-
+    const accounts *m_accounts;
+    size_t m_index;
 
 public:
-    user();
-
-    // setup a user
-    user(string name, ids::user_id id, string passphase);
-
-    // setup a user, using the name as a passphase (unsafe)
-    user(string name, ids::user_id id);
-
-    user(string name, ids::user_id id, bool is_admin);
-
-    /// user operations
-
-    // link an order with the user
-    auto add_order(const order &ord) -> void;
-
-    // remove the order from the user
-    auto remove_order(const order &ord) -> void;
-
-    // process the order for the user
-    auto fill_order(const order &ord, int price, int volume, side type) -> void;
+    // view the user at an index of the accounts
+    user(const accounts &store, size_t index);
 
     // view the order given the id
     auto view_order(ids::order_id order_id) const->const order &;
@@ -63,7 +29,7 @@ public:
     auto get_orders() const->vector<ids::order_id>;
 
     // return if the user has the order
-    auto has_order(const order &ord) -> bool;
+    auto has_order(ids::order_id order_id) const -> bool;
 
     /**
      * @brief Returns the net wealth of the user, including cash and holdings
@@ -71,17 +37,22 @@ public:
      * @param valuations
      * @return
     */
-    auto get_assets(const map<ids::ticker_id, int> &valuations) const->int;
-    auto get_holdings() const->const map<ids::ticker_id, int>;
-    auto get_cash() const -> int;
+    auto get_assets(const map<ids::ticker_id, int> &valuations) const->long long;
+    auto get_holding(ids::ticker_id ticker_id) const -> int;
+    auto get_cash() const -> long long;
     auto get_admin() const -> bool;
     auto get_alias() const -> const string &;
+    auto get_id() const -> ids::user_id;
+    auto get_index() const -> size_t;
 
-    // returns whether the user info matches a given info
-    auto match(const std::string &name, const std::string &passphase) const -> bool;
+    /// EXPOSURE ///
+    auto get_open(ids::ticker_id ticker_id) const->open_volume;
+    auto get_open_orders() const -> int;
+    auto get_open_volume() const -> long long;
+    auto get_bid_notional() const -> long long;
+    auto get_gross() const -> long long;
 
     /// DISPLAY ///
     auto repr() const->string;
 };
 }
-
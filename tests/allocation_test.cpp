@@ -0,0 +1,79 @@
+#include "ticker.h"
+#include "check.h"
+
+using market::side;
+using market::allocation;
+using market::self_trade;
+
+// the volume each resting order traded, by order id
+static auto traded(const market::match_result &result, ids::order_id id) -> int
+{
+    int volume = 0;
+    for (const market::transaction &trans : result.transactions)
+    {
+        if (trans.ask_id == id)
+        {
+            volume += trans.volume;
+        }
+    }
+    return volume;
+}
+
+// every policy fills the whole taken volume, and takes the whole level when asked to
+static auto test_policies_fill() -> void
+{
+    for (allocation policy : { allocation::FIFO, allocation::PRO_RATA, allocation::PRO_RATA_TOP, allocation::SIZE_TIME })
+    {
+        market::ticker tick("T", 1, policy);
+        id_system<ids::transaction_id> id;
+        tick.add_order({ 1, 1, 1, side::ASK, 100, 10 });
+        tick.add_order({ 2, 2, 1, side::ASK, 100, 30 });
+        tick.add_order({ 3, 3, 1, side::ASK, 100, 60, 20 });
+
+        market::match_result result = tick.match({ 9, 9, 1, side::BID, 100, 50 }, id);
+        CHECK(traded(result, 1) + traded(result, 2) + traded(result, 3) == 50);
+
+        result = tick.match({ 10, 9, 1, side::BID, 100, 1000 }, id);
+        CHECK(traded(result, 1) + traded(result, 2) + traded(result, 3) == 50);
+        CHECK(tick.get_asks().empty());
+    }
+}
+
+// the top order fills first, then the rest is shared by shown volume
+static auto test_pro_rata_top() -> void
+{
+    market::ticker tick("T", 1, allocation::PRO_RATA_TOP);
+    id_system<ids::transaction_id> id;
+    tick.add_order({ 1, 1, 1, side::ASK, 100, 10 });
+    tick.add_order({ 2, 2, 1, side::ASK, 100, 30 });
+    tick.add_order({ 3, 3, 1, side::ASK, 100, 60 });
+
+    market::match_result result = tick.match({ 9, 9, 1, side::BID, 100, 55 }, id);
+    CHECK(traded(result, 1) == 10);
+    CHECK(traded(result, 2) == 15);
+    CHECK(traded(result, 3) == 30);
+}
+
+// a top order prevented from self-trading hands its top share to nobody, all is pro-rata over the others
+static auto test_pro_rata_top_self_trade() -> void
+{
+    market::ticker tick("T", 1, allocation::PRO_RATA_TOP);
+    id_system<ids::transaction_id> id;
+    tick.add_order({ 1, 1, 1, side::ASK, 100, 10 });
+    tick.add_order({ 2, 2, 1, side::ASK, 100, 30 });
+    tick.add_order({ 3, 3, 1, side::ASK, 100, 60 });
+
+    market::match_result result = tick.match({ 9, 1, 1, side::BID, 100, 50, 0, 0, self_trade::CANCEL_OLDEST }, id);
+    CHECK(traded(result, 1) == 0);
+    CHECK(traded(result, 2) == 17);
+    CHECK(traded(result, 3) == 33);
+    CHECK(result.reduced.size() == 1 && result.reduced.front().second == 0);
+}
+
+auto main() -> int
+{
+    test_policies_fill();
+    test_pro_rata_top();
+    test_pro_rata_top_self_trade();
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "exchange.h"
+#include "check.h"
+
+using market::side;
+
+// reducing the volume at the same price keeps the order's place in the queue
+static auto test_size_down() -> void
+{
+    market::exchange ex;
+    market::order_result first = ex.user_order(side::ASK, 1, 1, 100, 5);
+    ex.user_order(side::ASK, 2, 1, 100, 7);
+
+    CHECK(ex.user_amend_order(1, first.id, 100, 3));
+    std::vector<market::queue_position> positions = ex.user_queue_positions(2, 1);
+    CHECK(positions.size() == 1);
+    CHECK(positions.front().orders_ahead == 1 && positions.front().volume_ahead == 3);
+
+    // and fills first
+    ex.user_order(side::BID, 3, 1, 100, 3);
+    CHECK(ex.get_user(1).get_holding(1) == -3);
+    CHECK(ex.get_user(2).get_holding(1) == 0);
+    CHECK(!ex.get_user(1).has_order(first.id));
+}
+
+// any other change moves the order to the back of the queue, keeping its id
+static auto test_lose_priority() -> void
+{
+    market::exchange ex;
+    market::order_result first = ex.user_order(side::ASK, 1, 1, 100, 5);
+    ex.user_order(side::ASK, 2, 1, 100, 7);
+
+    CHECK(ex.user_amend_order(1, first.id, 100, 6));
+    CHECK(ex.user_queue_positions(2, 1).front().orders_ahead == 0);
+    std::vector<market::queue_position> positions = ex.user_queue_positions(1, 1);
+    CHECK(positions.size() == 1 && positions.front().id == first.id);
+    CHECK(positions.front().orders_ahead == 1 && positions.front().volume_ahead == 7);
+
+    // moving away and back to the price is a new place too
+    CHECK(ex.user_amend_order(2, ex.get_user(2).get_orders().front(), 101, 7));
+    CHECK(ex.user_amend_order(2, ex.get_user(2).get_orders().front(), 100, 7));
+    CHECK(ex.user_queue_positions(1, 1).front().orders_ahead == 0);
+}
+
+// an amend that crosses trades as an aggressor, and only the user's own resting orders can be amended
+static auto test_cross() -> void
+{
+    market::exchange ex;
+    ex.user_order(side::ASK, 1, 1, 100, 5);
+    market::order_result bid = ex.user_order(side::BID, 3, 1, 99, 2);
+
+    CHECK(!ex.user_amend_order(1, bid.id, 100, 2));
+    CHECK(ex.user_amend_order(3, bid.id, 101, 9));
+    CHECK(ex.get_user(3).get_holding(1) == 5);
+
+    // the rest stays resting at the new price under the same id
+    std::vector<market::queue_position> positions = ex.user_queue_positions(3, 1);
+    CHECK(positions.size() == 1 && positions.front().id == bid.id);
+    CHECK(positions.front().price == 101 && positions.front().volume == 4);
+
+    CHECK(ex.user_cancel_order(3, bid.id));
+    CHECK(!ex.user_amend_order(3, bid.id, 101, 1));
+}
+
+auto main() -> int
+{
+    test_size_down();
+    test_lose_priority();
+    test_cross();
+    return 0;
+}
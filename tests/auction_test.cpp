@@ -0,0 +1,88 @@
+#include "exchange.h"
+#include "check.h"
+
+using market::side;
+using market::order_type;
+using market::order_status;
+using market::market_phase;
+using market::self_trade;
+
+// the opening auction crosses at the price trading the most volume, every trade at that price
+static auto test_clearing_price() -> void
+{
+    market::exchange ex;
+    ex.set_phase(1, market_phase::CALL);
+    CHECK(ex.user_order(side::BID, 1, 1, 100, 5, order_type::MARKET).status == order_status::REJECTED);
+    CHECK(ex.user_order(side::BID, 1, 1, 102, 5).status == order_status::RESTING);
+    CHECK(ex.user_order(side::BID, 2, 1, 101, 5).status == order_status::RESTING);
+    CHECK(ex.user_order(side::BID, 3, 1, 99, 5).status == order_status::RESTING);
+    CHECK(ex.user_order(side::ASK, 4, 1, 98, 4).status == order_status::RESTING);
+    CHECK(ex.user_order(side::ASK, 5, 1, 100, 4).status == order_status::RESTING);
+    CHECK(ex.user_order(side::ASK, 6, 1, 103, 5).status == order_status::RESTING);
+
+    std::optional<market::auction_price> clearing = ex.get_ticker(1).clearing_price();
+    CHECK(clearing && clearing->volume == 8);
+
+    ex.set_phase(1, market_phase::CONTINUOUS);
+    CHECK(ex.get_transactions().size() > 0);
+    for (const market::transaction &trans : ex.get_transactions())
+    {
+        CHECK(trans.price == clearing->price && trans.auction);
+    }
+    CHECK(ex.get_user(1).get_holding(1) == 5);
+    CHECK(ex.get_user(2).get_holding(1) == 3);
+    CHECK(!ex.get_ticker(1).clearing_price());
+}
+
+// a stop limit triggered by a batch auction rests for the next one, instead of waiting for the next tick
+static auto test_batch_stop_limit() -> void
+{
+    market::exchange ex;
+    ex.set_phase(2, market_phase::BATCH);
+
+    market::order_result stop = ex.user_stop_order(side::BID, 3, 2, 50, 52, 2, order_type::STOP_LIMIT);
+    CHECK(stop.status == order_status::PENDING);
+
+    ex.user_order(side::BID, 1, 2, 50, 3);
+    ex.user_order(side::ASK, 2, 2, 50, 3);
+    ex.run_batch_auctions();
+
+    CHECK(ex.get_user(1).get_holding(2) == 3);
+    CHECK(ex.get_user(3).has_order(stop.id));
+
+    // and crosses in the next auction
+    ex.user_order(side::ASK, 2, 2, 52, 2);
+    ex.run_batch_auctions();
+    CHECK(ex.get_user(3).get_holding(2) == 2);
+}
+
+// two orders of one user meeting in an auction follow the newest order's self-trade prevention
+static auto test_auction_self_trade() -> void
+{
+    market::exchange ex;
+    ex.set_phase(1, market_phase::CALL);
+
+    market::order_result bid = ex.user_order(side::BID, 1, 1, 101, 5);
+    market::order_result ask = ex.user_order(side::ASK, 1, 1, 100, 5, order_type::LIMIT, 0, self_trade::CANCEL_NEWEST);
+    market::order_result other = ex.user_order(side::ASK, 2, 1, 100, 5);
+    CHECK(bid.status == order_status::RESTING && ask.status == order_status::RESTING);
+
+    ex.set_phase(1, market_phase::CONTINUOUS);
+
+    for (const market::transaction &trans : ex.get_transactions())
+    {
+        CHECK(trans.bidder_id != trans.asker_id);
+    }
+    CHECK(!ex.get_user(1).has_order(ask.id));
+    CHECK(ex.get_user(1).get_holding(1) == 5);
+    CHECK(ex.get_user(2).get_holding(1) == -5);
+    CHECK(!ex.get_user(2).has_order(other.id));
+}
+
+auto main() -> int
+{
+    test_clearing_price();
+    test_batch_stop_limit();
+    test_auction_self_trade();
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+
+#include "depth.h"
+
+// the volume shown at a price on one side of the book, 0 without a level there
+inline auto shown(const std::vector<market::depth_level> &levels, int price) -> int
+{
+    for (const market::depth_level &level : levels)
+    {
+        if (level.price == price)
+            return level.volume;
+    }
+    return 0;
+}
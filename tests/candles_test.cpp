@@ -0,0 +1,81 @@
+#include "candles.h"
+#include "check.h"
+
+using market::side;
+using market::candle;
+using market::resolution;
+
+constexpr long long SECOND = 1000000000LL;
+
+// a trade of a ticker at a time
+static auto trade(long long time, ids::ticker_id ticker, int price, int volume) -> market::transaction
+{
+    market::transaction trans{ 0, side::BID, volume, price, 0, 0, 1, 2, ticker };
+    trans.time = time;
+    return trans;
+}
+
+// trades of a period make one candle, a later period starts the next, and periods without trades have none
+static auto test_rollover() -> void
+{
+    market::candles bars;
+    bars.add(trade(10 * SECOND + 1, 1, 100, 2));
+    bars.add(trade(10 * SECOND + 500, 1, 104, 1));
+    bars.add(trade(10 * SECOND + 900, 1, 98, 3));
+    bars.add(trade(11 * SECOND - 1, 1, 101, 4));
+    bars.add(trade(13 * SECOND, 1, 102, 1));
+
+    std::vector<candle> seconds = bars.get(1, resolution::SECOND, 10);
+    CHECK(seconds.size() == 2);
+    const candle &first = seconds.front();
+    CHECK(first.start == 10 * SECOND && first.open == 100 && first.high == 104 && first.low == 98 && first.close == 101);
+    CHECK(first.volume == 10 && first.trades == 4);
+    CHECK(seconds.back().start == 13 * SECOND && seconds.back().open == 102 && seconds.back().trades == 1);
+
+    // both seconds fall in one minute
+    std::vector<candle> minutes = bars.get(1, resolution::MINUTE, 10);
+    CHECK(minutes.size() == 1 && minutes.front().start == 0 && minutes.front().volume == 11 && minutes.front().close == 102);
+
+    CHECK(bars.get(1, resolution::SECOND, 1).front().start == 13 * SECOND);
+    CHECK(bars.get(2, resolution::SECOND, 10).empty() && !bars.last(2, resolution::SECOND).has_value());
+}
+
+// the average price is weighted by volume
+static auto test_vwap() -> void
+{
+    market::candles bars;
+    bars.add(trade(SECOND, 1, 100, 3));
+    bars.add(trade(SECOND, 1, 200, 1));
+
+    std::optional<candle> last = bars.last(1, resolution::FIVE_MINUTES);
+    CHECK(last.has_value() && last->notional == 500 && last->vwap() == 125.0);
+    CHECK(candle{}.vwap() == 0.0);
+}
+
+// once the ring is full the oldest candles are overwritten, the latest kept in order
+static auto test_ring() -> void
+{
+    market::candle_series series(resolution::SECOND);
+    for (long long second = 0; second < 3600 + 5; ++second)
+    {
+        series.add(second * SECOND, static_cast<int>(second), 1);
+    }
+
+    CHECK(series.size() == 3600);
+    std::vector<candle> kept = series.latest(5000);
+    CHECK(kept.size() == 3600 && kept.front().open == 5 && kept.back().open == 3604);
+    bool ordered = true;
+    for (size_t i = 1; i < kept.size(); ++i)
+    {
+        ordered = ordered && kept[i].start == kept[i - 1].start + SECOND;
+    }
+    CHECK(ordered);
+}
+
+auto main() -> int
+{
+    test_rollover();
+    test_vwap();
+    test_ring();
+    return 0;
+}
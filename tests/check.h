@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// like assert, but also checked in release builds, where the tests are usually built
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            std::exit(1); \
+        } \
+    } while (false)
@@ -0,0 +1,111 @@
+#include "config.h"
+#include "check.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using network::server_config;
+using network::load_config;
+using network::config_json;
+
+// a config file written in a temporary directory, removed with it
+struct config_file
+{
+    std::string path;
+
+    explicit config_file(const std::string &contents)
+        : path((std::filesystem::temp_directory_path() / "tdexchange-config-test.json").string())
+    {
+        std::ofstream(path) << contents;
+    }
+
+    ~config_file()
+    {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+};
+
+// whether loading a config throws
+static auto rejects(const std::string &contents) -> bool
+{
+    config_file file(contents);
+    try
+    {
+        load_config(file.path);
+    }
+    catch (const std::exception &)
+    {
+        return true;
+    }
+    return false;
+}
+
+// a config written by config_json is read back as it was
+static auto test_round_trip() -> void
+{
+    server_config config;
+    config.port = 9001;
+    config.tick_ms = 5;
+    config.threads = 3;
+    config.shm_sessions = 4;
+    config.cancel_on_disconnect = true;
+    config.outbound.max_bytes = 12345;
+    config.outbound.max_lagging_ticks = 7;
+    config.throttles.message_burst = 9;
+    config.throttles.penalty = std::chrono::seconds(42);
+    config.runtime.profile = network::latency_profile::LOW_LATENCY;
+    config.runtime.exchange_core = 2;
+    config.universe = market::synthetic_universe(6, 10, 3);
+    config.universe.reserve.levels = 77;
+    config.universe.reserve.pages = market::page_backing::TRANSPARENT;
+
+    config_file file(config_json(config).dump(4));
+    server_config loaded = load_config(file.path);
+
+    CHECK(config_json(loaded) == config_json(config));
+    CHECK(loaded.universe.tickers.size() == 6 && loaded.universe.users.size() == config.universe.users.size());
+    CHECK(loaded.throttles.penalty == std::chrono::seconds(42) && loaded.runtime.profile == network::latency_profile::LOW_LATENCY);
+}
+
+// every key left out keeps its default, and the game's universe unless tickers or users are listed
+static auto test_defaults() -> void
+{
+    config_file file(R"({"port": 9002, "throttles": {"violation_burst": 3}})");
+    server_config loaded = load_config(file.path);
+
+    server_config defaults;
+    defaults.port = 9002;
+    defaults.throttles.violation_burst = 3;
+    CHECK(config_json(loaded) == config_json(defaults));
+}
+
+// a config that cannot be read, or with values out of range, is refused
+static auto test_invalid() -> void
+{
+    CHECK(rejects("{"));
+    CHECK(rejects(R"({"tick_ms": 0})"));
+    CHECK(rejects(R"({"tickers": [{"id": 1, "alias": "A", "allocation": "lottery"}]})"));
+    CHECK(rejects(R"({"tickers": [{"id": 0, "alias": "A"}]})"));
+    CHECK(rejects(R"({"runtime": {"profile": "turbo"}})"));
+
+    bool missing = false;
+    try
+    {
+        load_config((std::filesystem::temp_directory_path() / "tdexchange-no-such-config.json").string());
+    }
+    catch (const std::runtime_error &)
+    {
+        missing = true;
+    }
+    CHECK(missing);
+}
+
+auto main() -> int
+{
+    test_round_trip();
+    test_defaults();
+    test_invalid();
+    return 0;
+}
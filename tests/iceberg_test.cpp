@@ -0,0 +1,63 @@
+#include "exchange.h"
+#include "check.h"
+#include "book.h"
+
+using market::side;
+using market::order_type;
+using market::order_status;
+
+// an iceberg shows one slice, and each filled slice is replaced at the back of the level
+static auto test_replenish() -> void
+{
+    market::exchange ex;
+    market::order_result ice = ex.user_order(side::ASK, 1, 1, 100, 25, order_type::LIMIT, 10);
+    ex.user_order(side::ASK, 2, 1, 100, 5);
+    CHECK(shown(ex.get_ticker(1).get_orderbook().asks, 100) == 15);
+
+    // the hidden volume is still there for a fill or kill
+    CHECK(ex.user_order(side::BID, 3, 1, 100, 31, order_type::FOK).status == order_status::REJECTED);
+    CHECK(ex.user_order(side::BID, 3, 1, 100, 12, order_type::IOC).filled == 12);
+
+    // the first slice filled, the next queued behind the other order, which filled the last 2
+    std::vector<market::queue_position> positions = ex.user_queue_positions(1, 1);
+    CHECK(positions.size() == 1 && positions.front().volume == 10);
+    CHECK(positions.front().orders_ahead == 1 && positions.front().volume_ahead == 3);
+    CHECK(ex.get_user(1).view_order(ice.id).volume == 15);
+}
+
+// amending an iceberg down takes from its reserve first
+static auto test_amend() -> void
+{
+    market::exchange ex;
+    market::order_result ice = ex.user_order(side::ASK, 1, 1, 100, 15, order_type::LIMIT, 10);
+    ex.user_order(side::ASK, 2, 1, 100, 3);
+
+    CHECK(ex.user_amend_order(1, ice.id, 100, 12));
+    CHECK(shown(ex.get_ticker(1).get_orderbook().asks, 100) == 13);
+    CHECK(ex.user_amend_order(1, ice.id, 100, 8));
+    CHECK(shown(ex.get_ticker(1).get_orderbook().asks, 100) == 11);
+
+    market::order_result result = ex.user_order(side::BID, 4, 1, 100, 100);
+    CHECK(result.filled == 11 && result.status == order_status::RESTING);
+    CHECK(ex.get_user(1).get_orders().empty() && ex.get_user(1).get_holding(1) == -8);
+}
+
+// cancelling an iceberg removes its reserve with it
+static auto test_cancel() -> void
+{
+    market::exchange ex;
+    ex.user_order(side::BID, 5, 1, 99, 7, order_type::LIMIT, 3);
+    CHECK(ex.user_cancel(5) == 1);
+    CHECK(ex.get_ticker(1).get_bids().empty());
+
+    // nothing hidden is left to trade
+    CHECK(ex.user_order(side::ASK, 6, 1, 99, 1, order_type::IOC).filled == 0);
+}
+
+auto main() -> int
+{
+    test_replenish();
+    test_amend();
+    test_cancel();
+    return 0;
+}
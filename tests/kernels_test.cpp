@@ -0,0 +1,133 @@
+#include "kernels.h"
+#include "depth.h"
+#include "check.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+
+using market::kernels::instruction_set;
+using market::kernels::aligned_vector;
+using market::side;
+
+// every instruction set the cpu runs, scalar first
+static auto instruction_sets() -> std::vector<instruction_set>
+{
+    std::vector<instruction_set> sets;
+    for (instruction_set set : { instruction_set::SCALAR, instruction_set::SSE2, instruction_set::AVX2 })
+    {
+        if (market::kernels::select(set) == set)
+            sets.push_back(set);
+    }
+    return sets;
+}
+
+// sizes around every vector width and block, and none
+static auto test_kernels(instruction_set set) -> void
+{
+    std::mt19937 rng(static_cast<unsigned>(set) + 1);
+    for (size_t n = 0; n <= 70; ++n)
+    {
+        aligned_vector<long long> values(n);
+        for (long long &value : values)
+            value = rng() % 1000;
+
+        std::vector<long long> prefix(n);
+        long long total = 0;
+        for (size_t i = 0; i < n; ++i)
+            prefix[i] = total += values[i];
+
+        aligned_vector<long long> out(n);
+        market::kernels::prefix_sum(values.data(), out.data(), n);
+        CHECK(std::equal(out.begin(), out.end(), prefix.begin()));
+
+        // and in place
+        aligned_vector<long long> inplace = values;
+        market::kernels::prefix_sum(inplace.data(), inplace.data(), n);
+        CHECK(std::equal(inplace.begin(), inplace.end(), prefix.begin()));
+
+        // exact below the limit, otherwise a prefix reaching it
+        for (long long limit : { 0LL, 1LL, total / 3, total / 2, total, total + 1 })
+        {
+            long long sum = market::kernels::sum_until(values.data(), n, limit);
+            if (total < limit)
+            {
+                CHECK(sum == total);
+            }
+            else
+            {
+                CHECK(sum >= limit && sum <= total);
+                CHECK(sum == 0 || std::find(prefix.begin(), prefix.end(), sum) != prefix.end());
+            }
+        }
+    }
+}
+
+// the depth of both sides read through the kernels matches the levels it mirrors
+static auto test_depth(instruction_set set) -> void
+{
+    std::mt19937 rng(7);
+    for (side wish : { side::BID, side::ASK })
+    {
+        market::depth levels(wish);
+        std::map<int, std::pair<long long, long long>> book;
+
+        for (int step = 0; step < 400; ++step)
+        {
+            int price = 90 + rng() % 40;
+            long long shown = rng() % 4 == 0 ? 0 : rng() % 50;
+            long long hidden = rng() % 3 == 0 ? rng() % 100 : 0;
+            levels.set(price, shown, hidden);
+            if (shown + hidden == 0)
+                book.erase(price);
+            else
+                book[price] = { shown, hidden };
+
+            // best price first
+            std::vector<std::pair<int, long long>> ordered;
+            for (const auto &[p, volume] : book)
+                ordered.emplace_back(p, volume.first + volume.second);
+            if (wish == side::BID)
+                std::reverse(ordered.begin(), ordered.end());
+            CHECK(levels.size() == ordered.size());
+
+            aligned_vector<long long> cumulative;
+            levels.cumulative(cumulative);
+            long long running = 0;
+            for (size_t i = 0; i < ordered.size(); ++i)
+            {
+                running += ordered[i].second;
+                CHECK(cumulative[i] == running);
+            }
+
+            // the volume at a price or better, far below any limit so it is exact
+            int limit_price = 90 + rng() % 40;
+            long long through = 0;
+            for (const auto &[p, volume] : ordered)
+            {
+                if (wish == side::BID ? p >= limit_price : p <= limit_price)
+                    through += volume;
+            }
+            CHECK(levels.available(limit_price, 1LL << 40) == through);
+
+            std::vector<market::depth_level> best = levels.best(5);
+            CHECK(best.size() == std::min<size_t>(5, ordered.size()));
+            for (size_t i = 0; i < best.size(); ++i)
+            {
+                CHECK(best[i].price == ordered[i].first && best[i].volume == book.at(ordered[i].first).first);
+            }
+        }
+    }
+    CHECK(market::kernels::active() == set);
+}
+
+auto main() -> int
+{
+    for (instruction_set set : instruction_sets())
+    {
+        market::kernels::select(set);
+        test_kernels(set);
+        test_depth(set);
+    }
+    return 0;
+}
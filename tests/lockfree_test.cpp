@@ -0,0 +1,125 @@
+#include "spsc_ring.h"
+#include "seqlock.h"
+#include "check.h"
+
+#include <memory>
+#include <thread>
+
+using network::spsc_ring;
+using network::seqlock;
+
+// a ring holds its capacity, and its counters carry on past it as values wrap around the slots
+static auto test_ring_wraparound() -> void
+{
+    spsc_ring<int, 4> ring;
+    CHECK(ring.empty() && !ring.try_pop().has_value() && ring.front() == nullptr);
+
+    int next = 0;
+    int expected = 0;
+    bool ordered = true;
+    for (int round = 0; round < 10; ++round)
+    {
+        while (ring.try_push(next))
+        {
+            ++next;
+        }
+        CHECK(ring.size() == 4);
+
+        // take some, so the next round starts at another slot
+        for (int i = 0; i < 3; ++i)
+        {
+            ordered = ordered && *ring.front() == expected;
+            ordered = ordered && ring.try_pop() == expected;
+            ++expected;
+        }
+    }
+    CHECK(ordered);
+    CHECK(next == 4 + 9 * 3 && ring.size() == 1 && *ring.try_pop() == expected);
+}
+
+// values cross between threads in order without loss
+static auto test_ring_threads() -> void
+{
+    constexpr int COUNT = 200000;
+    std::unique_ptr<spsc_ring<int, 64>> ring = std::make_unique<spsc_ring<int, 64>>();
+
+    std::thread producer([&ring]()
+    {
+        for (int i = 0; i < COUNT; ++i)
+        {
+            while (!ring->try_push(i))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    bool ordered = true;
+    while (expected < COUNT)
+    {
+        std::optional<int> value = ring->try_pop();
+        if (!value)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ordered = ordered && *value == expected;
+        ++expected;
+    }
+    producer.join();
+
+    CHECK(ordered && ring->empty());
+}
+
+// fields written together, so a torn read shows as fields that differ
+struct sample
+{
+    long long values[8];
+};
+
+// a reader never sees a write half done, and the sequence counts the writes
+static auto test_seqlock() -> void
+{
+    constexpr long long WRITES = 100000;
+    seqlock<sample> lock;
+    CHECK(lock.get_sequence() == 0 && lock.load().values[7] == 0);
+
+    std::thread writer([&lock]()
+    {
+        for (long long i = 1; i <= WRITES; ++i)
+        {
+            sample value;
+            for (long long &field : value.values)
+            {
+                field = i;
+            }
+            lock.store(value);
+        }
+    });
+
+    bool consistent = true;
+    long long last = 0;
+    while (last < WRITES)
+    {
+        sample value = lock.load();
+        for (long long field : value.values)
+        {
+            consistent = consistent && field == value.values[0];
+        }
+        consistent = consistent && value.values[0] >= last;
+        last = value.values[0];
+    }
+    writer.join();
+
+    CHECK(consistent);
+    CHECK(lock.get_sequence() == 2 * WRITES);
+}
+
+auto main() -> int
+{
+    test_ring_wraparound();
+    test_ring_threads();
+    test_seqlock();
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "exchange.h"
+#include "check.h"
+
+using market::side;
+using market::order_type;
+
+// a mass cancel takes every resting order and stop of the user on every ticker, and leaves its exposure at zero
+static auto test_mass_cancel() -> void
+{
+    market::exchange ex;
+    for (int i = 0; i < 300; ++i)
+    {
+        ex.user_order(side::BID, 1, 1 + i % 2, 50 + i % 7, 1);
+    }
+    for (int i = 0; i < 30; ++i)
+    {
+        ex.user_order(side::ASK, 1, 1, 100 + i % 5, 2);
+    }
+    ex.user_order(side::BID, 2, 1, 55, 3);
+    ex.user_stop_order(side::BID, 1, 1, 120, 0, 1, order_type::STOP);
+
+    // cancelling one ticker leaves the others
+    ex.user_cancel_ticker(1, 2);
+    CHECK(ex.get_user(1).get_open_orders() == 180);
+    CHECK(ex.get_ticker(2).get_bids().empty());
+
+    CHECK(ex.user_cancel(1) == 181);
+    CHECK(ex.get_user(1).get_open_orders() == 0);
+    CHECK(ex.get_user(1).get_open_volume() == 0 && ex.get_user(1).get_bid_notional() == 0);
+
+    // the other user's order is all that is left
+    CHECK(ex.get_ticker(1).get_asks().empty() && ex.get_ticker(1).get_bids().size() == 1);
+    CHECK(ex.get_user(2).get_open_orders() == 1);
+
+    // and the user trades on as before
+    ex.user_order(side::BID, 1, 1, 50, 1);
+    CHECK(ex.get_user(1).get_open_orders() == 1);
+    CHECK(ex.user_cancel(1) == 1);
+    CHECK(ex.user_cancel(1) == 0);
+}
+
+auto main() -> int
+{
+    test_mass_cancel();
+    return 0;
+}
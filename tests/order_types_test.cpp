@@ -0,0 +1,86 @@
+#include "exchange.h"
+#include "check.h"
+#include "book.h"
+
+using market::side;
+using market::order_type;
+using market::order_status;
+using market::self_trade;
+
+// a post only rests unless it would trade immediately
+static auto test_post_only() -> void
+{
+    market::exchange ex;
+    ex.user_order(side::ASK, 1, 1, 100, 5);
+
+    CHECK(ex.user_order(side::BID, 3, 1, 100, 1, order_type::POST_ONLY).status == order_status::REJECTED);
+    CHECK(ex.user_order(side::BID, 3, 1, 99, 1, order_type::POST_ONLY).status == order_status::RESTING);
+    CHECK(ex.get_transactions().empty());
+}
+
+// a fill or kill fills completely at its price or better, or leaves the book as it was
+static auto test_fill_or_kill() -> void
+{
+    market::exchange ex;
+    ex.user_order(side::ASK, 1, 1, 100, 5);
+    ex.user_order(side::ASK, 2, 1, 101, 5);
+
+    CHECK(ex.user_order(side::BID, 4, 1, 101, 11, order_type::FOK).status == order_status::REJECTED);
+    CHECK(shown(ex.get_ticker(1).get_orderbook().asks, 100) == 5);
+
+    market::order_result result = ex.user_order(side::BID, 4, 1, 101, 7, order_type::FOK);
+    CHECK(result.status == order_status::FILLED && result.filled == 7);
+    CHECK(ex.get_user(4).get_holding(1) == 7 && ex.get_user(4).get_cash() == -(500 + 202));
+}
+
+// a fill or kill with self-trade prevention is not filled by the user's own orders, so it fills completely or not at all
+static auto test_fill_or_kill_self_trade() -> void
+{
+    market::exchange ex;
+    market::order_result own = ex.user_order(side::ASK, 1, 1, 100, 5);
+    ex.user_order(side::ASK, 2, 1, 100, 5);
+
+    market::order_result result = ex.user_order(side::BID, 1, 1, 100, 8, order_type::FOK, 0, self_trade::CANCEL_OLDEST);
+    CHECK(result.status == order_status::REJECTED && result.filled == 0);
+    CHECK(ex.get_transactions().empty() && ex.get_user(1).has_order(own.id));
+
+    // an order meeting its own with a mode that stops it cannot count on the volume behind them
+    ex.user_order(side::ASK, 3, 1, 100, 3);
+    CHECK(ex.user_order(side::BID, 1, 1, 100, 8, order_type::FOK, 0, self_trade::CANCEL_NEWEST).status == order_status::REJECTED);
+
+    // one cancelling the resting orders out of its way can
+    result = ex.user_order(side::BID, 1, 1, 100, 8, order_type::FOK, 0, self_trade::CANCEL_OLDEST);
+    CHECK(result.status == order_status::FILLED && result.filled == 8);
+    CHECK(!ex.get_user(1).has_order(own.id) && ex.get_user(1).get_holding(1) == 8);
+}
+
+// an ioc and a market order cancel what they cannot fill, a limit rests it
+static auto test_remainders() -> void
+{
+    market::exchange ex;
+    ex.user_order(side::ASK, 1, 1, 100, 3);
+    ex.user_order(side::BID, 2, 1, 99, 1);
+
+    market::order_result result = ex.user_order(side::BID, 5, 1, 101, 5, order_type::IOC);
+    CHECK(result.status == order_status::CANCELLED && result.filled == 3);
+    CHECK(ex.get_user(5).get_orders().empty());
+
+    result = ex.user_order(side::ASK, 6, 1, 0, 3, order_type::MARKET);
+    CHECK(result.status == order_status::CANCELLED && result.filled == 1);
+    CHECK(ex.get_ticker(1).get_bids().empty());
+
+    ex.user_order(side::ASK, 1, 1, 105, 2);
+    result = ex.user_order(side::BID, 7, 1, 106, 5);
+    CHECK(result.status == order_status::RESTING && result.filled == 2);
+    std::vector<market::queue_position> positions = ex.user_queue_positions(7, 1);
+    CHECK(positions.size() == 1 && positions.front().volume == 3 && positions.front().price == 106);
+}
+
+auto main() -> int
+{
+    test_post_only();
+    test_fill_or_kill();
+    test_fill_or_kill_self_trade();
+    test_remainders();
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "outbound.h"
+#include "check.h"
+
+using network::outbound_queue;
+using network::outbound_limits;
+
+// a tick with one transaction of each given volume
+static auto tick(int id, std::initializer_list<int> volumes) -> json
+{
+    json transactions = json::array();
+    for (int volume : volumes)
+    {
+        transactions.push_back({ {"volume", volume}, {"price", 100} });
+    }
+    return { {"type", "tick"}, {"id", id}, {"transactions", transactions} };
+}
+
+// reliable messages go first and in order, then only the latest tick, with the transactions of those it replaced
+static auto test_conflation() -> void
+{
+    outbound_queue queue;
+    CHECK(queue.push("ack 1"));
+    CHECK(queue.push_tick(tick(1, { 1 })));
+    CHECK(queue.push_tick(tick(2, { 2, 3 })));
+    CHECK(queue.push("ack 2"));
+    CHECK(queue.get_messages() == 3 && queue.get_metrics().conflated == 1);
+
+    CHECK(queue.pop() == "ack 1");
+    CHECK(queue.pop() == "ack 2");
+
+    json sent = json::parse(queue.pop());
+    CHECK(sent["id"] == 2 && sent["transactions"].size() == 3);
+    CHECK(sent["transactions"][0]["volume"] == 1);
+    CHECK(!queue.has_pending() && queue.get_bytes() == 0);
+
+    // a tick sent in time is never merged, so the lag starts again
+    CHECK(queue.push_tick(tick(3, {})));
+    CHECK(queue.get_metrics().lagging_ticks == 0 && queue.get_bytes() == 0);
+}
+
+// the transactions merged into an unsent tick count towards the byte limit
+static auto test_tick_bytes() -> void
+{
+    outbound_limits limits;
+    limits.max_bytes = 1000;
+    outbound_queue queue(limits);
+
+    CHECK(queue.push_tick(tick(1, { 1 })));
+    bool kept = true;
+    int merged = 0;
+    while (kept && merged < 1000)
+    {
+        kept = queue.push_tick(tick(2 + merged, { 1, 2, 3 }));
+        merged += 1;
+    }
+    CHECK(!kept && merged < 100);
+    CHECK(queue.get_bytes() > limits.max_bytes && queue.get_metrics().lagging_ticks < limits.max_lagging_ticks);
+
+    // the counted size is close to what is sent
+    size_t counted = queue.get_bytes();
+    size_t sent = json::parse(queue.pop())["transactions"].dump().size();
+    CHECK(counted + 2 >= sent && counted <= sent + 2);
+}
+
+// too many lagging ticks drops the connection as well
+static auto test_lagging_ticks() -> void
+{
+    outbound_limits limits;
+    limits.max_lagging_ticks = 3;
+    outbound_queue queue(limits);
+
+    for (int i = 0; i <= 3; ++i)
+    {
+        CHECK(queue.push_tick(tick(i, {})));
+    }
+    CHECK(!queue.push_tick(tick(4, {})));
+}
+
+auto main() -> int
+{
+    test_conflation();
+    test_tick_bytes();
+    test_lagging_ticks();
+    return 0;
+}
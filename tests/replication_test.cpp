@@ -0,0 +1,219 @@
+#include "exchange.h"
+#include "replication.h"
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using market::side;
+using market::order_type;
+using market::market_phase;
+
+static const char *SOCKET_PATH = "replication_test.sock";
+static const char *JOURNAL_PATH = "replication_test.journal";
+
+// places random orders, cancels and amends on a journaling exchange, with the tick's stops and batch auctions
+static auto burst(market::exchange &ex, std::mt19937 &rng, int count) -> void
+{
+    for (int i = 0; i < count; ++i)
+    {
+        int action = rng() % 10;
+        ids::user_id user = 1 + rng() % 6;
+        ids::ticker_id ticker = 1 + rng() % 2;
+        side wish = rng() % 2 ? side::BID : side::ASK;
+        if (action < 6)
+            ex.user_order(wish, user, ticker, 95 + rng() % 10, 1 + rng() % 5);
+        else if (action < 7)
+            ex.user_stop_order(wish, user, ticker, 95 + rng() % 10, 0, 1, order_type::STOP);
+        else if (action < 8)
+            ex.user_cancel_order(user, 1 + rng() % 50);
+        else if (action < 9)
+            ex.user_amend_order(user, 1 + rng() % 50, 95 + rng() % 10, 1 + rng() % 5);
+        else
+            ex.user_cancel_ticker(user, ticker);
+
+        if (i % 5 == 0)
+        {
+            ex.run_batch_auctions();
+            ex.run_stops();
+        }
+    }
+}
+
+// a command applied twice is dropped, and a missing one stops the replay
+static auto test_apply_sequence() -> void
+{
+    market::exchange primary;
+    primary.set_journaling(true);
+    primary.user_order(side::BID, 1, 1, 100, 5);
+    primary.user_order(side::ASK, 2, 1, 100, 2);
+    primary.user_order(side::ASK, 2, 1, 100, 2);
+    std::vector<market::command> commands = primary.consume_journal();
+    CHECK(commands.size() == 3);
+
+    market::exchange backup;
+    CHECK(backup.apply(commands[0]));
+    CHECK(!backup.apply(commands[0]));
+    CHECK(backup.get_sequence() == 1);
+
+    bool threw = false;
+    try
+    {
+        backup.apply(commands[2]);
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    CHECK(threw && backup.get_sequence() == 1);
+
+    CHECK(backup.apply(commands[1]));
+    CHECK(backup.apply(commands[2]));
+    CHECK(backup.repr_users() == primary.repr_users());
+}
+
+// ticks with no stops triggered and no crossed batch book journal nothing
+static auto test_idle_ticks() -> void
+{
+    market::exchange ex;
+    ex.set_journaling(true);
+    ex.set_phase(2, market_phase::BATCH);
+    ex.consume_journal();
+
+    for (int i = 0; i < 10; ++i)
+    {
+        ex.run_batch_auctions();
+        ex.run_stops();
+    }
+    CHECK(ex.consume_journal().empty());
+
+    // a resting order that does not cross leaves the batch idle
+    ex.user_order(side::BID, 1, 2, 50, 1);
+    ex.user_order(side::ASK, 2, 2, 51, 1);
+    ex.consume_journal();
+    ex.run_batch_auctions();
+    CHECK(ex.consume_journal().empty());
+
+    ex.user_order(side::ASK, 2, 2, 50, 1);
+    ex.consume_journal();
+    ex.run_batch_auctions();
+    std::vector<market::command> commands = ex.consume_journal();
+    CHECK(commands.size() == 1 && commands.front().type == market::command_type::BATCH_AUCTIONS);
+}
+
+// a backup joining while the primary keeps journaling receives every command exactly once, in sequence
+static auto test_catch_up() -> void
+{
+    std::remove(SOCKET_PATH);
+    std::remove(JOURNAL_PATH);
+
+    std::mt19937 rng(7);
+    market::exchange primary_exchange;
+    primary_exchange.set_journaling(true);
+    market::exchange backup_exchange;
+
+    // commands journaled before the backup joins are caught up from the file
+    burst(primary_exchange, rng, 200);
+    auto primary = std::make_unique<network::replication_primary>(SOCKET_PATH, std::make_unique<market::journal_file>(JOURNAL_PATH));
+    primary->replicate(primary_exchange.consume_journal());
+
+    std::atomic<bool> ordered = true;
+    std::thread backup([&]()
+        {
+            network::replication_backup link(SOCKET_PATH, 0);
+            std::vector<market::command> commands;
+            unsigned long long last = 0;
+            while (link.receive(commands))
+            {
+                for (const market::command &cmd : commands)
+                {
+                    if (cmd.sequence != last + 1)
+                        ordered = false;
+                    last = cmd.sequence;
+                    backup_exchange.apply(cmd);
+                }
+            }
+        });
+
+    // batches keep coming while the backup says hello and is caught up
+    for (int i = 0; i < 400; ++i)
+    {
+        burst(primary_exchange, rng, 5);
+        primary->replicate(primary_exchange.consume_journal());
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    for (int i = 0; i < 100 && primary->get_backups() == 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(primary->get_backups() == 1);
+
+    burst(primary_exchange, rng, 25);
+    primary->replicate(primary_exchange.consume_journal());
+
+    // destroying the primary sends everything queued, then closes the link
+    primary.reset();
+    backup.join();
+
+    CHECK(ordered);
+    CHECK(backup_exchange.get_sequence() == primary_exchange.get_sequence());
+    CHECK(backup_exchange.repr_tickers() == primary_exchange.repr_tickers());
+    CHECK(backup_exchange.repr_users() == primary_exchange.repr_users());
+
+    std::remove(JOURNAL_PATH);
+}
+
+// a backup that stops reading is dropped once its queue is full, without ever holding back the exchange, and can rejoin
+static auto test_slow_backup() -> void
+{
+    std::remove(SOCKET_PATH);
+    std::remove(JOURNAL_PATH);
+
+    auto primary = std::make_unique<network::replication_primary>(SOCKET_PATH,
+        std::make_unique<market::journal_file>(JOURNAL_PATH), 64 * 1024);
+    network::replication_backup stalled(SOCKET_PATH, 0);
+    for (int i = 0; i < 100 && primary->get_backups() == 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(primary->get_backups() == 1);
+
+    // far more than the socket buffers and the backlog hold
+    unsigned long long sequence = 0;
+    for (int i = 0; i < 400; ++i)
+    {
+        std::vector<market::command> batch(100);
+        for (market::command &cmd : batch)
+            cmd.sequence = ++sequence;
+        primary->replicate(std::move(batch));
+    }
+    for (int i = 0; i < 200 && primary->get_backups() == 1; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(primary->get_backups() == 0);
+
+    // a backup joining afterwards is caught up from the journal
+    network::replication_backup rejoined(SOCKET_PATH, 0);
+    std::vector<market::command> commands;
+    unsigned long long last = 0;
+    while (last < sequence && rejoined.receive(commands))
+    {
+        for (const market::command &cmd : commands)
+        {
+            CHECK(cmd.sequence == last + 1);
+            last = cmd.sequence;
+        }
+    }
+    CHECK(last == sequence);
+
+    primary.reset();
+    std::remove(JOURNAL_PATH);
+}
+
+auto main() -> int
+{
+    test_apply_sequence();
+    test_idle_ticks();
+    test_catch_up();
+    test_slow_backup();
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "exchange.h"
+#include "check.h"
+
+using market::side;
+using market::order_type;
+using market::order_status;
+using market::risk_check;
+
+// each limit rejects the order that breaks it, with that limit
+static auto test_limits() -> void
+{
+    market::exchange ex;
+    market::risk_limits limits;
+    limits.max_order_volume = 100;
+    limits.max_open_orders = 3;
+    limits.max_position = 150;
+    limits.credit_limit = 20000;
+    ex.set_risk_limits(limits);
+
+    CHECK(ex.user_order(side::BID, 1, 1, 100, 101).risk == risk_check::ORDER_VOLUME);
+    CHECK(ex.user_order(side::BID, 1, 1, 100, 100).status == order_status::RESTING);
+    CHECK(ex.user_order(side::BID, 1, 1, 100, 60).risk == risk_check::POSITION);
+    CHECK(ex.user_order(side::BID, 1, 1, 100, 50).status == order_status::RESTING);
+
+    // the first trade sets the band
+    CHECK(ex.user_order(side::ASK, 2, 1, 100, 100).filled == 100);
+    CHECK(ex.user_order(side::ASK, 3, 1, 200, 1).risk == risk_check::PRICE_BAND);
+    CHECK(ex.user_order(side::ASK, 3, 1, 150, 1).risk == risk_check::PASSED);
+
+    CHECK(ex.user_order(side::BID, 4, 1, 140, 100).status == order_status::RESTING);
+    CHECK(ex.user_order(side::BID, 4, 1, 140, 50).risk == risk_check::CREDIT);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK(ex.user_order(side::ASK, 5, 1, 149, 1).risk == risk_check::PASSED);
+    }
+    CHECK(ex.user_order(side::ASK, 5, 1, 149, 1).risk == risk_check::OPEN_ORDERS);
+}
+
+// only orders passing the checks count towards the rate, so rejected ones leave the budget alone
+static auto test_rate() -> void
+{
+    market::exchange ex;
+    market::risk_limits limits;
+    limits.max_order_volume = 10;
+    limits.max_orders_per_window = 5;
+    limits.rate_window = std::chrono::hours(1);
+    ex.set_risk_limits(limits);
+
+    for (int i = 0; i < 20; ++i)
+    {
+        CHECK(ex.user_order(side::BID, 1, 1, 100, 11).risk == risk_check::ORDER_VOLUME);
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        CHECK(ex.user_order(side::BID, 1, 1, 100, 1).risk == risk_check::PASSED);
+    }
+    CHECK(ex.user_order(side::BID, 1, 1, 100, 1).risk == risk_check::RATE);
+
+    // each user has a budget of its own
+    CHECK(ex.user_order(side::BID, 2, 1, 100, 1).risk == risk_check::PASSED);
+}
+
+// a market bid is checked for what the asks would cost it, however far above the band they are
+static auto test_market_credit() -> void
+{
+    market::exchange ex;
+    market::risk_limits limits;
+    limits.credit_limit = 5000;
+    ex.set_risk_limits(limits);
+
+    // placed on an empty book, so it is only priced when it triggers
+    market::order_result stop = ex.user_stop_order(side::BID, 5, 1, 100, 0, 10, order_type::STOP);
+    CHECK(stop.status == order_status::PENDING);
+
+    // rests before the first trade sets the band
+    CHECK(ex.user_order(side::ASK, 3, 1, 1000, 10).status == order_status::RESTING);
+    ex.user_order(side::ASK, 2, 1, 100, 1);
+    CHECK(ex.user_order(side::BID, 1, 1, 100, 1).filled == 1);
+
+    // the stop triggered at 100 would have bought at 1000
+    CHECK(ex.get_user(5).get_holding(1) == 0);
+    CHECK(!ex.user_cancel_order(5, stop.id));
+
+    CHECK(ex.user_order(side::BID, 4, 1, 0, 10, order_type::MARKET).risk == risk_check::CREDIT);
+    CHECK(ex.user_order(side::BID, 4, 1, 0, 4, order_type::MARKET).filled == 4);
+    CHECK(ex.get_user(4).get_cash() == -4000);
+}
+
+auto main() -> int
+{
+    test_limits();
+    test_rate();
+    test_market_credit();
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "exchange.h"
+#include "check.h"
+
+using market::side;
+using market::order_type;
+using market::order_status;
+using market::self_trade;
+using market::allocation;
+
+// each mode against the same user's resting orders, in time priority
+static auto test_modes() -> void
+{
+    market::exchange ex;
+    ex.user_order(side::ASK, 1, 1, 100, 5);
+    ex.user_order(side::ASK, 2, 1, 100, 5);
+    ex.user_order(side::ASK, 1, 1, 101, 5, order_type::LIMIT, 2);
+
+    // cancel newest stops at the first own order, nothing trades
+    market::order_result result = ex.user_order(side::BID, 1, 1, 101, 8, order_type::LIMIT, 0, self_trade::CANCEL_NEWEST);
+    CHECK(result.status == order_status::CANCELLED && result.filled == 0);
+    CHECK(ex.get_user(1).get_orders().size() == 2);
+
+    // cancel oldest removes both own orders, trades with the other user in between and rests the rest
+    result = ex.user_order(side::BID, 1, 1, 101, 8, order_type::LIMIT, 0, self_trade::CANCEL_OLDEST);
+    CHECK(result.status == order_status::RESTING && result.filled == 5);
+    CHECK(ex.get_user(1).get_orders().size() == 1);
+    CHECK(ex.get_ticker(1).get_asks().empty());
+
+    // decrement reduces both orders by the smaller volume without trading
+    result = ex.user_order(side::ASK, 1, 1, 101, 2, order_type::LIMIT, 0, self_trade::DECREMENT);
+    CHECK(result.status == order_status::CANCELLED && result.filled == 0);
+    CHECK(ex.get_user(1).view_order(ex.get_user(1).get_orders().front()).volume == 1);
+
+    // cancel both removes the resting order and the aggressor
+    result = ex.user_order(side::ASK, 1, 1, 101, 4, order_type::LIMIT, 0, self_trade::CANCEL_BOTH);
+    CHECK(result.status == order_status::CANCELLED && result.filled == 0);
+    CHECK(ex.get_user(1).get_orders().empty());
+    CHECK(ex.get_ticker(1).get_bids().empty());
+
+    for (const market::transaction &trans : ex.get_transactions())
+    {
+        CHECK(trans.bidder_id != trans.asker_id);
+    }
+}
+
+// under pro-rata the user's own orders anywhere in the level are prevented before the volume is shared
+static auto test_pro_rata() -> void
+{
+    market::ticker tick("T", 1, allocation::PRO_RATA);
+    id_system<ids::transaction_id> id;
+    tick.add_order({ 1, 2, 1, side::ASK, 100, 20 });
+    tick.add_order({ 2, 1, 1, side::ASK, 100, 20 });
+    tick.add_order({ 3, 3, 1, side::ASK, 100, 20 });
+
+    market::match_result result = tick.match({ 9, 1, 1, side::BID, 100, 10, 0, 0, self_trade::CANCEL_OLDEST }, id);
+    int volume = 0;
+    for (const market::transaction &trans : result.transactions)
+    {
+        CHECK(trans.ask_id != 2);
+        volume += trans.volume;
+    }
+    CHECK(volume == 10);
+    CHECK(result.reduced.size() == 1 && result.reduced.front().first.id == 2);
+
+    // and without prevention the user trades with itself like with anyone
+    result = tick.match({ 10, 3, 1, side::BID, 100, 20 }, id);
+    volume = 0;
+    for (const market::transaction &trans : result.transactions)
+    {
+        volume += trans.volume;
+    }
+    CHECK(volume == 20 && result.reduced.empty() && result.prevented == 0);
+}
+
+auto main() -> int
+{
+    test_modes();
+    test_pro_rata();
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "exchange.h"
+#include "settlement.h"
+#include "check.h"
+
+using market::side;
+
+// fills of two partitions are settled in time order into one set of accounts, read back by either partition
+static auto test_settle() -> void
+{
+    market::universe config = market::default_universe();
+    market::exchange p0(config, market::partition{ 0, 2 });
+    market::exchange p1(config, market::partition{ 1, 2 });
+
+    network::account_service service(2, config);
+    network::settlement_feed f0(0);
+    network::settlement_feed f1(1);
+
+    p0.user_order(side::ASK, 1, 1, 100, 5);
+    p1.user_order(side::ASK, 2, 2, 200, 5);
+    p0.user_order(side::BID, 3, 1, 100, 2);
+    p1.user_order(side::BID, 3, 2, 200, 1);
+
+    // nothing settles until the other partition's watermark passes the fill
+    f0.settle(p0.consume_transactions(), p0.get_clock());
+    CHECK(service.poll() == 0);
+
+    f1.settle(p1.consume_transactions(), p1.get_clock());
+    long long later = std::max(p0.get_clock(), p1.get_clock()) + 1;
+    f0.settle({}, later);
+    f1.settle({}, later);
+    service.poll();
+
+    size_t index = p0.get_user(3).get_index();
+    std::optional<network::settled_account> account = f1.get_account(index);
+    CHECK(account && account->user == 3);
+    CHECK(account->holdings[f1.get_slot(1).value()] == 2);
+    CHECK(account->holdings[f1.get_slot(2).value()] == 1);
+    CHECK(account->cash == p0.get_user(3).get_cash() - 200);
+}
+
+// the shared memory is sized by the universe, so more users and tickers than fit a fixed layout settle too
+static auto test_large_universe() -> void
+{
+    market::universe config = market::synthetic_universe(40, 300);
+    config.tickers.back().id = 1000;
+    market::exchange p0(config, market::partition{ 0, 2 });
+    market::exchange p1(config, market::partition{ 1, 2 });
+
+    network::account_service service(2, config);
+    network::settlement_feed f0(0);
+    network::settlement_feed f1(1);
+    CHECK(!f0.get_slot(40).has_value());
+    CHECK(f0.get_slot(1000).value() == 39);
+
+    market::exchange &owner = market::ticker_partition(1000, 2) == 0 ? p0 : p1;
+    owner.user_order(side::ASK, 5, 1000, 100, 4);
+    owner.user_order(side::BID, 299, 1000, 100, 4);
+
+    f0.settle(p0.consume_transactions(), p0.get_clock());
+    f1.settle(p1.consume_transactions(), p1.get_clock());
+    long long later = std::max(p0.get_clock(), p1.get_clock()) + 1;
+    f0.settle({}, later);
+    f1.settle({}, later);
+    CHECK(service.poll() == 1);
+
+    std::optional<network::settled_account> buyer = f0.get_account(owner.get_user(299).get_index());
+    std::optional<network::settled_account> seller = f1.get_account(owner.get_user(5).get_index());
+    CHECK(buyer && buyer->user == 299 && buyer->holdings[39] == 4);
+    CHECK(seller && seller->user == 5 && seller->holdings[39] == -4);
+    CHECK(!f0.get_account(config.users.size()).has_value());
+}
+
+auto main() -> int
+{
+    test_settle();
+    test_large_universe();
+    return 0;
+}
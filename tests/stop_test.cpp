@@ -0,0 +1,77 @@
+#include "exchange.h"
+#include "check.h"
+
+using market::side;
+using market::order_type;
+using market::order_status;
+
+// a trade at the trigger runs the stop in the same call, and the trades it makes trigger the next stops
+static auto test_cascade() -> void
+{
+    market::exchange ex;
+    ex.user_order(side::ASK, 1, 1, 101, 5);
+    ex.user_order(side::ASK, 1, 1, 102, 5);
+    ex.user_order(side::ASK, 1, 1, 103, 5);
+    ex.user_order(side::BID, 1, 1, 99, 5);
+
+    market::order_result stop = ex.user_stop_order(side::BID, 2, 1, 101, 0, 5, order_type::STOP);
+    market::order_result stop_limit = ex.user_stop_order(side::BID, 3, 1, 102, 102, 10, order_type::STOP_LIMIT);
+    market::order_result sell_stop = ex.user_stop_order(side::ASK, 4, 1, 98, 0, 1, order_type::STOP);
+    CHECK(stop.status == order_status::PENDING && stop_limit.status == order_status::PENDING);
+    CHECK(sell_stop.status == order_status::PENDING);
+
+    // the trade at 101 triggers the stop, which buys the rest of 101 and one at 102, triggering the stop limit
+    ex.user_order(side::BID, 6, 1, 101, 1);
+    CHECK(ex.get_user(2).get_holding(1) == 5);
+
+    // which buys what is left at 102 and rests the rest there
+    CHECK(ex.get_user(3).get_holding(1) == 4);
+    CHECK(ex.get_user(3).has_order(stop_limit.id));
+    CHECK(ex.get_ticker(1).get_valuation() == 102);
+
+    // a sell stop waits for the price to fall to its trigger, still pending
+    CHECK(ex.get_user(4).get_holding(1) == 0);
+    CHECK(ex.user_cancel_order(4, sell_stop.id));
+}
+
+// a pending stop is cancelled like a resting order, once
+static auto test_cancel() -> void
+{
+    market::exchange ex;
+    market::order_result stop = ex.user_stop_order(side::BID, 5, 1, 200, 0, 1, order_type::STOP);
+    CHECK(!ex.user_cancel_order(4, stop.id));
+    CHECK(ex.user_cancel_order(5, stop.id));
+    CHECK(!ex.user_cancel_order(5, stop.id));
+
+    // and never triggers afterwards
+    ex.user_order(side::ASK, 1, 1, 200, 1);
+    ex.user_order(side::BID, 2, 1, 200, 1);
+    CHECK(ex.get_user(5).get_holding(1) == 0);
+
+    // a mass cancel takes the stops too
+    ex.user_stop_order(side::ASK, 5, 1, 150, 0, 1, order_type::STOP);
+    ex.user_stop_order(side::ASK, 5, 1, 140, 0, 1, order_type::STOP);
+    CHECK(ex.user_cancel(5) == 2);
+    CHECK(ex.get_user(5).get_orders().empty());
+}
+
+// a stop triggered on a book with nothing to trade against is cancelled, as a market order would be
+static auto test_empty_book() -> void
+{
+    market::exchange ex;
+    ex.user_order(side::ASK, 1, 1, 100, 1);
+    market::order_result stop = ex.user_stop_order(side::BID, 2, 1, 100, 0, 3, order_type::STOP);
+    ex.user_order(side::BID, 3, 1, 100, 1);
+
+    CHECK(ex.get_user(2).get_holding(1) == 0);
+    CHECK(!ex.get_user(2).has_order(stop.id));
+    CHECK(!ex.user_cancel_order(2, stop.id));
+}
+
+auto main() -> int
+{
+    test_cascade();
+    test_cancel();
+    test_empty_book();
+    return 0;
+}
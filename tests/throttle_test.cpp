@@ -0,0 +1,71 @@
+#include "throttle.h"
+#include "check.h"
+
+using network::token_bucket;
+using network::throttle;
+using network::throttle_limits;
+using network::throttle_clock;
+using std::chrono::milliseconds;
+
+// a bucket starts full, and refills at its rate up to its burst
+static auto test_token_bucket() -> void
+{
+    token_bucket bucket(10, 5);
+    throttle_clock::time_point start = throttle_clock::now();
+
+    for (int i = 0; i < 5; ++i)
+    {
+        CHECK(bucket.take(1, start));
+    }
+    CHECK(!bucket.take(1, start));
+
+    // 10 per second is one every 100ms
+    CHECK(!bucket.take(1, start + milliseconds(50)));
+    CHECK(bucket.take(1, start + milliseconds(150)));
+    CHECK(!bucket.take(1, start + milliseconds(150)));
+
+    // never more than the burst, however long it was left
+    CHECK(bucket.take(5, start + milliseconds(100000)));
+    CHECK(!bucket.take(1, start + milliseconds(100000)));
+
+    // and time going back refills nothing
+    CHECK(!bucket.take(1, start));
+}
+
+// a message must fit the message, byte and user budgets, each rejected message uses up the violation allowance
+static auto test_throttle() -> void
+{
+    throttle_limits limits;
+    limits.messages_per_second = 1;
+    limits.message_burst = 3;
+    limits.byte_burst = 100;
+    limits.violations_per_second = 1;
+    limits.violation_burst = 2;
+    throttle inbound(limits);
+    token_bucket user(1, 1);
+    throttle other(limits);
+    throttle_clock::time_point now = throttle_clock::now();
+
+    CHECK(!inbound.admit(101, now));
+    CHECK(inbound.admit(60, now));
+    CHECK(!inbound.admit(60, now));
+    CHECK(!inbound.admit(1, now));
+    CHECK(inbound.get_metrics().accepted_messages == 1 && inbound.get_metrics().accepted_bytes == 60);
+
+    // the user's bucket is shared by all of its connections
+    CHECK(other.admit(1, now, &user));
+    CHECK(!other.admit(1, now, &user));
+
+    // the connection is disconnected, and its user put in the penalty box, once the violations run out
+    CHECK(inbound.reject(101, now));
+    CHECK(inbound.reject(60, now));
+    CHECK(!inbound.reject(1, now));
+    CHECK(inbound.get_metrics().rejected_messages == 3 && inbound.get_metrics().rejected_bytes == 162);
+}
+
+auto main() -> int
+{
+    test_token_bucket();
+    test_throttle();
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "trade_store.h"
+#include "check.h"
+
+#include <filesystem>
+
+using market::side;
+using market::transaction;
+using market::TRADE_CHUNK;
+
+// a trade at a time, with prices and ids stepping both ways so the deltas are negative as well as large
+static auto make_trade(long long time, ids::ticker_id ticker) -> transaction
+{
+    int price = (time % 3 == 0) ? 1000000 : static_cast<int>(time % 7) + 1;
+    transaction trans{
+        static_cast<ids::transaction_id>(time * 2 + 1),
+        (time % 2) ? side::ASK : side::BID,
+        static_cast<int>(time % 11) + 1,
+        price,
+        static_cast<ids::order_id>(time * 3),
+        static_cast<ids::order_id>(time * 3 + 1),
+        static_cast<ids::user_id>(time % 5),
+        static_cast<ids::user_id>(time % 5 + 5),
+        ticker,
+        time % 4 == 0
+    };
+    trans.time = time;
+    return trans;
+}
+
+// whether two trades match in every field
+static auto same(const transaction &a, const transaction &b) -> bool
+{
+    return a.id == b.id && a.aggressor == b.aggressor && a.volume == b.volume && a.price == b.price
+        && a.bid_id == b.bid_id && a.ask_id == b.ask_id && a.bidder_id == b.bidder_id && a.asker_id == b.asker_id
+        && a.ticker_id == b.ticker_id && a.auction == b.auction && a.time == b.time;
+}
+
+// trades come back as appended from compressed, spilled and open chunks, and only those in the range asked for
+static auto test_range() -> void
+{
+    std::string directory = (std::filesystem::temp_directory_path() / "tdexchange-trade-store-test").string();
+    long long count = static_cast<long long>(TRADE_CHUNK) * 3 + 100;
+    {
+        market::trade_store store(directory, 1);
+        for (long long time = 0; time < count; ++time)
+        {
+            store.append(make_trade(time, 1));
+        }
+        store.append(make_trade(7, 2));
+
+        CHECK(store.size() == static_cast<size_t>(count) + 1);
+        CHECK(store.get_resident_chunks() == 1 && store.get_spilled_chunks() == 2);
+
+        std::vector<transaction> all = store.range(1);
+        CHECK(all.size() == static_cast<size_t>(count));
+        bool matches = true;
+        for (long long time = 0; time < count; ++time)
+        {
+            matches = matches && same(all[time], make_trade(time, 1));
+        }
+        CHECK(matches);
+
+        // a range across a spilled, the resident and the open chunk
+        long long from = static_cast<long long>(TRADE_CHUNK) - 10;
+        long long to = static_cast<long long>(TRADE_CHUNK) * 3 + 10;
+        std::vector<transaction> some = store.range(1, from, to);
+        CHECK(some.size() == static_cast<size_t>(to - from));
+        CHECK(same(some.front(), make_trade(from, 1)) && same(some.back(), make_trade(to - 1, 1)));
+
+        CHECK(store.range(1, count, count + 10).empty());
+        CHECK(store.range(2).size() == 1 && same(store.range(2).front(), make_trade(7, 2)));
+        CHECK(store.range(3).empty());
+
+        // a user is either side of their trades
+        std::vector<transaction> user = store.user_trades(2, 0, 20);
+        CHECK(user.size() == 4 + 1);
+        CHECK(user.back().ticker_id == 2);
+        for (const transaction &trans : user)
+        {
+            CHECK(trans.bidder_id == 2 || trans.asker_id == 2);
+        }
+
+        CHECK(std::filesystem::exists(directory));
+    }
+
+    // the spill files go with the store
+    CHECK(!std::filesystem::exists(directory));
+}
+
+auto main() -> int
+{
+    test_range();
+    return 0;
+}